@@ -6,6 +6,17 @@
 class ImageHelpers
 {
 	public:
+		// Empty if the file is missing or cannot be decoded.
 		static std::vector<float> loadImage(const std::string& filename, int sizeX = 224, int sizeY = 224);
+		// Same as loadImage for an encoded image (JPEG, PNG, ...) in memory.
+		static std::vector<float> decodeImage(const unsigned char* data, size_t size, int sizeX = 224, int sizeY = 224);
 		static std::vector<std::string> loadLabels(const std::string& filename);
+
+		// Stages of loadImage after decoding, public for snnet-microbench
+		static cv::Mat toRgb(const cv::Mat& bgr);
+		static cv::Mat resize(const cv::Mat& image, int sizeX, int sizeY);
+		static std::vector<float> toCHW(const cv::Mat& rgb);  // [0, 255] HWC bytes -> [0, 1] CHW floats
+
+	private:
+		static std::vector<float> toTensor(const cv::Mat& image, int sizeX, int sizeY);
 };
@@ -0,0 +1,21 @@
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+#include <cstdint>
+
+/* Counts heap allocations in the whole process: every call of the malloc
+ * family, which operator new and ORT's allocators end in. ORT's CPU allocator,
+ * and so the arena whenever it grows, uses posix_memalign, counted apart as
+ * alignedCount(): no new aligned calls means no tensor memory was taken from
+ * the system. Other calls include ORT's per-Run bookkeeping, so a steady state
+ * is not malloc-free. Only built with -DSNNET_DEBUG_ALLOC_COUNT=ON (and always
+ * into snnet-microbench); otherwise enabled() is false and the counts stay 0.
+ */
+struct AllocCounter {
+    static bool enabled();
+    static uint64_t count();            // malloc, calloc, realloc, memalign, aligned_alloc, posix_memalign
+    static uint64_t alignedCount();     // posix_memalign, memalign and aligned_alloc
+    static uint64_t bytes();            // requested by the counted calls
+};
+
+#endif // ALLOCCOUNTER_H
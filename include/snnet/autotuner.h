@@ -0,0 +1,49 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <string>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "session_factory.h"
+#include "stitch_plan.h"
+#include "tuning_table.h"
+
+/* Searches per-session threading settings on this host.
+ * For the first layer of each anchor (one per token width) and each number
+ * of concurrent callers, every candidate TuningConfig gets a session of its
+ * own and is timed: callers run the session `runs` times at once, as the
+ * engine's callers share one session per model. The lowest mean latency wins
+ * for a single caller, the highest throughput for several.
+ */
+class Autotuner {
+private:
+    Ort::Env env;
+    Ort::SessionOptions session_options;
+    SessionFactory factory;
+    TuningConfig current;   // applied to each new session by the factory
+    int runs;
+    std::vector<TuningResult> samples;
+
+    TuningResult measure(const PlanStep& step, int concurrency);
+
+public:
+    // Models are read like the engine does: from `packed_dir` if snnet-pack output is there
+    // (empty: not used), else from `model_dir`.
+    Autotuner(const std::string& model_dir, const std::string& packed_dir, int runs);
+
+    // Intra-op threads 1, 2, 4, ... up to `max_threads` (and `max_threads` itself),
+    // each with and without spinning, in sequential and parallel execution mode.
+    static std::vector<TuningConfig> candidates(int max_threads);
+
+    // Tunes every width for each of `concurrencies` and returns the best configurations.
+    TuningTable tune(const std::vector<int>& concurrencies, int max_threads);
+
+    // Every measurement so far, for the latency and throughput curves.
+    const std::vector<TuningResult>& getSamples() const {
+        return samples;
+    }
+};
+
+#endif // AUTOTUNER_H
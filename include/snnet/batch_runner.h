@@ -0,0 +1,76 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "inference_engine.h"
+#include "stitch_plan.h"
+#include "stitch_selector.h"
+
+/* One manifest line: "<image path> <stitch id>" or "<image path> @<latency budget in ms>".
+ * Blank lines and lines starting with '#' are skipped.
+ */
+struct BatchRequest {
+    size_t line = 0;
+    std::string image_path;
+    int stitch_id = -1;     // -1: chosen from budget_ms
+    double budget_ms = 0;
+};
+
+struct BatchOptions {
+    size_t top_k = 5;
+    bool binary = false;    // fixed-size records instead of NDJSON, see BatchRunner
+    size_t prefetch = 8;    // images decoded ahead of inference
+};
+
+struct BatchSummary {
+    size_t requests = 0, failed = 0;
+    double inference_ms = 0;
+};
+
+/* Scores a manifest of images in one process, with the sessions kept warm
+ * across requests and stitch ids. A loader thread parses the manifest and
+ * decodes images at most `prefetch` requests ahead, and every result is
+ * written as soon as it is ready, so memory stays bounded for any input size.
+ *
+ * Budget requests run the stitch StitchSelector picks, from the latencies
+ * of the requests so far.
+ *
+ * NDJSON output, one object per line:
+ *   {"line":1,"image":"a.jpg","stitch_id":3,"latency_ms":12.5,"digest":"<16 hex>",
+ *    "top_k":[{"class":1,"label":"goldfish","logit":17.2},...]}
+ *   {"line":2,"image":"b.jpg","error":"..."}
+ * Binary output, little-endian: "SNBR", uint32 version (1), uint32 k, then per request
+ *   uint32 line, int32 stitch_id (-1 on error), float latency_ms, uint64 digest,
+ *   k x (int32 class, float logit)
+ * The digest is FNV-1a 64 over the raw logits, to compare runs without storing them.
+ */
+class BatchRunner {
+private:
+    InferenceEngine& engine;
+    const std::vector<std::string>& labels;
+    BatchOptions options;
+
+    std::vector<std::unique_ptr<StitchPlan>> plans;     // by stitch id, created on first use
+    StitchSelector selector;
+
+    const StitchPlan& getPlan(int stitch_id);
+
+public:
+    BatchRunner(InferenceEngine& engine, const std::vector<std::string>& labels, const BatchOptions& options);
+
+    // Returns false for blank and comment lines. Throws std::invalid_argument on malformed ones.
+    static bool parseLine(const std::string& text, size_t line, BatchRequest& request);
+
+    BatchSummary run(std::istream& manifest, std::ostream& output);
+
+    static uint64_t digest(const std::vector<float>& logits);
+};
+
+#endif // BATCHRUNNER_H
@@ -0,0 +1,17 @@
+#ifndef CLIENTSOCKET_H
+#define CLIENTSOCKET_H
+
+#include <cstddef>
+#include <string>
+
+/* Blocking client side of the snnet-onnx --serve sockets, for the test tools */
+struct ClientSocket {
+    // Connects to loopback `tcp_port` if > 0, else to the Unix socket `unix_path`. Returns -1 on failure.
+    static int connectTo(const std::string& unix_path, int tcp_port);
+
+    // Return false if the connection was closed or failed midway.
+    static bool sendAll(int fd, const void* data, size_t size);
+    static bool receiveAll(int fd, void* data, size_t size);
+};
+
+#endif // CLIENTSOCKET_H
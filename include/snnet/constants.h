@@ -11,8 +11,8 @@ constexpr int64_t in_height = 224;
 constexpr int64_t out_numClasses = 1000;
 
 /* Input image */
-const char* image_name = "n01443537_goldfish.JPEG";
-const char* label_name = "imagenet_classes.txt";
+constexpr const char* image_name = "n01443537_goldfish.JPEG";
+constexpr const char* label_name = "imagenet_classes.txt";
 
 /* Transformer layer shape */
 constexpr int64_t tr_height  = 197;
@@ -20,19 +20,23 @@ constexpr int64_t tr_width_t = 192; // tiny
 constexpr int64_t tr_width_s = 384; // small
 constexpr int64_t tr_width_b = 768; // base
 
+/* Stitch ids: 0-2 single anchors (tiny, small, base), 3-36 tiny-small, 37-70 small-base */
+constexpr int vit_depth = 12;
+constexpr int num_stitch_ids = 71;
+
 constexpr int64_t maxNumInputElements = tr_height * tr_width_b; // for memory assign
 constexpr int64_t maxNumOutputElements = tr_height * tr_width_b; // for memory assign
 
 /* Transformer layer shape */
-std::vector<const char*> vit_types = {"tiny", "small", "base"};
-const char* input_node_name_vit_head = "input";
-const char* output_node_name_vit_head = "18";
-const char* input_node_name_vit_embed = "input.1";
-const char* output_node_name_vit_embed = "input"; 
-const char* input_node_name_vit_layers = "input.1";
-const char* output_node_name_vit_layers = "100";
-const char* input_node_name_stitch_layers = "onnx::MatMul_0";
-const char* output_node_name_stitch_layers = "5";
+const std::vector<const char*> vit_types = {"tiny", "small", "base"};
+constexpr const char* input_node_name_vit_head = "input";
+constexpr const char* output_node_name_vit_head = "18";
+constexpr const char* input_node_name_vit_embed = "input.1";
+constexpr const char* output_node_name_vit_embed = "input"; 
+constexpr const char* input_node_name_vit_layers = "input.1";
+constexpr const char* output_node_name_vit_layers = "100";
+constexpr const char* input_node_name_stitch_layers = "onnx::MatMul_0";
+constexpr const char* output_node_name_stitch_layers = "5";
 
 
 
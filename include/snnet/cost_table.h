@@ -0,0 +1,36 @@
+#ifndef COSTTABLE_H
+#define COSTTABLE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "stitch_plan.h"
+
+/* Analytic cost of plan steps, in FLOPs per image (a multiply-add is 2).
+ * For N tokens of width W, a DeiT block costs 8NW^2 in the QKV and output
+ * projections, 16NW^2 in the MLP (hidden width 4W) and 4N^2W in attention.
+ * The embed step is the 16x16 patch projection, a stitch layer one NxWi by
+ * WixWo matmul and the head a W x classes matmul on the class token.
+ * Bytes are the compulsory traffic of a step, in fp32: its weights (12W^2 + 13W
+ * for a block) read once, plus its input and output activations. Intermediate
+ * activations (QKV, attention scores, the 4W MLP hidden layer) are left out, as
+ * whether they leave the caches depends on the kernels.
+ * Only relative costs matter to pipeline balancing and stitch comparisons;
+ * snnet-bench --counters sets them against measured time and cache misses.
+ */
+struct CostTable {
+    static double stepFlops(const PlanStep& step);
+    static double stepWeightBytes(const PlanStep& step);
+    static double stepBytes(const PlanStep& step);
+
+    // stepFlops() of every step of `plan`, in step order.
+    static std::vector<double> stepCosts(const StitchPlan& plan);
+
+    static double planFlops(const StitchPlan& plan);
+
+    // Splits `costs` into min(num_parts, costs.size()) non-empty contiguous ranges, minimizing
+    // the largest range sum. Returns the range boundaries: 0, ..., costs.size().
+    static std::vector<size_t> partition(const std::vector<double>& costs, size_t num_parts);
+};
+
+#endif // COSTTABLE_H
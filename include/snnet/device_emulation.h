@@ -0,0 +1,55 @@
+#ifndef DEVICEEMULATION_H
+#define DEVICEEMULATION_H
+
+#include <cstddef>
+#include <string>
+
+/* Constraints of a smaller device (a phone) to run the benchmarks under */
+struct DeviceProfile {
+    int cores = 0;                      // 0: every CPU of the host
+    size_t memory_bytes = 0;            // 0: no cap
+    double duty_cycle = 1;              // share of each period the process may run, (0, 1]
+    int duty_period_ms = 100;
+    double storage_bytes_per_s = 0;     // model reads, 0: host speed
+
+    // Comma-separated "key=value": cores=4, memory=3g, duty=0.5, period=100 (ms), storage=200m
+    // (bytes/s). Sizes take k, m or g. Throws std::invalid_argument.
+    static DeviceProfile parse(const std::string& spec);
+
+    bool empty() const;
+};
+
+/* What DeviceEmulation::apply() managed to set up */
+struct EmulationReport {
+    int cores = 0;              // CPUs the process is restricted to, 0: not restricted
+    std::string memory_limit;   // "cgroup", "rlimit_as" or empty
+    std::string duty_limit;     // "cgroup", "signals" or empty
+    bool storage = false;
+    std::string cgroup;         // the cgroup created for the process, to rmdir after the run
+};
+
+/* Emulates a DeviceProfile on a big Linux host:
+ *   cores    the process' CPU affinity is cut to the first N CPUs it may use
+ *   memory   memory.max of a child cgroup created for the process (cgroup v2,
+ *            needs a delegated cgroup); otherwise RLIMIT_AS, which counts address
+ *            space (thread stacks, malloc arenas, mapped models), not resident
+ *            memory, so it needs headroom above the device's RAM
+ *   duty     cpu.max of the same cgroup; otherwise a helper process stops and
+ *            continues this one with SIGSTOP/SIGCONT every period, which also
+ *            stops the clock-keeping threads, like a throttled device would.
+ *            The fallback is meant for non-interactive (CI) runs: under a job
+ *            control shell, each SIGSTOP reports the job as stopped
+ *   storage  StorageThrottle on every session load
+ * Call it first thing in main(): affinity and limits are inherited by the threads
+ * created afterwards, and the helper process is forked while there is one thread.
+ */
+class DeviceEmulation {
+private:
+    static bool enterCgroup(const DeviceProfile& profile, EmulationReport& report);
+    static bool startDutyCycler(const DeviceProfile& profile);
+
+public:
+    static EmulationReport apply(const DeviceProfile& profile);
+};
+
+#endif // DEVICEEMULATION_H
@@ -0,0 +1,75 @@
+#ifndef ENVALLOCATOR_H
+#define ENVALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <onnxruntime_cxx_api.h>
+
+constexpr const char* arena_calibration_file = "arena_calibration.txt";
+
+struct AllocationStats {
+    uint64_t allocations;
+    size_t live_bytes, peak_bytes;
+};
+
+/* CPU allocator that records how much memory ORT holds at once.
+ * Registered on the env in place of the arena for calibration runs: every
+ * session allocation goes straight through it, so the peak of live bytes is
+ * what the arena has to hold for the same workload.
+ * One instance per process, since the env it is registered on is too.
+ */
+class CountingAllocator : public OrtAllocator {
+private:
+    Ort::MemoryInfo memory_info;
+    std::atomic<uint64_t> allocations{ 0 };
+    std::atomic<size_t> live_bytes{ 0 };
+    std::atomic<size_t> peak_bytes{ 0 };
+
+    CountingAllocator();
+
+public:
+    static CountingAllocator& instance();
+
+    CountingAllocator(const CountingAllocator&) = delete;
+    CountingAllocator& operator=(const CountingAllocator&) = delete;
+
+    void* allocate(size_t size);
+    void release(void* p);
+    const OrtMemoryInfo* info() const {
+        return memory_info;
+    }
+
+    // Restarts the peak from the bytes live now.
+    void resetPeak();
+
+    AllocationStats getStats() const;
+};
+
+/* Peak arena use of each stitch plan, measured by a calibration run.
+ * Stored as "<stitch id> <peak bytes>" lines next to the models.
+ */
+class ArenaCalibration {
+private:
+    std::map<int, size_t> peak_bytes;
+
+public:
+    // Missing or unreadable files give an empty calibration.
+    static ArenaCalibration load(const std::string& path);
+    void save(const std::string& path) const;
+
+    void setPeakBytes(int stitch_id, size_t bytes);
+
+    // Bytes to reserve up front for `stitch_id`, with headroom for arena
+    // rounding. Uncalibrated plans get the largest calibrated peak, 0 if none.
+    size_t getReserveBytes(int stitch_id) const;
+
+    bool empty() const {
+        return peak_bytes.empty();
+    }
+};
+
+#endif // ENVALLOCATOR_H
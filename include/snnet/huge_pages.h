@@ -0,0 +1,66 @@
+#ifndef HUGEPAGES_H
+#define HUGEPAGES_H
+
+#include <cstddef>
+
+constexpr size_t huge_page_size = 2 * 1024 * 1024; // default huge page size on x86-64 and arm64
+
+/* Page residency of memory that is already mapped (weights, models) */
+struct PageResidency {
+    // Asks for transparent huge pages; a no-op where THP is off or the mapping cannot use it.
+    static void adviseHugePages(const void* addr, size_t length);
+
+    // Reads one byte per page so that later accesses do not fault. Returns the bytes covered.
+    static size_t prefault(const void* addr, size_t length);
+
+    // mlock()s the range. Returns false if the kernel refused (e.g. RLIMIT_MEMLOCK).
+    static bool lock(const void* addr, size_t length);
+
+    // Prefers NUMA node `numa_node` for pages of the range not yet faulted in (mbind,
+    // MPOL_PREFERRED). Returns false without NUMA support or for nodes past 63.
+    static bool bindToNode(const void* addr, size_t length, int numa_node);
+};
+
+/* Anonymous memory backed by huge pages, populated on construction.
+ * Explicit huge pages (hugetlbfs, vm.nr_hugepages) are used if any are
+ * reserved, otherwise a 2 MB aligned mapping advised for transparent huge
+ * pages. Either way every page is touched up front, so nothing faults on
+ * first use. With a NUMA node, the pages are placed on that node.
+ */
+class HugePageBuffer {
+private:
+    void* addr;
+    size_t length;
+    bool hugetlb;
+
+    void release();
+
+public:
+    HugePageBuffer();
+    // Throws std::bad_alloc if no memory can be mapped. `numa_node` < 0: the toucher's node.
+    explicit HugePageBuffer(size_t bytes, int numa_node = -1);
+    ~HugePageBuffer();
+
+    HugePageBuffer(const HugePageBuffer&) = delete;
+    HugePageBuffer& operator=(const HugePageBuffer&) = delete;
+    HugePageBuffer(HugePageBuffer&& other) noexcept;
+    HugePageBuffer& operator=(HugePageBuffer&& other) noexcept;
+
+    // Keeps the buffer in RAM. Returns false if the kernel refused.
+    bool lock();
+
+    void* data() const {
+        return addr;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    // true: explicit huge pages, false: transparent huge pages if the kernel grants them
+    bool usesHugeTlb() const {
+        return hugetlb;
+    }
+};
+
+#endif // HUGEPAGES_H
@@ -0,0 +1,67 @@
+#ifndef INFERENCEAWAITABLE_H
+#define INFERENCEAWAITABLE_H
+
+// C++20 coroutine adapter for InferenceEngine::submit(); empty in C++17 builds
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "inference_engine.h"
+
+/* `std::vector<float> logits = co_await inferAsync(engine, image, stitch_id);`
+ * The request starts when the coroutine suspends. The coroutine is resumed on the
+ * ORT thread that finished the last step, unless `resume` is given: an event loop
+ * passes a function that queues the handle and resumes it on the loop's thread.
+ * Errors are rethrown from the co_await.
+ */
+class InferenceAwaitable {
+private:
+    InferenceEngine& engine;
+    const std::vector<float>& image;
+    int stitch_id;
+    std::function<void(std::coroutine_handle<>)> resume;
+
+    std::vector<float> logits;
+    std::exception_ptr error;
+
+public:
+    InferenceAwaitable(InferenceEngine& e, const std::vector<float>& i, int s, std::function<void(std::coroutine_handle<>)> r)
+        : engine(e), image(i), stitch_id(s), resume(std::move(r)) {}
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        engine.submit(image, stitch_id, [this, handle](std::vector<float> result, std::exception_ptr e) {
+            logits = std::move(result);
+            error = e;
+            if (resume) {
+                resume(handle);
+            } else {
+                handle.resume();
+            }
+        });
+    }
+
+    std::vector<float> await_resume() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(logits);
+    }
+};
+
+// `image` must outlive the co_await.
+inline InferenceAwaitable inferAsync(InferenceEngine& engine, const std::vector<float>& image, int stitch_id,
+                                     std::function<void(std::coroutine_handle<>)> resume = {}) {
+    return InferenceAwaitable(engine, image, stitch_id, std::move(resume));
+}
+
+#endif // __cpp_impl_coroutine
+
+#endif // INFERENCEAWAITABLE_H
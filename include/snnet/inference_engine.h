@@ -0,0 +1,155 @@
+#ifndef INFERENCEENGINE_H
+#define INFERENCEENGINE_H
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "env_allocator.h"
+#include "huge_pages.h"
+#include "session_cache.h"
+#include "session_factory.h"
+#include "stitch_plan.h"
+#include "tuning_table.h"
+
+/* Allocator registered on the env and used by every session */
+enum class EnvAllocator {
+    None,       // each session grows its own arena
+    Arena,      // one shared arena, `arena_reserve_bytes` reserved on first use
+    Counting    // calibration: no arena, CountingAllocator tracks the peak
+};
+
+struct EngineOptions {
+    std::string model_dir = "./pretrained/onnx/";
+    std::string packed_dir = "./pretrained/packed/";  // used when snnet-pack output is present; empty: none
+    std::string ort_cache_dir;                        // empty: no ORT format cache; unused with a weight store
+    int intra_op_threads = 1;
+
+    /* Sharing between sessions */
+    bool shared_thread_pools = true;        // env-wide intra/inter-op pools instead of one per session
+    bool share_prepacked_weights = true;    // one prepacked weights container for all sessions
+    EnvAllocator env_allocator = EnvAllocator::Arena;
+    size_t arena_reserve_bytes = 0;         // initial arena chunk, see ArenaCalibration; 0: ORT default
+
+    /* Placement */
+    std::vector<int> cpu_affinity;  // CPUs of the ORT intra-op threads and pipeline stages; empty: not pinned
+    int numa_node = -1;             // node of the activations and of copies of the hot weights; -1: first touch
+
+    /* Per-session threading tuned by snnet-tune; needs shared_thread_pools = false */
+    std::string tuning_file;        // empty: intra_op_threads for every session
+    bool throughput_mode = false;   // settings tuned for one caller per core instead of a single caller
+
+    /* Session residency */
+    size_t memory_budget = 0;   // bytes of resident sessions, 0: unlimited
+    int prefetch_window = 1;    // steps loaded in the background ahead of the running one
+    bool streaming = false;     // low-memory mode: sessions are released right after their step
+};
+
+/* Activation buffers of one in-flight inference.
+ * Steps ping-pong between the two buffers, so nothing is copied between layers.
+ * Both live in one prefaulted huge page, so the first request does not fault on them.
+ * Use one context per calling thread.
+ */
+struct InferenceContext {
+    HugePageBuffer memory;
+    float* ping;
+    float* pong;
+
+    // `numa_node` < 0: on the node of the constructing thread.
+    explicit InferenceContext(int numa_node = -1);
+};
+
+/* Runs stitch plans: embed -> front layers -> stitch -> back layers -> head.
+ * While a step runs, the sessions of the next `prefetch_window` steps are
+ * loaded in the background, so that with a memory budget or in streaming
+ * mode (only the window resident) loads stay off the critical path.
+ * run() may be called from several threads, each with its own context.
+ * runAsync() and submit() chain the steps through Session::RunAsync instead:
+ * each step is started from the completion callback of the previous one, on
+ * an ORT intra-op thread, so one caller can keep many requests in flight.
+ */
+class InferenceEngine {
+private:
+    EngineOptions options;
+    TuningTable tuning;
+    Ort::Env env;
+    Ort::SessionOptions session_options;
+    SessionFactory factory;
+    SessionCache sessions;
+    Ort::MemoryInfo memory_info;
+
+    std::mutex context_mutex;
+    std::vector<std::unique_ptr<InferenceContext>> spare_contexts;  // for submit()
+
+    struct AsyncRun;  // one runAsync() request, see inference_engine.cpp
+    void startStep(AsyncRun* run);
+    static void onStepDone(void* user_data, OrtValue** outputs, size_t num_outputs, OrtStatusPtr status);
+
+    std::unique_ptr<InferenceContext> acquireContext();
+    void releaseContext(std::unique_ptr<InferenceContext> context);
+
+public:
+    explicit InferenceEngine(const EngineOptions& options);
+
+    // Loads every session of `plan` in parallel.
+    void preload(const StitchPlan& plan);
+
+    // Runs `plan` on a CHW float image [3,224,224] and writes out_numClasses logits.
+    // Neither is copied: the first and last steps' tensors wrap the caller's buffers.
+    void run(const StitchPlan& plan, const float* image, float* logits, InferenceContext& context);
+
+    // Runs steps [first, last) of `plan` on the activations in `input`, ping-ponging
+    // with `spare`. Returns the buffer holding the result: `logits` if the plan's
+    // last step ran, otherwise `input` or `spare`.
+    float* runSteps(const StitchPlan& plan, size_t first, size_t last, float* input, float* spare, float* logits);
+
+    // Models every stitch id uses or may switch to: the embeds, the heads and the stitch layer bank.
+    static std::vector<std::string> hotModelNames();
+
+    // Faults in the mapped models and weights of the hot set: every session of `plan`
+    // plus the whole stitch layer bank, so switching stitches does not fault either.
+    // With `lock`, the hot set is also mlock()ed against reclaim under memory pressure.
+    PinStats pinHotSet(const StitchPlan& plan, bool lock);
+
+    // Starts `plan` on a CHW float image and returns without waiting for it. `done` is called
+    // once, with the error if any, after the logits are written; usually on an ORT thread,
+    // on the calling thread if the first step fails to start. `plan`, `logits` and `context`
+    // must stay alive until then, and `done` must not throw. RunAsync needs intra_op_threads >= 2.
+    // Sessions not loaded yet are loaded on the thread starting their step: preload() first.
+    void runAsync(const StitchPlan& plan, const float* image, float* logits, InferenceContext& context,
+                  std::function<void(std::exception_ptr)> done);
+
+    // Asynchronous infer(): the plan, activations (from a pool) and logits are owned by the request.
+    void submit(const std::vector<float>& image, int stitch_id,
+                std::function<void(std::vector<float> logits, std::exception_ptr error)> callback);
+    std::future<std::vector<float>> submit(const std::vector<float>& image, int stitch_id);
+
+    // Convenience wrapper: returns the logits.
+    std::vector<float> infer(const std::vector<float>& image, int stitch_id);
+
+    // Loads and runs `plan` once with EnvAllocator::Counting and returns the
+    // peak bytes held through the env allocator, for ArenaCalibration.
+    // Use a fresh engine per plan, so no other plan's sessions are counted.
+    size_t calibrateArena(const StitchPlan& plan, const float* image);
+
+    SessionCache& getSessionCache() {
+        return sessions;
+    }
+
+    SessionFactory& getSessionFactory() {
+        return factory;
+    }
+
+    const EngineOptions& getOptions() const {
+        return options;
+    }
+};
+
+#endif // INFERENCEENGINE_H
@@ -0,0 +1,99 @@
+#ifndef INFERENCESERVER_H
+#define INFERENCESERVER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "inference_engine.h"
+#include "request_executor.h"
+#include "stitch_plan.h"
+#include "stitch_selector.h"
+
+struct ServerOptions {
+    std::string unix_path = "/tmp/snnet.sock";  // empty: no Unix domain socket
+    int tcp_port = 0;                           // loopback TCP port, 0: none
+    std::string metrics_path;                   // Unix socket serving Metrics in the Prometheus format, empty: none
+    size_t workers = 0;                         // executor workers, 0: RequestExecutor::defaultWorkerCount()
+    size_t max_in_flight = 32;                  // requests per connection before it is no longer read, >= 1
+};
+
+struct ServerStats {
+    uint64_t connections, requests, errors;
+};
+
+/* Long-lived local server speaking the protocol of server_protocol.h.
+ * One thread runs a level-triggered epoll loop over the
+ * listeners and connections; complete requests go to a RequestExecutor, and
+ * finished ones come back through a list and an eventfd that wakes the loop.
+ * Every request gets an InferenceContext when its header arrives, and a raw
+ * tensor payload is read from the socket straight into the context's input
+ * buffer, which the first step's input tensor wraps: no copies in between.
+ * Budget requests get their stitch from a StitchSelector.
+ * Backpressure: a connection with max_in_flight requests started is not read
+ * until one completes, so a client pipelining more waits in its socket buffer
+ * instead of taking a context per request; spare contexts are kept for at most
+ * as many requests as there are executor workers.
+ * Connections to the metrics socket get one HTTP/1.0 response with the
+ * Prometheus text of Metrics::global() once they send anything (e.g. a GET)
+ * or shut down their side, and are then closed.
+ */
+class InferenceServer {
+private:
+    struct Connection;
+    struct ServerRequest;
+
+    InferenceEngine& engine;
+    ServerOptions options;
+    StitchSelector selector;
+    std::vector<std::unique_ptr<StitchPlan>> plans;     // by stitch id
+
+    int epoll_fd = -1, wake_fd = -1, unix_fd = -1, tcp_fd = -1, metrics_fd = -1;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+    uint64_t next_connection_id;
+    std::vector<std::unique_ptr<InferenceContext>> spare_contexts;  // used by the loop thread only
+
+    std::mutex completed_mutex;
+    std::vector<ServerRequest*> completed;
+    std::atomic<bool> stopping{ false };
+
+    std::atomic<uint64_t> num_connections{ 0 }, num_requests{ 0 }, num_errors{ 0 };
+
+    RequestExecutor executor;   // last, so its workers stop before anything they use goes away
+
+    void watch(int fd, uint64_t id, uint32_t events);
+    void updateEvents(Connection& connection);
+    void accept(int listen_fd, bool tcp, bool metrics);
+    void receive(Connection& connection);
+    void receiveMetricsRequest(Connection& connection);
+    bool startRequest(Connection& connection);
+    void send(Connection& connection);
+    void close(uint64_t id);
+    void recycleContext(std::unique_ptr<InferenceContext> context);
+    void drainCompleted();
+
+    void process(ServerRequest& request);
+    void complete(ServerRequest* request);
+
+public:
+    InferenceServer(InferenceEngine& engine, const ServerOptions& options);
+    ~InferenceServer();
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    // Serves until stop().
+    void run();
+
+    // Callable from any thread and from signal handlers.
+    void stop();
+
+    ServerStats getStats() const;
+};
+
+#endif // INFERENCESERVER_H
@@ -0,0 +1,41 @@
+#ifndef INFERENCETASK_H
+#define INFERENCETASK_H
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+
+#include "inference_engine.h"
+#include "request_executor.h"
+#include "stitch_plan.h"
+
+/* One inference request on a RequestExecutor.
+ * With `split_steps` each plan step is its own task: after a step the task
+ * pushes itself back onto its worker's deque, so an idle worker can steal the
+ * rest of the request while the owner picks up new ones. Otherwise the whole
+ * plan runs in one task. The context, logits and plan must outlive the task.
+ */
+class InferenceTask : public ExecutorTask {
+private:
+    RequestExecutor& executor;
+    InferenceEngine& engine;
+    const StitchPlan& plan;
+    float* logits;
+    InferenceContext& context;
+    std::function<void(std::exception_ptr)> done;
+    bool split_steps;
+
+    size_t next_step = 0;
+    float* input;
+    float* spare;
+
+public:
+    // Copies `image` into the context; `done` is called on the worker with the error, if any.
+    InferenceTask(RequestExecutor& executor, InferenceEngine& engine, const StitchPlan& plan, const float* image,
+                  float* logits, InferenceContext& context, std::function<void(std::exception_ptr)> done,
+                  bool split_steps = false);
+
+    void run() override;
+};
+
+#endif // INFERENCETASK_H
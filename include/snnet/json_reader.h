@@ -0,0 +1,65 @@
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Parsed JSON document, for reading tool outputs such as ORT profiles.
+ * Numbers are doubles; lookups of missing members or elements return a
+ * null value instead of throwing, so optional fields read naturally.
+ */
+class JsonValue {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+private:
+    Type type = Type::Null;
+    bool flag = false;
+    double number = 0;
+    std::string text;
+    std::vector<JsonValue> elements;
+    std::map<std::string, JsonValue> members;
+
+    friend class JsonParser;
+
+public:
+    // Throws std::runtime_error with the offset of the first syntax error.
+    static JsonValue parse(const std::string& document);
+    static JsonValue parseFile(const std::string& path);
+
+    Type getType() const {
+        return type;
+    }
+
+    bool isNull() const {
+        return type == Type::Null;
+    }
+
+    bool isArray() const {
+        return type == Type::Array;
+    }
+
+    bool isObject() const {
+        return type == Type::Object;
+    }
+
+    // `fallback` if the value is not of that type
+    bool asBool(bool fallback = false) const;
+    double asNumber(double fallback = 0) const;
+    const std::string& asString() const;    // "" if not a string
+
+    const std::vector<JsonValue>& getElements() const {
+        return elements;
+    }
+
+    const std::map<std::string, JsonValue>& getMembers() const {
+        return members;
+    }
+
+    const JsonValue& operator[](const std::string& name) const;
+    const JsonValue& operator[](size_t index) const;
+};
+
+#endif // JSONREADER_H
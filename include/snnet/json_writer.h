@@ -0,0 +1,53 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Streaming JSON writer for reports. Pretty-prints one member or element per
+ * line, so reports from different runs diff cleanly. Inside objects, call
+ * key() before every value or begin*(). Non-finite numbers are written as null.
+ */
+class JsonWriter {
+private:
+    std::ostream& out;
+    std::vector<bool> empty_scopes;     // per open object/array: nothing written in it yet
+    bool after_key = false;
+    bool compact;
+
+    void separate();
+    void close(char bracket);
+
+public:
+    // `compact`: everything on one line, e.g. for NDJSON records.
+    explicit JsonWriter(std::ostream& out, bool compact = false);
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+
+    JsonWriter& key(const std::string& name);
+    JsonWriter& value(const std::string& text);
+    JsonWriter& value(const char* text);
+    JsonWriter& value(double number);
+    // With `decimals` fixed decimals instead of 6 significant digits, e.g. for timestamps
+    JsonWriter& value(double number, int decimals);
+    JsonWriter& value(int64_t number);
+    JsonWriter& value(uint64_t number);
+    JsonWriter& value(int number);
+    JsonWriter& value(bool flag);
+
+    // key(name).value(v)
+    template <typename T>
+    JsonWriter& member(const std::string& name, const T& v) {
+        return key(name).value(v);
+    }
+
+    // `text` as a JSON string literal, with quotes.
+    static std::string quote(const std::string& text);
+};
+
+#endif // JSONWRITER_H
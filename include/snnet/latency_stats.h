@@ -0,0 +1,17 @@
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <cstddef>
+#include <vector>
+
+/* Order statistics of a set of latency samples, in the samples' unit.
+ * Percentiles are nearest-rank, so they are always one of the samples.
+ */
+struct LatencySummary {
+    size_t count = 0;
+    double mean = 0, min = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+
+    static LatencySummary of(std::vector<double> samples);
+};
+
+#endif // LATENCYSTATS_H
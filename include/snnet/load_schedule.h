@@ -0,0 +1,54 @@
+#ifndef LOADSCHEDULE_H
+#define LOADSCHEDULE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* One request of a load test, `at_ms` after the start of the run */
+struct Arrival {
+    double at_ms;
+    int stitch_id;  // -1: chosen for the latency budget
+    int image_id;
+};
+
+enum class ArrivalPattern {
+    Uniform,    // evenly spaced
+    Poisson,    // exponential gaps
+    Bursty      // Poisson bursts of several requests arriving together
+};
+
+/* Arrival times of an open-loop load test: requests are sent when they are due,
+ * whether or not earlier ones have finished, so queueing shows in the latencies.
+ * Either generated for a rate, or replayed from a trace of
+ * "<ms> <stitch id> <image id>" lines, sorted by time ('#' starts a comment);
+ * save() writes the same format, so a generated run can be replayed.
+ */
+class LoadSchedule {
+private:
+    std::vector<Arrival> arrivals;
+
+public:
+    // `rate` requests/s over `duration_s`, all for `stitch_id`, with image ids drawn from [0, num_images).
+    // Bursty: bursts of `burst` requests, the bursts arriving at rate / burst.
+    static LoadSchedule generate(ArrivalPattern pattern, double rate, double duration_s, int stitch_id,
+                                 int num_images, int burst = 8, uint32_t seed = 1);
+
+    static LoadSchedule load(const std::string& path);
+    void save(const std::string& path) const;
+
+    // Replays `speed` times faster.
+    void scale(double speed);
+
+    // "uniform", "poisson" or "bursty"
+    static ArrivalPattern parsePattern(const std::string& name);
+
+    // Requests/s over the whole schedule.
+    double offeredRate() const;
+
+    const std::vector<Arrival>& getArrivals() const {
+        return arrivals;
+    }
+};
+
+#endif // LOADSCHEDULE_H
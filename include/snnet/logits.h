@@ -0,0 +1,16 @@
+#ifndef LOGITS_H
+#define LOGITS_H
+
+#include <cstddef>
+#include <vector>
+
+/* Class picks over a model's logits */
+struct Logits {
+    // Index of the largest of `n` logits, the first one on ties.
+    static int argmax(const float* logits, size_t n);
+
+    // Indices of the min(k, n) largest logits, largest first.
+    static std::vector<int> topK(const float* logits, size_t n, size_t k);
+};
+
+#endif // LOGITS_H
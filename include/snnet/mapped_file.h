@@ -0,0 +1,58 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Read-only memory mapping of a whole file.
+ * The mapping is shared, so every process mapping the same file
+ * uses the same physical pages through the page cache.
+ * Files of 2 MB and more are mapped huge page aligned and advised for
+ * transparent huge pages, which the kernel may use for read-only files.
+ */
+class MappedFile {
+private:
+    std::string path;
+    uint8_t* addr;
+    size_t length;
+
+    void release();
+
+public:
+    MappedFile();
+    explicit MappedFile(const std::string& file_path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Throws std::runtime_error if the file cannot be opened or mapped.
+    void open(const std::string& file_path);
+
+    bool isOpen() const {
+        return addr != nullptr;
+    }
+
+    const uint8_t* data() const {
+        return addr;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    // Faults in [offset, offset + bytes) now, so first accesses do not stall. Returns the bytes covered.
+    size_t prefault(size_t offset, size_t bytes) const;
+
+    // mlock()s [offset, offset + bytes). Returns false if the kernel refused.
+    bool lock(size_t offset, size_t bytes) const;
+
+    const std::string& getPath() const {
+        return path;
+    }
+};
+
+#endif // MAPPEDFILE_H
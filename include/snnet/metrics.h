@@ -0,0 +1,125 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+
+/* Log-linear latency histogram in microseconds, in the style of HdrHistogram:
+ * every power of two is split into 16 linear sub-buckets, so a bucket is at
+ * most 1/16 of its values wide, from 1 us up to 2^32 us (longer values land
+ * in the last bucket). Recording is three relaxed fetch_adds: wait-free
+ * wherever the CPU has an atomic add (x86, ARMv8.1), lock-free elsewhere.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int sub_bucket_bits = 4;
+    static constexpr int max_exponent = 31;
+    static constexpr size_t num_buckets = static_cast<size_t>(max_exponent - sub_bucket_bits + 2) << sub_bucket_bits;
+
+    struct Snapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum_us = 0;
+
+        // Values <= limit_us, at bucket resolution: a bucket counts if all its values are
+        uint64_t countAtMost(uint64_t limit_us) const;
+        // Upper bound of the bucket holding the q quantile, 0 if empty
+        uint64_t quantile(double q) const;
+    };
+
+private:
+    std::atomic<uint64_t> buckets[num_buckets]{};
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> sum_us{ 0 };
+
+public:
+    void record(uint64_t value_us) {
+        buckets[bucketOf(value_us)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum_us.fetch_add(value_us, std::memory_order_relaxed);
+    }
+
+    uint64_t getCount() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    // Not atomic as a whole: recordings made meanwhile may be half counted.
+    Snapshot snapshot() const;
+
+    static size_t bucketOf(uint64_t value_us);
+    static uint64_t bucketUpperBound(size_t bucket);
+};
+
+/* Process-wide metrics, always on: latency histograms per (stitch id, plan
+ * step) and per stitch id, and counters of requests, batches and session
+ * cache activity. Recorders only touch preallocated atomics (about 4 MB of
+ * histograms for all stitch ids), so they can run on every request from any
+ * thread.
+ * Exported in the Prometheus text format (version 0.0.4) on demand: by
+ * snnet-onnx --serve on its metrics socket, or as a file.
+ */
+class Metrics {
+public:
+    static constexpr size_t max_plan_steps = vit_depth + 3;    // embed, layers, stitch, head
+
+private:
+    std::unique_ptr<LatencyHistogram[]> steps;      // [stitch id * max_plan_steps + step]
+    std::unique_ptr<LatencyHistogram[]> requests;   // [stitch id]
+    LatencyHistogram session_loads;
+
+    std::atomic<uint64_t> request_errors{ 0 };
+    std::atomic<uint64_t> batches{ 0 }, batch_images{ 0 };
+    std::atomic<uint64_t> cache_hits{ 0 }, demand_loads{ 0 }, prefetch_loads{ 0 }, evictions{ 0 };
+
+    Metrics();
+
+    static bool valid(int stitch_id);
+
+public:
+    // Never destroyed, so threads still running at exit can record.
+    static Metrics& global();
+
+    static uint64_t microsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /* Recording, from any thread; out-of-range stitch ids and steps are ignored */
+    void recordStep(int stitch_id, size_t step, uint64_t latency_us);
+    void recordRequest(int stitch_id, uint64_t latency_us);
+    void countRequestError() {
+        request_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    void countBatch(size_t images) {
+        batches.fetch_add(1, std::memory_order_relaxed);
+        batch_images.fetch_add(images, std::memory_order_relaxed);
+    }
+    void countCacheHit() {
+        cache_hits.fetch_add(1, std::memory_order_relaxed);
+    }
+    void recordSessionLoad(bool prefetch, uint64_t latency_us) {
+        (prefetch ? prefetch_loads : demand_loads).fetch_add(1, std::memory_order_relaxed);
+        session_loads.record(latency_us);
+    }
+    void countEviction() {
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const LatencyHistogram& getStepHistogram(int stitch_id, size_t step) const;
+    const LatencyHistogram& getRequestHistogram(int stitch_id) const;
+
+    /* Export */
+    void writePrometheus(std::ostream& out) const;
+    std::string prometheusText() const;
+    // Written to a temporary file and renamed, so readers never see a partial file.
+    void writeFile(const std::string& path) const;
+};
+
+#endif // METRICS_H
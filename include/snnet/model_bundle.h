@@ -0,0 +1,87 @@
+#ifndef MODELBUNDLE_H
+#define MODELBUNDLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.h"
+
+/* Single-file model bundle written by "snnet-pack --bundle".
+ * Holds the embed, layer, stitch and head models with a table of contents
+ * and a checksum per model. Each model starts on its own page so that
+ * sessions are created straight from the mapped file.
+ *
+ * Layout (little-endian):
+ *   [0, page)      ModelBundleHeader
+ *   [page, toc)    models, page-aligned
+ *   [toc, end)     per model: name, offset, size, FNV-1a 64 checksum
+ */
+
+constexpr const char* model_bundle_file = "models.snb";
+constexpr uint64_t model_bundle_page = 4096;
+
+struct ModelBundleHeader {
+    char magic[4];          // "SNMB"
+    uint32_t version;
+    uint32_t model_count;
+    uint32_t reserved;
+    uint64_t toc_offset;
+    uint64_t toc_size;
+};
+
+/* Offline side, used by snnet-pack */
+class ModelBundleWriter {
+private:
+    std::ofstream out;
+    std::string path;
+    uint64_t offset;
+    uint32_t model_count;
+    std::string toc;
+
+public:
+    explicit ModelBundleWriter(const std::string& bundle_path);
+
+    void addModel(const std::string& model_name, const std::string& model);
+
+    // Writes the table of contents and header. Returns the total bundle size.
+    uint64_t finish();
+};
+
+/* Runtime side */
+class ModelBundle {
+private:
+    struct Entry {
+        uint64_t offset, size, checksum;
+        std::unique_ptr<std::atomic<bool>> verified;
+    };
+
+    MappedFile file;
+    std::unordered_map<std::string, Entry> entries;
+
+public:
+    // Throws std::runtime_error if the bundle is missing or its table of contents is malformed.
+    explicit ModelBundle(const std::string& bundle_path);
+
+    bool hasModel(const std::string& model_name) const {
+        return entries.count(model_name) != 0;
+    }
+
+    // Returns the model bytes inside the mapping. The checksum is verified on first access;
+    // throws std::runtime_error on a mismatch or an unknown model.
+    std::pair<const uint8_t*, size_t> getModel(const std::string& model_name) const;
+
+    std::vector<std::string> getModelNames() const;
+
+    const MappedFile& getFile() const {
+        return file;
+    }
+
+    static uint64_t checksum(const uint8_t* data, size_t size);
+};
+
+#endif // MODELBUNDLE_H
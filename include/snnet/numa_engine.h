@@ -0,0 +1,62 @@
+#ifndef NUMAENGINE_H
+#define NUMAENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "inference_engine.h"
+#include "numa_topology.h"
+#include "stitch_plan.h"
+
+/* One InferenceEngine replica per NUMA node, each request served by one node.
+ * A replica's ORT threads are pinned to its node's CPUs, its activations and
+ * a copy of the hot weights (embeds, heads, stitch bank) live on its node,
+ * and its sessions are loaded by threads on the node, so their arenas and
+ * prepacked weights are node-local too. A request goes to the node of the
+ * CPU the caller runs on, and the caller is kept on that node until the
+ * request is done, so activations never cross sockets mid-stitch.
+ * The ORT env (and so its global pools and env allocator) is per process,
+ * so replicas use per-session thread pools and allocators.
+ */
+class NumaEngine {
+private:
+    struct Replica {
+        NumaNode node;
+        std::unique_ptr<InferenceEngine> engine;
+        std::atomic<uint64_t> requests{ 0 };
+    };
+
+    NumaTopology topology;
+    std::vector<std::unique_ptr<Replica>> replicas;
+
+    size_t route() const;
+
+public:
+    explicit NumaEngine(const EngineOptions& options, const NumaTopology& topology = NumaTopology::detect());
+
+    // Loads the plan's sessions on every node at once, each from threads on that node.
+    void preload(const StitchPlan& plan);
+
+    // Runs `plan` on the caller's node; see InferenceEngine::run. Returns the replica used.
+    size_t run(const StitchPlan& plan, const float* image, float* logits);
+
+    size_t getNumReplicas() const {
+        return replicas.size();
+    }
+
+    const NumaNode& getNode(size_t replica) const {
+        return replicas[replica]->node;
+    }
+
+    InferenceEngine& getEngine(size_t replica) {
+        return *replicas[replica]->engine;
+    }
+
+    uint64_t getRequestCount(size_t replica) const {
+        return replicas[replica]->requests.load();
+    }
+};
+
+#endif // NUMAENGINE_H
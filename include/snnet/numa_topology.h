@@ -0,0 +1,51 @@
+#ifndef NUMATOPOLOGY_H
+#define NUMATOPOLOGY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+/* NUMA nodes of the host and their CPUs, from /sys/devices/system/node.
+ * Hosts without that directory (or without NUMA) are one node with every CPU.
+ */
+class NumaTopology {
+private:
+    std::vector<NumaNode> nodes;
+
+public:
+    static NumaTopology detect(const std::string& sys_node_dir = "/sys/devices/system/node");
+
+    // Longest list parseCpuList() expands to
+    static constexpr size_t max_list_size = 65536;
+
+    // Parses the kernel's CPU list format, e.g. "0-3,8-11"; empty entries are skipped.
+    // Throws std::invalid_argument for an entry that is not N or A-B with 0 <= A <= B,
+    // or when the ranges add up to more than max_list_size numbers.
+    static std::vector<int> parseCpuList(const std::string& list);
+
+    const std::vector<NumaNode>& getNodes() const {
+        return nodes;
+    }
+
+    // Node of `cpu`, 0 if unknown.
+    int nodeOfCpu(int cpu) const;
+};
+
+/* CPU affinity of the calling thread */
+struct CpuAffinity {
+    // Restricts the calling thread (and threads it creates later) to `cpus`.
+    // Returns false if the kernel refused, e.g. CPUs outside the cgroup's cpuset.
+    static bool pinCurrentThread(const std::vector<int>& cpus);
+
+    static std::vector<int> currentThread();
+
+    // CPU the calling thread runs on right now, -1 if unknown.
+    static int currentCpu();
+};
+
+#endif // NUMATOPOLOGY_H
@@ -0,0 +1,46 @@
+#ifndef ONNXPROTO_H
+#define ONNXPROTO_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* Minimal protobuf wire-format codec for the parts of onnx.proto we touch.
+ * Only the main graph's initializers are decoded, everything else in the
+ * model is copied through byte for byte, so no protobuf/onnx dependency is needed.
+ */
+
+// TensorProto found in GraphProto.initializer
+struct OnnxInitializer {
+    std::string name;
+    int32_t data_type = 0;  // TensorProto.DataType, same values as ONNXTensorElementDataType
+    std::vector<int64_t> dims;
+    std::string data;       // little-endian tensor contents (raw_data layout)
+};
+
+// Value of TensorProto.external_data for an externalized initializer
+struct OnnxExternalData {
+    std::string location;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
+class OnnxProto {
+public:
+    // Returns the size in bytes of one element, or 0 for types we do not externalize (e.g. STRING).
+    static size_t elementSize(int32_t data_type);
+
+    // Returns all initializers of the main graph that carry inline data.
+    static std::vector<OnnxInitializer> readInitializers(const std::string& model);
+
+    // Rewrites `model`, calling `externalize` for every initializer with inline data.
+    // If it returns true, the initializer is replaced by an external data reference
+    // (data_location = EXTERNAL) with the location/offset/length it filled in.
+    // Throws std::runtime_error on malformed input.
+    static std::string externalizeInitializers(
+        const std::string& model,
+        const std::function<bool(const OnnxInitializer&, OnnxExternalData&)>& externalize);
+};
+
+#endif // ONNXPROTO_H
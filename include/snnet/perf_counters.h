@@ -0,0 +1,71 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class PerfEvent { Cycles, Instructions, LlcMisses, DtlbMisses, BranchMisses };
+
+constexpr size_t num_perf_events = 5;
+
+/* Counts of one measured interval, by PerfEvent. Counts are scaled up
+ * by enabled / running time when the kernel multiplexed the group.
+ */
+struct PerfSample {
+    uint64_t counts[num_perf_events] = {};
+    bool valid[num_perf_events] = {};   // the event could be opened on this host
+
+    uint64_t get(PerfEvent event) const {
+        return counts[static_cast<size_t>(event)];
+    }
+
+    bool has(PerfEvent event) const {
+        return valid[static_cast<size_t>(event)];
+    }
+
+    PerfSample& operator+=(const PerfSample& other);
+};
+
+/* Hardware counters of the calling thread, user space only, read with perf_event_open
+ * as one group so all events cover the same instructions. Events the CPU or the
+ * hypervisor does not expose are left out; without cycles, nothing is counted.
+ * Opening needs perf_event_paranoid <= 2 (or CAP_PERFMON). Only the thread that
+ * constructed the object is counted: measure ORT with one intra-op thread, which
+ * runs the kernels on the calling thread.
+ */
+class PerfCounters {
+private:
+    int fds[num_perf_events];
+    size_t group_index[num_perf_events];    // position in the group read, for the opened events
+    size_t num_open = 0;
+    std::string error;
+
+    bool read(uint64_t* counts) const;
+
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const {
+        return num_open > 0;
+    }
+
+    // Why the counters are not available, e.g. the perf_event_open error.
+    const std::string& getError() const {
+        return error;
+    }
+
+    // Zeroes and starts the counters.
+    void start();
+
+    // Stops the counters and returns the counts since start().
+    PerfSample stop();
+
+    static const char* eventName(PerfEvent event);
+};
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,76 @@
+#ifndef PIPELINEEXECUTOR_H
+#define PIPELINEEXECUTOR_H
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "inference_engine.h"
+#include "spsc_queue.h"
+#include "stitch_plan.h"
+
+/* Pipeline-parallel execution of one stitch plan over a stream of images.
+ * The plan's steps are split into stages of balanced CostTable cost. Each
+ * stage runs on its own thread pinned to its own core, and hands each job
+ * (one image's activation buffers) to the next stage through an SpscQueue.
+ * Once the pipeline is full, an image completes every slowest-stage time
+ * instead of every whole-plan time.
+ * Meant for engines with intra_op_threads = 1, so the operators of a stage
+ * run on that stage's thread. submit() and wait() must be called from one thread.
+ */
+class PipelineExecutor {
+private:
+    struct Job {
+        explicit Job(int numa_node) : context(numa_node) {}
+
+        InferenceContext context;
+        float* current = nullptr;   // buffer holding the activations between stages
+        float* logits = nullptr;
+        bool failed = false;
+    };
+
+    InferenceEngine& engine;
+    StitchPlan plan;
+    std::vector<size_t> bounds;                 // stage i runs steps [bounds[i], bounds[i + 1])
+    std::vector<std::unique_ptr<Job>> jobs;
+    std::vector<Job*> free_jobs;                // owned by the submitting thread
+    // queues[i] feeds stage i; the last one returns finished jobs to the submitting thread
+    std::vector<std::unique_ptr<SpscQueue<Job*>>> queues;
+    std::vector<std::thread> threads;
+    size_t in_flight = 0;
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    void stageLoop(size_t stage, int core);
+    void complete(Job* job);
+
+public:
+    // `cores`: the core of each stage; empty to go round the engine's cpu_affinity (or all cores).
+    PipelineExecutor(InferenceEngine& engine, const StitchPlan& plan, size_t num_stages,
+        const std::vector<int>& cores = {});
+    ~PipelineExecutor();
+
+    PipelineExecutor(const PipelineExecutor&) = delete;
+    PipelineExecutor& operator=(const PipelineExecutor&) = delete;
+
+    size_t getNumStages() const {
+        return bounds.size() - 1;
+    }
+
+    const std::vector<size_t>& getStageBounds() const {
+        return bounds;
+    }
+
+    // Queues a CHW float image [3,224,224]; its logits are written to `logits` once it completes.
+    // The image is copied, so it can be reused on return. Blocks while every job slot is in flight.
+    void submit(const float* image, float* logits);
+
+    // Waits for every submitted image. Rethrows the first error of a stage, if any.
+    void wait();
+};
+
+#endif // PIPELINEEXECUTOR_H
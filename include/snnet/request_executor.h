@@ -0,0 +1,99 @@
+#ifndef REQUESTEXECUTOR_H
+#define REQUESTEXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mpmc_queue.h"
+#include "work_stealing_deque.h"
+
+/* Unit of work for RequestExecutor. The executor does not own tasks:
+ * run() may delete or resubmit its own task, but nothing touches it after run() returns.
+ */
+class ExecutorTask {
+public:
+    virtual ~ExecutorTask() = default;
+    virtual void run() = 0;
+};
+
+/* Work-stealing thread pool for a serving process.
+ * Tasks submitted from outside go through a lock-free MPMC ingress queue;
+ * tasks submitted by a worker (e.g. the next step of a request) go onto
+ * that worker's own Chase-Lev deque. A worker runs its own deque LIFO,
+ * then the ingress queue, then steals FIFO from the other workers, and
+ * parks only when all of them are empty.
+ *
+ * Requests run ORT sessions on the worker thread, and each Run also uses
+ * the (global) intra-op pool's threads, so by default the pool leaves
+ * intra_op_threads - 1 cores to ORT instead of oversubscribing them.
+ */
+class RequestExecutor {
+private:
+    struct Worker {
+        explicit Worker(size_t capacity) : deque(capacity) {}
+
+        WorkStealingDeque<ExecutorTask> deque;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    MpmcQueue<ExecutorTask*> ingress;
+
+    std::mutex park_mutex;
+    std::condition_variable park_cv;
+    std::atomic<int> sleepers{ 0 };
+    std::atomic<bool> stopping{ false };
+
+    std::atomic<int64_t> pending{ 0 };  // submitted and not yet finished
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+
+    std::atomic<uint64_t> steals{ 0 };
+
+    void workerLoop(size_t index, int cpu);
+    ExecutorTask* findTask(size_t index, uint32_t& rng);
+    bool hasWork() const;
+    void wake();
+    void finished();
+
+public:
+    // `num_workers` 0: defaultWorkerCount(1). `cpus`: worker i is pinned to cpus[i % size]; empty: not pinned.
+    explicit RequestExecutor(size_t num_workers = 0, const std::vector<int>& cpus = {}, size_t queue_capacity = 4096);
+    ~RequestExecutor();
+
+    RequestExecutor(const RequestExecutor&) = delete;
+    RequestExecutor& operator=(const RequestExecutor&) = delete;
+
+    // Cores minus the threads of ORT's intra-op pool (the caller of Run is one of its threads).
+    static size_t defaultWorkerCount(int intra_op_threads);
+
+    // Queues `task`; from a worker of this executor it goes onto that worker's deque.
+    // Blocks (spinning) while the ingress queue is full.
+    void submit(ExecutorTask* task);
+
+    // Convenience for one-off work; allocates a task.
+    void submit(std::function<void()> fn);
+
+    // Waits until every submitted task has finished, including tasks they submitted.
+    void waitIdle();
+
+    size_t getNumWorkers() const {
+        return workers.size();
+    }
+
+    uint64_t getStealCount() const {
+        return steals.load(std::memory_order_relaxed);
+    }
+
+    // Index of the calling worker of this executor, -1 on other threads.
+    int currentWorker() const;
+};
+
+#endif // REQUESTEXECUTOR_H
@@ -0,0 +1,22 @@
+#ifndef RESOURCEUSAGE_H
+#define RESOURCEUSAGE_H
+
+#include <cstddef>
+
+/* Snapshot of the process' threads and memory, from /proc/self/status,
+ * and its page faults, context switches and CPU time so far, from getrusage()
+ */
+struct ResourceUsage {
+    int threads = 0;
+    size_t rss_bytes = 0;       // VmRSS
+    size_t peak_rss_bytes = 0;  // VmHWM
+    long minor_faults = 0;      // served from memory (page cache, zeroed pages)
+    long major_faults = 0;      // needed I/O
+    long voluntary_switches = 0;    // a thread blocked: lock, condition variable, I/O
+    long involuntary_switches = 0;  // a thread was preempted: more runnable threads than cores
+    double cpu_s = 0;               // user + system, all threads
+
+    static ResourceUsage current();
+};
+
+#endif // RESOURCEUSAGE_H
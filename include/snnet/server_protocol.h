@@ -0,0 +1,55 @@
+#ifndef SERVERPROTOCOL_H
+#define SERVERPROTOCOL_H
+
+#include <cstdint>
+
+/* Wire format of snnet-onnx --serve, little-endian.
+ * Every message is a fixed header followed by `length` payload bytes.
+ * A connection may pipeline requests; responses carry the request id and
+ * can come back in a different order.
+ *
+ * Request payload: the encoded image (JPEG, PNG, ...) or the preprocessed
+ * CHW float tensor [3,224,224], as raw bytes.
+ * Response payload: status 0: out_numClasses float logits, or top_k x
+ * (int32 class, float logit) if top_k was set; otherwise an error message.
+ */
+
+constexpr uint32_t request_magic = 0x51524e53;   // "SNRQ"
+constexpr uint32_t response_magic = 0x53524e53;  // "SNRS"
+constexpr uint32_t max_request_payload = 16 * 1024 * 1024;
+
+enum class PayloadKind : uint8_t {
+    EncodedImage = 0,
+    Tensor = 1,
+};
+
+enum class ResponseStatus : int32_t {
+    Ok = 0,
+    BadRequest = 1,
+    Failed = 2,
+};
+
+struct RequestHeader {
+    uint32_t magic;
+    uint32_t length;        // payload bytes
+    uint32_t request_id;
+    uint8_t kind;           // PayloadKind
+    uint8_t top_k;          // 0: all logits
+    uint16_t reserved;
+    int32_t stitch_id;      // -1: chosen for budget_ms
+    float budget_ms;
+};
+
+struct ResponseHeader {
+    uint32_t magic;
+    uint32_t length;
+    uint32_t request_id;
+    int32_t status;         // ResponseStatus
+    int32_t stitch_id;
+    float latency_ms;       // inference only, without queueing
+};
+
+static_assert(sizeof(RequestHeader) == 24, "RequestHeader is sent as is");
+static_assert(sizeof(ResponseHeader) == 24, "ResponseHeader is sent as is");
+
+#endif // SERVERPROTOCOL_H
@@ -0,0 +1,117 @@
+#ifndef SESSIONCACHE_H
+#define SESSIONCACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "session_factory.h"
+
+struct SessionLoadStats {
+    std::string model_name;
+    double load_ms;
+    size_t model_bytes;
+};
+
+struct SessionCacheStats {
+    uint64_t hits, misses, prefetches, evictions;
+    size_t resident_bytes, memory_budget;
+    size_t resident_sessions;
+    uint64_t lock_acquisitions, lock_contentions;   // by get() and prefetch(); contended: had to wait
+    double lock_wait_ms;
+};
+
+/* Keeps the sessions of the models in use, under an optional memory budget.
+ * Sessions are created lazily on first use by get(), ahead of time in
+ * parallel by preload(), or in the background by prefetch(). A model is
+ * only ever loaded once; callers asking for a model being loaded wait for it.
+ *
+ * Each session is charged its factory footprint estimate (model + weights).
+ * When a load would exceed the budget, the least recently used sessions
+ * that nobody holds are evicted first. Sessions still held by a caller
+ * are never destroyed under it, so the budget can be exceeded briefly.
+ */
+class SessionCache {
+private:
+    struct Entry {
+        std::shared_ptr<Ort::Session> session;
+        bool loading = false;
+        size_t footprint = 0;
+        bool in_lru = false;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    SessionFactory& factory;
+    mutable std::mutex mutex;
+    std::condition_variable loaded_cv;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru; // front: most recently used
+    size_t memory_budget = 0;   // 0: unlimited
+    size_t resident_bytes = 0;
+    uint64_t hits = 0, misses = 0, prefetches = 0, evictions = 0;
+    std::vector<SessionLoadStats> load_stats;
+    uint64_t lock_acquisitions = 0, lock_contentions = 0;
+    double lock_wait_ms = 0;
+
+    std::thread prefetch_thread;
+    std::deque<std::string> prefetch_queue;
+    std::deque<std::string> release_queue;  // releaseLater()
+    std::condition_variable prefetch_cv;
+    bool stopping = false;
+
+    // Locks `lock`, counting whether and how long it had to wait for another thread.
+    void lockCounted(std::unique_lock<std::mutex>& lock);
+    std::shared_ptr<Ort::Session> acquire(const std::string& model_name, bool prefetch);
+    void touch(const std::string& model_name, Entry& entry);
+    // Drops unused sessions, least recently used first, until `incoming` more bytes fit.
+    // The dropped sessions are moved to `evicted` so they are destroyed outside the lock.
+    void evictFor(size_t incoming, std::vector<std::shared_ptr<Ort::Session>>& evicted);
+    void prefetchLoop();
+
+public:
+    explicit SessionCache(SessionFactory& factory);
+    ~SessionCache();
+
+    SessionCache(const SessionCache&) = delete;
+    SessionCache& operator=(const SessionCache&) = delete;
+
+    // Budget for resident sessions in bytes, 0 for unlimited.
+    void setMemoryBudget(size_t bytes);
+
+    // Returns the session for `model_name`, loading it if needed.
+    std::shared_ptr<Ort::Session> get(const std::string& model_name);
+
+    // Loads all `model_names` on `num_threads` threads (0: one per core).
+    // Rethrows the first load error after all threads have finished.
+    void preload(const std::vector<std::string>& model_names, int num_threads = 0);
+
+    // Queues `model_name` to be loaded by the background thread. Load errors
+    // are not reported here; a later get() retries and throws them.
+    void prefetch(const std::string& model_name);
+
+    // Evicts `model_name` now if nobody holds its session (streaming mode).
+    void release(const std::string& model_name);
+
+    // release() on the background thread, for callers that must not destroy the session:
+    // an ORT completion callback runs on a thread of the session's own pool, which the
+    // session destructor joins.
+    void releaseLater(const std::string& model_name);
+
+    bool isResident(const std::string& model_name) const;
+
+    // Load time of every load so far, in load order (a model evicted and reloaded appears twice).
+    std::vector<SessionLoadStats> getLoadStats() const;
+
+    SessionCacheStats getStats() const;
+};
+
+#endif // SESSIONCACHE_H
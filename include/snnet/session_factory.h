@@ -0,0 +1,111 @@
+#ifndef SESSIONFACTORY_H
+#define SESSIONFACTORY_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "model_bundle.h"
+#include "weight_store.h"
+
+struct PinStats {
+    size_t prefaulted_bytes = 0;
+    size_t locked_bytes = 0;
+    bool lock_failed = false;   // mlock refused, usually RLIMIT_MEMLOCK
+};
+
+/* Creates ORT sessions by model name (e.g. "deit_tiny_patch16_224_layer_0").
+ * Models are read from "<model_dir>/<name>.onnx", or from a packed
+ * directory written by snnet-pack: a model bundle is used in place of
+ * the separate files, and initializers come from the weight store.
+ * Optionally all sessions share one prepacked weights container, so
+ * weights prepacked by one session (e.g. MatMul B matrices) are reused.
+ * With an ORT cache directory, the first load of a model optimizes it at
+ * the highest level and saves it in ORT format; later loads map the saved
+ * model and skip graph optimization. ORT format models embed their weights,
+ * so cached sessions do not share the weight store's.
+ * create() may be called from several threads at once.
+ */
+class SessionFactory {
+private:
+    const Ort::Env& env;
+    Ort::SessionOptions session_options;
+    std::string model_dir;
+    std::unique_ptr<WeightStore> weight_store;
+    std::unique_ptr<ModelBundle> model_bundle;
+    OrtPrepackedWeightsContainer* prepacked_weights = nullptr;
+    std::function<void(const std::string&, Ort::SessionOptions&)> session_tuner;
+
+    std::string ort_cache_dir;
+    std::string ort_cache_tag; // ORT version, CPU features and options
+    std::mutex ort_models_mutex;
+    std::unordered_map<std::string, std::unique_ptr<MappedFile>> ort_models; // used in place by their sessions
+    std::unordered_set<std::string> local_models;   // ORT format models copied to `local_node`
+    std::unordered_map<std::string, HugePageBuffer> local_ort_models;
+    int local_node = -1;
+
+    Ort::Session createFromSource(const std::string& model_name, const Ort::SessionOptions& options);
+    Ort::Session createFromOrtCache(const std::string& model_name, const std::string& cached_path);
+
+public:
+    SessionFactory(const Ort::Env& env, const Ort::SessionOptions& options, const std::string& model_dir);
+    ~SessionFactory();
+
+    SessionFactory(const SessionFactory&) = delete;
+    SessionFactory& operator=(const SessionFactory&) = delete;
+
+    // Shares one prepacked weights container between all sessions created from now on.
+    void sharePrepackedWeights();
+
+    // Lets `tuner` adjust the options of each session before it is created (see TuningTable).
+    void setSessionTuner(std::function<void(const std::string& model_name, Ort::SessionOptions& options)> tuner);
+
+    // Loads models from `packed_dir` with their weights mapped from its weight store.
+    void useWeightStore(const std::string& packed_dir);
+
+    // Creates sessions from the models inside the mapped bundle instead of separate files.
+    void useBundle(const std::string& bundle_path);
+
+    // Picks up whatever snnet-pack wrote to `packed_dir` (bundle and/or weight store).
+    // Returns false if the directory holds neither.
+    bool usePackedDir(const std::string& packed_dir);
+
+    bool hasWeightStore() const {
+        return weight_store != nullptr;
+    }
+
+    // Caches optimized models in ORT format under `cache_dir`. `options_tag` must describe
+    // the session options that affect optimization, as it is part of the cache key.
+    void useOrtCache(const std::string& cache_dir, const std::string& options_tag);
+
+    std::string getModelPath(const std::string& model_name) const;
+
+    // Path of the cached ORT format model, keyed by ORT version, CPU features,
+    // options tag and the source model.
+    std::string getOrtCachePath(const std::string& model_name) const;
+
+    // Size of the serialized model, excluding weights held by the weight store.
+    size_t getModelSize(const std::string& model_name) const;
+
+    // Estimated resident size of a session: the serialized model plus its weights.
+    size_t getModelFootprint(const std::string& model_name) const;
+
+    Ort::Session create(const std::string& model_name);
+
+    // Keeps the weights of `model_names` on NUMA node `numa_node`: weight store ranges are copied
+    // now, ORT format models when first loaded. Call before their sessions are created.
+    void localizeModels(const std::vector<std::string>& model_names, int numa_node);
+
+    // Faults in, and with `lock` mlock()s, the mapped bytes the sessions of `model_names`
+    // read from: their ORT format model if one is mapped, else their bundle entry and weights.
+    // Models read from plain .onnx files live in ORT's heap and are skipped.
+    PinStats pinModels(const std::vector<std::string>& model_names, bool lock);
+};
+
+#endif // SESSIONFACTORY_H
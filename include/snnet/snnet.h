@@ -0,0 +1,94 @@
+#ifndef SNNET_H
+#define SNNET_H
+
+/* C API of libsnnet, for embedding the engine in a host application.
+ *
+ * Buffers are the caller's: the image is read in place by the first model and
+ * the logits are written in place by the last one, with no copies in between
+ * (except in snnet_infer_rgb, which preprocesses into the context, and
+ * snnet_infer_async, which copies the image so the caller can reuse it at once).
+ * A context holds the activations of one in-flight request; create one per
+ * calling thread, or pass NULL to use one kept per thread (and NUMA node) by the library.
+ * Functions are thread-safe unless noted; errors return a status and leave
+ * a message for snnet_last_error() on the calling thread.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNNET_NUM_CLASSES 1000
+#define SNNET_IMAGE_SIZE 224
+#define SNNET_NUM_STITCH_IDS 71
+
+typedef enum snnet_status {
+    SNNET_OK = 0,
+    SNNET_INVALID_ARGUMENT = 1,
+    SNNET_ERROR = 2,
+} snnet_status;
+
+typedef struct snnet_engine snnet_engine;
+typedef struct snnet_context snnet_context;
+
+typedef struct snnet_options {
+    const char* model_dir;      /* ONNX models; NULL: "./pretrained/onnx/" */
+    const char* ort_cache_dir;  /* optimized model cache; NULL: none. Unused with a packed weight store */
+    int intra_op_threads;       /* ORT threads per request, >= 2 for snnet_infer_async */
+    int numa_node;              /* node of activations and hot weights, -1: not placed */
+    size_t memory_budget;       /* bytes of resident sessions, 0: unlimited */
+    size_t arena_reserve_bytes; /* initial arena chunk, 0: ORT default */
+} snnet_options;
+
+/* Called once per snnet_infer_async request, on an ORT thread; must not block for long. */
+typedef void (*snnet_callback)(void* user_data, snnet_status status, float* logits);
+
+/* Fills `options` with the defaults. */
+void snnet_options_init(snnet_options* options);
+
+/* `bundle`: snnet-pack output directory (weights.snw, models.snb), NULL or "" for plain ONNX files.
+ * `options`: NULL for the defaults. */
+snnet_status snnet_engine_create(const char* bundle, const snnet_options* options, snnet_engine** engine);
+/* Not while calls on `engine` are running or snnet_infer_async requests are in flight: wait
+ * for every callback to have returned first. Never from a callback, which runs on an ORT
+ * thread the engine's destruction joins. */
+void snnet_engine_destroy(snnet_engine* engine);
+
+/* Loads the sessions of `stitch_id` now instead of on first use. */
+snnet_status snnet_preload(snnet_engine* engine, int stitch_id);
+
+snnet_status snnet_context_create(snnet_engine* engine, snnet_context** context);
+void snnet_context_destroy(snnet_context* context);
+
+/* `chw`: float [3,224,224], RGB in [0, 1]. `out_logits`: SNNET_NUM_CLASSES floats.
+ * `context`: not used by another thread at the same time; NULL: the calling thread's. */
+snnet_status snnet_infer(snnet_engine* engine, snnet_context* context, const float* chw, int stitch_id, float* out_logits);
+
+/* `rgb`: interleaved 8-bit RGB rows of `width` x `height` pixels, `stride` bytes apart
+ * (0: width * 3). Resized and normalized into the context like the file loader does. */
+snnet_status snnet_infer_rgb(snnet_engine* engine, snnet_context* context, const uint8_t* rgb, int width, int height,
+                             size_t stride, int stitch_id, float* out_logits);
+
+/* `count` images at once, spread over the library's worker threads.
+ * `out_logits`: count x SNNET_NUM_CLASSES floats. Fails if any image does. */
+snnet_status snnet_infer_batch(snnet_engine* engine, const float* const* chw, size_t count, int stitch_id, float* out_logits);
+
+/* Returns at once; `callback` gets `out_logits` when they are written, or the error.
+ * `out_logits` must stay valid until then. Errors starting the request are also reported through `callback`. */
+snnet_status snnet_infer_async(snnet_engine* engine, const float* chw, int stitch_id, float* out_logits,
+                               snnet_callback callback, void* user_data);
+
+/* Writes the process-wide latency histograms and counters of every engine to `path`,
+ * in the Prometheus text format; replaced atomically, for a node exporter textfile collector. */
+snnet_status snnet_write_metrics(const char* path);
+
+/* Message of the last error on this thread, "" if none. */
+const char* snnet_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SNNET_H */
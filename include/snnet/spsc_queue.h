@@ -0,0 +1,90 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/* Bounded lock-free queue between exactly one producer and one consumer thread.
+ * The ring holds a power of two slots; head and tail live on their own cache
+ * lines, and each side caches the other's index to touch it only when the ring
+ * looks full or empty.
+ */
+template <typename T>
+class SpscQueue {
+private:
+    static constexpr size_t cache_line = 64;
+
+    std::vector<T> slots;
+    size_t mask;
+
+    alignas(cache_line) std::atomic<size_t> head{ 0 };  // next slot to pop, written by the consumer
+    size_t cached_tail = 0;
+    alignas(cache_line) std::atomic<size_t> tail{ 0 };  // next slot to push, written by the producer
+    size_t cached_head = 0;
+
+    // Spins first, then yields, then sleeps, so an idle side does not hold a core
+    static void backoff(unsigned& spins) {
+        if (++spins < 64) {
+            return;
+        }
+        if (spins < 256) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side. Returns false if the queue is full.
+    bool tryPush(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head > mask) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head > mask) {
+                return false;
+            }
+        }
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the queue is empty.
+    bool tryPop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h == cached_tail) {
+                return false;
+            }
+        }
+        value = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(const T& value) {
+        for (unsigned spins = 0; !tryPush(value);) backoff(spins);
+    }
+
+    T pop() {
+        T value;
+        for (unsigned spins = 0; !tryPop(value);) backoff(spins);
+        return value;
+    }
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,67 @@
+#ifndef STITCHPLAN_H
+#define STITCHPLAN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Execution plan of one stitch id:
+ * embed -> front anchor layers -> stitch layer -> back anchor layers -> head
+ * Every step is one ONNX model with a single input and a single output.
+ */
+
+enum class StepKind { Embed, Layer, Stitch, Head };
+
+struct PlanStep {
+    StepKind kind;
+    std::string model_name;
+    const char* input_name;
+    const char* output_name;
+    std::vector<int64_t> input_shape;   // batch size of 1
+    std::vector<int64_t> output_shape;
+
+    int64_t inputElements() const;
+    int64_t outputElements() const;
+
+    // "embed", "layer", "stitch" or "head"
+    static const char* kindName(StepKind kind);
+};
+
+class StitchPlan {
+private:
+    int stitch_id;
+    int stitch_code; // 0: tiny, 1: small, 2: base, 3: tiny-small, 4: small-base
+    std::vector<PlanStep> steps;
+
+public:
+    // Throws std::invalid_argument if stitch_id is not in [0, num_stitch_ids).
+    explicit StitchPlan(int s_id);
+
+    int getStitchId() const {
+        return stitch_id;
+    }
+
+    int getStitchCode() const {
+        return stitch_code;
+    }
+
+    const std::vector<PlanStep>& getSteps() const {
+        return steps;
+    }
+
+    std::vector<std::string> getModelNames() const;
+
+    /* Model names, e.g. "deit_tiny_patch16_224_layer_0", "deit_sl_3" */
+    static std::string embedModelName(int anchor);
+    static std::string layerModelName(int anchor, int layer);
+    static std::string stitchModelName(int s_id);
+    static std::string headModelName(int anchor);
+
+    // Every model used by any stitch id, without duplicates.
+    static std::vector<std::string> allModelNames();
+
+    // Token width a model works on (its input width for stitch layers), 0 for unknown names.
+    static int64_t modelWidth(const std::string& model_name);
+};
+
+#endif // STITCHPLAN_H
@@ -0,0 +1,32 @@
+#ifndef STITCHSELECTOR_H
+#define STITCHSELECTOR_H
+
+#include <mutex>
+#include <vector>
+
+/* Chooses the stitch id for a latency budget: the most expensive stitch by
+ * CostTable FLOPs (i.e. the most accurate one) predicted to finish within
+ * the budget, or the cheapest one if none does. The prediction scales FLOPs
+ * by a moving average of the time per FLOP of the requests observed so far.
+ * Thread-safe.
+ */
+class StitchSelector {
+private:
+    std::vector<double> plan_flops;     // by stitch id
+    std::vector<int> stitches_by_cost;  // stitch ids, cheapest first
+
+    mutable std::mutex mutex;
+    double ms_per_flop = 0;             // 0 until a warm request was observed
+    std::vector<bool> warm;             // by stitch id
+
+public:
+    StitchSelector();
+
+    int choose(double budget_ms) const;
+
+    // Records a finished request. The first run of each stitch id includes its
+    // session loads, so it does not count toward the estimate.
+    void observe(int stitch_id, double latency_ms);
+};
+
+#endif // STITCHSELECTOR_H
@@ -0,0 +1,45 @@
+#ifndef STORAGETHROTTLE_H
+#define STORAGETHROTTLE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+/* Emulated slow storage for model loads.
+ * SessionFactory charges every session it creates with the bytes the model
+ * reads (serialized model plus weights), and the charge blocks for as long as
+ * a device reading at the set rate would take. Reads queue behind each other
+ * as on a single device, so parallel preloads do not get more bandwidth.
+ * Every load is charged, including models the page cache would have served:
+ * the emulation assumes a cold device.
+ * One instance per process; off (rate 0) unless DeviceEmulation turns it on.
+ */
+class StorageThrottle {
+private:
+    std::mutex mutex;
+    double bytes_per_s = 0;
+    std::atomic<bool> active{ false };  // bytes_per_s > 0, read without the lock
+    std::chrono::steady_clock::time_point device_free;  // when queued reads are done
+
+    StorageThrottle() = default;
+
+public:
+    static StorageThrottle& instance();
+
+    StorageThrottle(const StorageThrottle&) = delete;
+    StorageThrottle& operator=(const StorageThrottle&) = delete;
+
+    // 0 turns the throttle off.
+    void setRate(double bytes_per_second);
+
+    // Whether charge() waits at all, so callers can skip computing what to charge.
+    bool enabled() const {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    // Waits until `bytes` would have been read.
+    void charge(size_t bytes);
+};
+
+#endif // STORAGETHROTTLE_H
@@ -0,0 +1,100 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Per-stage tracing, exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+ * Compiled in with SNNET_TRACING (cmake -DSNNET_TRACING=ON); otherwise the
+ * SNNET_TRACE_* macros expand to nothing and their arguments are not evaluated.
+ * Each thread appends complete events to its own ring buffer: no locks on the
+ * hot path, only a release store of the ring's write count. A full ring
+ * overwrites its oldest events. When a thread exits, its events are kept for
+ * export (up to retired_events over all exited threads) and its ring is reused.
+ * Timestamps are raw CPU counter ticks (TSC, or the ARM virtual counter), about
+ * half the cost of reading steady_clock, converted to time when the trace is
+ * written. With SNNET_TRACE=<file> in the environment, the
+ * trace is written at exit.
+ * Event names and categories must outlive the trace: literals or intern().
+ */
+struct TraceEvent {
+    uint64_t begin, end;    // Tracer::now() ticks
+    const char* category;
+    const char* name;
+    int64_t arg;    // -1: none
+};
+
+class Tracer {
+public:
+    static constexpr size_t ring_events = 1 << 16;  // per thread
+    static constexpr size_t retired_events = 1 << 18; // of exited threads, newest kept
+
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t ticks;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static void record(const char* category, const char* name, uint64_t begin, uint64_t end, int64_t arg = -1);
+
+    // Stable copy of `text`, for names built at run time. Takes a lock: not for hot paths.
+    static const char* intern(const std::string& text);
+
+    // Name of the calling thread in the trace.
+    static void setThreadName(const std::string& name);
+
+    // Writes the events of every thread. Events recorded meanwhile may be missing or cut.
+    static void writeChromeTrace(const std::string& path);
+};
+
+/* Records the enclosing scope as one event */
+class TraceScope {
+private:
+    const char* category;
+    const char* name;
+    int64_t arg;
+    uint64_t begin;
+
+public:
+    TraceScope(const char* category, const char* name, int64_t arg = -1)
+        : category(category), name(name), arg(arg), begin(Tracer::now()) {}
+
+    ~TraceScope() {
+        Tracer::record(category, name, begin, Tracer::now(), arg);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define SNNET_TRACE_CONCAT_(a, b) a##b
+#define SNNET_TRACE_CONCAT(a, b) SNNET_TRACE_CONCAT_(a, b)
+
+#ifdef SNNET_TRACING
+#define SNNET_TRACE_SCOPE(category, name) TraceScope SNNET_TRACE_CONCAT(trace_scope_, __LINE__)(category, name)
+#define SNNET_TRACE_SCOPE_ARG(category, name, arg) \
+    TraceScope SNNET_TRACE_CONCAT(trace_scope_, __LINE__)(category, name, static_cast<int64_t>(arg))
+#define SNNET_TRACE_NOW() Tracer::now()
+#define SNNET_TRACE_RECORD(category, name, begin, arg) \
+    Tracer::record(category, name, begin, Tracer::now(), static_cast<int64_t>(arg))
+#define SNNET_TRACE_THREAD_NAME(name) Tracer::setThreadName(name)
+#else
+#define SNNET_TRACE_SCOPE(category, name) ((void)0)
+#define SNNET_TRACE_SCOPE_ARG(category, name, arg) ((void)0)
+#define SNNET_TRACE_NOW() uint64_t(0)
+#define SNNET_TRACE_RECORD(category, name, begin, arg) ((void)0)
+#define SNNET_TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,64 @@
+#ifndef TUNINGTABLE_H
+#define TUNINGTABLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+constexpr const char* tuning_table_file = "tuning.txt";
+
+/* Per-session threading settings searched by snnet-tune */
+struct TuningConfig {
+    int intra_op_threads = 1;
+    bool allow_spinning = true;         // session.intra_op.allow_spinning
+    bool parallel_execution = false;    // ORT_PARALLEL with 2 inter-op threads instead of ORT_SEQUENTIAL
+
+    // Sets these on options whose session gets its own thread pools.
+    void apply(Ort::SessionOptions& options) const;
+};
+
+/* Best configuration measured for one layer width and number of concurrent callers:
+ * 1 caller is latency mode, one caller per core throughput mode. The models have
+ * a fixed batch size of 1, so concurrent callers stand in for larger batches.
+ */
+struct TuningResult {
+    int64_t width;
+    int concurrency;
+    TuningConfig config;
+    double latency_ms;      // mean time of one Run
+    double throughput;      // Runs per second over all callers
+};
+
+/* Tuning results of this host, persisted as text:
+ *   host <tag>
+ *   <width> <concurrency> <threads> <spinning> <parallel> <latency ms> <throughput>
+ * A file tuned on another host (cores or ORT version) loads as empty.
+ */
+class TuningTable {
+private:
+    std::vector<TuningResult> results;
+
+public:
+    static std::string hostTag();
+
+    static TuningTable load(const std::string& path);
+    void save(const std::string& path) const;
+
+    // Adds `result`, replacing any for the same width and concurrency.
+    void set(const TuningResult& result);
+
+    // Result for `width` tuned at the concurrency closest to `concurrency`, nullptr if none.
+    const TuningResult* find(int64_t width, int concurrency) const;
+
+    const std::vector<TuningResult>& getResults() const {
+        return results;
+    }
+
+    bool empty() const {
+        return results.empty();
+    }
+};
+
+#endif // TUNINGTABLE_H
@@ -0,0 +1,120 @@
+#ifndef WEIGHTSTORE_H
+#define WEIGHTSTORE_H
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "huge_pages.h"
+#include "mapped_file.h"
+
+/* Flat weight store shared by all sessions.
+ * "snnet-pack" moves every initializer of the models under pretrained/onnx/
+ * into one page-aligned blob and rewrites the models to reference it as
+ * ONNX external data. At runtime the blob is mmaped read-only and each
+ * session gets its initializers zero-copy through AddExternalInitializers,
+ * so resident weight memory is the page cache of one file, shared by every
+ * process on the host.
+ *
+ * Blob layout (little-endian):
+ *   [0, page)        WeightStoreHeader
+ *   [page, index)    tensor data, each model page-aligned, each tensor 64B-aligned
+ *   [index, end)     per model: name, tensor count, then per tensor
+ *                    name, data type, dims, offset, length
+ */
+
+constexpr const char* weight_store_file = "weights.snw";
+constexpr uint64_t weight_store_page = 4096;
+constexpr uint64_t weight_store_tensor_align = 64;
+
+struct WeightStoreHeader {
+    char magic[4];          // "SNWS"
+    uint32_t version;
+    uint32_t model_count;
+    uint32_t tensor_count;
+    uint64_t data_offset;
+    uint64_t index_offset;
+    uint64_t index_size;
+};
+
+/* Offline side, used by snnet-pack */
+class WeightStoreWriter {
+private:
+    std::ofstream blob;
+    std::string location;   // blob file name as referenced from the rewritten models
+    uint64_t offset;
+    uint32_t model_count, tensor_count;
+    std::string index;
+
+    void pad(uint64_t alignment);
+
+public:
+    explicit WeightStoreWriter(const std::string& blob_path);
+
+    // Appends the initializers of `model` to the blob and returns the model
+    // rewritten with external data references into it.
+    std::string addModel(const std::string& model_name, const std::string& model);
+
+    // Writes the index and header. Returns the total blob size.
+    uint64_t finish();
+};
+
+/* Runtime side */
+class WeightStore {
+private:
+    struct Tensor {
+        std::string name;
+        ONNXTensorElementDataType type;
+        std::vector<int64_t> dims;
+        uint64_t offset, length;
+    };
+    struct ModelValues {
+        std::vector<std::string> names;
+        std::vector<Ort::Value> values;
+    };
+
+    MappedFile blob;
+    std::unordered_map<std::string, std::vector<Tensor>> models;
+    std::unordered_map<std::string, ModelValues> values; // kept alive as long as sessions use them
+    std::vector<HugePageBuffer> local_buffers;  // node-local copies, one buffer per localize() call
+    std::unordered_map<std::string, const uint8_t*> local_copies; // start of a model's blob range in them
+    std::mutex values_mutex;
+
+public:
+    // Throws std::runtime_error if the blob is missing or malformed.
+    explicit WeightStore(const std::string& blob_path);
+
+    bool hasModel(const std::string& model_name) const {
+        return models.count(model_name) != 0;
+    }
+
+    // Total size of the model's initializers in the blob.
+    size_t getModelBytes(const std::string& model_name) const;
+
+    // Offset and length of the blob range holding the model's initializers ({0, 0} if unknown).
+    std::pair<uint64_t, uint64_t> getModelRange(const std::string& model_name) const;
+
+    // Adds the model's initializers, backed by the mapped blob, to `options`.
+    // The store must outlive every session created with these options.
+    // With `shared`, they are added as shared initializers (AddInitializer) instead,
+    // which ORT requires to reuse prepacked weights across sessions of the same model.
+    void addInitializers(const std::string& model_name, Ort::SessionOptions& options, bool shared = false);
+
+    // Copies the initializers of `model_names` to memory on `numa_node`; sessions created afterwards
+    // use the copy instead of the shared page cache. The models share one buffer, so the many small
+    // ones (stitch layers, heads) do not each round up to a huge page. Unknown models and models
+    // already in use are skipped.
+    void localize(const std::vector<std::string>& model_names, int numa_node);
+
+    const MappedFile& getBlob() const {
+        return blob;
+    }
+};
+
+#endif // WEIGHTSTORE_H
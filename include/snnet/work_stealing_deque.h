@@ -0,0 +1,91 @@
+#ifndef WORKSTEALINGDEQUE_H
+#define WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/* Chase-Lev work-stealing deque of pointers, with a fixed capacity.
+ * The owner thread pushes and pops at the bottom (LIFO, so it keeps
+ * working on what it just produced); other threads steal from the top.
+ * Only the last element is contended, and only then is a CAS needed.
+ * Memory orders follow Le et al., "Correct and Efficient Work-Stealing
+ * for Weak Memory Models" (PPoPP 2013).
+ */
+template <typename T>
+class WorkStealingDeque {
+private:
+    static constexpr size_t cache_line = 64;
+
+    std::unique_ptr<std::atomic<T*>[]> buffer;
+    int64_t mask;
+    alignas(cache_line) std::atomic<int64_t> top{ 0 };
+    alignas(cache_line) std::atomic<int64_t> bottom{ 0 };
+
+public:
+    explicit WorkStealingDeque(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        buffer.reset(new std::atomic<T*>[size]);
+        mask = static_cast<int64_t>(size) - 1;
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only. Returns false if the deque is full.
+    bool push(T* item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > mask) {
+            return false;
+        }
+        buffer[b & mask].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Owner only. Returns nullptr if the deque is empty or a thief took the last item.
+    T* pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* item = buffer[b & mask].load(std::memory_order_relaxed);
+        if (t == b) { // last item: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread. Returns nullptr if the deque is empty or another thread won the item.
+    T* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        T* item = buffer[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // Approximate, for idle checks only.
+    bool empty() const {
+        return bottom.load(std::memory_order_acquire) <= top.load(std::memory_order_acquire);
+    }
+};
+
+#endif // WORKSTEALINGDEQUE_H
@@ -0,0 +1,113 @@
+#include "alloc_counter.h"
+
+#ifdef SNNET_DEBUG_ALLOC_COUNT
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+}
+
+namespace {
+
+std::atomic<uint64_t> allocations{ 0 }, aligned_allocations{ 0 }, allocated_bytes{ 0 };
+
+inline void countAllocation(size_t size, bool aligned) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (aligned) aligned_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline bool isPowerOfTwo(size_t n) {
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+} // namespace
+
+/* The malloc family of the whole process, libonnxruntime included: libsnnet is a direct
+ * dependency of the executables and libc an indirect one, so these definitions come first
+ * in symbol lookup. An executable built with this file (snnet-microbench) comes before
+ * both, so there is only ever one counter in use. */
+extern "C" {
+void* malloc(size_t size) {
+    countAllocation(size, false);
+    return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+    countAllocation(count * size, false);
+    return __libc_calloc(count, size);
+}
+void* realloc(void* p, size_t size) {
+    countAllocation(size, false);
+    return __libc_realloc(p, size);
+}
+void free(void* p) {
+    __libc_free(p);
+}
+void* memalign(size_t alignment, size_t size) {
+    countAllocation(size, true);
+    return __libc_memalign(alignment, size);
+}
+void* aligned_alloc(size_t alignment, size_t size) {
+    if (!isPowerOfTwo(alignment)) {
+        errno = EINVAL;
+        return nullptr;
+    }
+    countAllocation(size, true);
+    return __libc_memalign(alignment, size);
+}
+int posix_memalign(void** p, size_t alignment, size_t size) {
+    if (!isPowerOfTwo(alignment) || alignment % sizeof(void*) != 0) {
+        return EINVAL;  // *p is left alone, as by libc
+    }
+    countAllocation(size, true);
+    void* memory = __libc_memalign(alignment, size);
+    if (memory == nullptr) {
+        return ENOMEM;
+    }
+    *p = memory;
+    return 0;
+}
+}
+
+bool AllocCounter::enabled() {
+    return true;
+}
+
+uint64_t AllocCounter::count() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocCounter::alignedCount() {
+    return aligned_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocCounter::bytes() {
+    return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool AllocCounter::enabled() {
+    return false;
+}
+
+uint64_t AllocCounter::count() {
+    return 0;
+}
+
+uint64_t AllocCounter::alignedCount() {
+    return 0;
+}
+
+uint64_t AllocCounter::bytes() {
+    return 0;
+}
+
+#endif // SNNET_DEBUG_ALLOC_COUNT
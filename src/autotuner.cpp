@@ -0,0 +1,107 @@
+#include "autotuner.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+constexpr int warmup_runs = 2;
+
+} // namespace
+
+Autotuner::Autotuner(const std::string& model_dir, const std::string& packed_dir, int r)
+    : env(ORT_LOGGING_LEVEL_WARNING, "Autotuner"), factory(env, session_options, model_dir), runs(r) {
+    if (!packed_dir.empty()) {
+        factory.usePackedDir(packed_dir);
+    }
+    factory.setSessionTuner([this](const std::string&, Ort::SessionOptions& options) { current.apply(options); });
+}
+
+std::vector<TuningConfig> Autotuner::candidates(int max_threads) {
+    std::vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(max_threads);
+
+    std::vector<TuningConfig> configs;
+    for (int threads : thread_counts) {
+        for (bool parallel : { false, true }) {
+            for (bool spinning : { true, false }) {
+                if (threads == 1 && !spinning) continue; // nothing spins without worker threads
+                configs.push_back({ threads, spinning, parallel });
+            }
+        }
+    }
+    return configs;
+}
+
+TuningResult Autotuner::measure(const PlanStep& step, int concurrency) {
+    Ort::Session session = factory.create(step.model_name);
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+
+    std::atomic<int> ready{ 0 };
+    std::atomic<bool> go{ false };
+    std::vector<double> run_ms(concurrency, 0);
+    auto caller = [&](int index) {
+        std::vector<float> input(step.inputElements(), 0.5f), output(step.outputElements());
+        Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
+            memory_info, input.data(), input.size(), step.input_shape.data(), step.input_shape.size());
+        Ort::Value output_tensor = Ort::Value::CreateTensor<float>(
+            memory_info, output.data(), output.size(), step.output_shape.data(), step.output_shape.size());
+        auto run = [&] {
+            session.Run(Ort::RunOptions{ nullptr }, &step.input_name, &input_tensor, 1, &step.output_name, &output_tensor, 1);
+        };
+        for (int i = 0; i < warmup_runs; ++i) run();
+        ++ready;
+        while (!go) std::this_thread::yield();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < runs; ++i) run();
+        run_ms[index] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::vector<std::thread> callers;
+    for (int i = 0; i < concurrency; ++i) {
+        callers.emplace_back(caller, i);
+    }
+    while (ready < concurrency) std::this_thread::yield();
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (std::thread& t : callers) {
+        t.join();
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double total_ms = 0;
+    for (double ms : run_ms) total_ms += ms;
+    TuningResult result;
+    result.width = step.input_shape.back();
+    result.concurrency = concurrency;
+    result.config = current;
+    result.latency_ms = total_ms / (static_cast<double>(concurrency) * runs);
+    result.throughput = concurrency * runs / elapsed_s;
+    return result;
+}
+
+TuningTable Autotuner::tune(const std::vector<int>& concurrencies, int max_threads) {
+    TuningTable table;
+    for (int anchor = 0; anchor < 3; ++anchor) {
+        StitchPlan plan(anchor); // single anchor plans: embed, layer 0, ...
+        const PlanStep& layer = plan.getSteps()[1];
+        for (int concurrency : concurrencies) {
+            TuningResult best{};
+            for (const TuningConfig& config : candidates(max_threads)) {
+                current = config;
+                TuningResult sample = measure(layer, concurrency);
+                samples.push_back(sample);
+                bool better = concurrency == 1 ? sample.latency_ms < best.latency_ms : sample.throughput > best.throughput;
+                if (best.concurrency == 0 || better) {
+                    best = sample;
+                }
+            }
+            table.set(best);
+        }
+    }
+    return table;
+}
@@ -0,0 +1,178 @@
+#include "batch_runner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "constants.h"
+#include "image_loader.h"
+#include "json_writer.h"
+#include "logits.h"
+#include "metrics.h"
+#include "spsc_queue.h"
+#include "trace.h"
+
+namespace {
+
+struct BatchItem {
+    BatchRequest request;
+    std::vector<float> image;
+    std::string error;
+};
+
+constexpr uint32_t binary_version = 1;
+
+template <typename T>
+void put(std::ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+} // namespace
+
+BatchRunner::BatchRunner(InferenceEngine& e, const std::vector<std::string>& l, const BatchOptions& o)
+    : engine(e), labels(l), options(o), plans(num_stitch_ids) {}
+
+bool BatchRunner::parseLine(const std::string& text, size_t line, BatchRequest& request) {
+    request = BatchRequest();
+    request.line = line;
+    std::istringstream fields(text);
+    std::string target, extra;
+    if (!(fields >> request.image_path) || request.image_path[0] == '#') {
+        return false;
+    }
+    if (!(fields >> target) || (fields >> extra)) {
+        throw std::invalid_argument("Expected \"<image path> <stitch id | @budget ms>\"");
+    }
+    try {
+        size_t used = 0;
+        if (target[0] == '@') {
+            request.budget_ms = std::stod(target.substr(1), &used);
+            ++used;
+        } else {
+            request.stitch_id = std::stoi(target, &used);
+        }
+        if (used != target.size()) throw std::invalid_argument(target);
+    } catch (const std::logic_error&) {
+        throw std::invalid_argument("Invalid stitch id or budget: " + target);
+    }
+    if (request.stitch_id < -1 || request.stitch_id >= num_stitch_ids || request.budget_ms < 0) {
+        throw std::invalid_argument("Stitch id or budget out of range: " + target);
+    }
+    return true;
+}
+
+const StitchPlan& BatchRunner::getPlan(int stitch_id) {
+    if (!plans[stitch_id]) {
+        plans[stitch_id] = std::make_unique<StitchPlan>(stitch_id);
+    }
+    return *plans[stitch_id];
+}
+
+uint64_t BatchRunner::digest(const std::vector<float>& logits) {
+    uint64_t hash = 14695981039346656037ull;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(logits.data());
+    for (size_t i = 0; i < logits.size() * sizeof(float); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+BatchSummary BatchRunner::run(std::istream& manifest, std::ostream& output) {
+    if (options.binary) {
+        output.write("SNBR", 4);
+        put<uint32_t>(output, binary_version);
+        put<uint32_t>(output, static_cast<uint32_t>(options.top_k));
+    }
+
+    // Parsing and decoding ahead of inference, at most `prefetch` items in the queue
+    SpscQueue<BatchItem*> queue(std::max<size_t>(1, options.prefetch));
+    std::thread loader([&] {
+        SNNET_TRACE_THREAD_NAME("batch loader");
+        std::string text;
+        for (size_t line = 1; std::getline(manifest, text); ++line) {
+            auto item = std::make_unique<BatchItem>();
+            try {
+                if (!parseLine(text, line, item->request)) continue;
+                item->image = ImageHelpers::loadImage(item->request.image_path);
+                if (item->image.empty()) {
+                    // stdout may be the result stream
+                    item->error = "Failed to load image";
+                    std::cerr << "Line " << line << ": failed to load " << item->request.image_path << std::endl;
+                }
+            } catch (const std::exception& e) {
+                item->error = e.what();
+            }
+            queue.push(item.release());
+        }
+        queue.push(nullptr);
+    });
+
+    InferenceContext context(engine.getOptions().numa_node);
+    std::vector<float> logits(out_numClasses);
+    BatchSummary summary;
+    while (BatchItem* next = queue.pop()) {
+        std::unique_ptr<BatchItem> item(next);
+        const BatchRequest& request = item->request;
+        int stitch_id = -1;
+        double latency_ms = 0;
+        if (item->error.empty()) {
+            try {
+                stitch_id = request.stitch_id >= 0 ? request.stitch_id : selector.choose(request.budget_ms);
+                const StitchPlan& plan = getPlan(stitch_id);
+                if (item->image.size() != static_cast<size_t>(plan.getSteps().front().inputElements())) {
+                    throw std::invalid_argument("Invalid image format. Must be 224x224 RGB image.");
+                }
+                auto start = std::chrono::steady_clock::now();
+                engine.run(plan, item->image.data(), logits.data(), context);
+                latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                summary.inference_ms += latency_ms;
+                selector.observe(stitch_id, latency_ms);
+            } catch (const std::exception& e) {
+                item->error = e.what();
+                stitch_id = -1;
+            }
+        }
+        ++summary.requests;
+        if (!item->error.empty()) {
+            ++summary.failed;
+        }
+
+        std::vector<int> classes = item->error.empty() ? Logits::topK(logits.data(), logits.size(), options.top_k) : std::vector<int>();
+        uint64_t hash = item->error.empty() ? digest(logits) : 0;
+        if (options.binary) {
+            put<uint32_t>(output, static_cast<uint32_t>(request.line));
+            put<int32_t>(output, stitch_id);
+            put<float>(output, static_cast<float>(latency_ms));
+            put<uint64_t>(output, hash);
+            for (size_t i = 0; i < options.top_k; ++i) {
+                bool valid = i < classes.size();
+                put<int32_t>(output, valid ? classes[i] : -1);
+                put<float>(output, valid ? logits[classes[i]] : 0.0f);
+            }
+        } else {
+            output << "{\"line\":" << request.line << ",\"image\":" << JsonWriter::quote(request.image_path);
+            if (!item->error.empty()) {
+                output << ",\"error\":" << JsonWriter::quote(item->error) << "}\n";
+            } else {
+                char hex[17];
+                snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+                output << ",\"stitch_id\":" << stitch_id << ",\"latency_ms\":" << latency_ms << ",\"digest\":\"" << hex
+                       << "\",\"top_k\":[";
+                for (size_t i = 0; i < classes.size(); ++i) {
+                    const std::string label = classes[i] < static_cast<int>(labels.size()) ? labels[classes[i]] : "";
+                    output << (i > 0 ? "," : "") << "{\"class\":" << classes[i] << ",\"label\":" << JsonWriter::quote(label)
+                           << ",\"logit\":" << logits[classes[i]] << "}";
+                }
+                output << "]}\n";
+            }
+        }
+        output.flush(); // results stream out as they finish
+    }
+    loader.join();
+    Metrics::global().countBatch(summary.requests);
+    return summary;
+}
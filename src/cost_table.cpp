@@ -0,0 +1,112 @@
+#include "cost_table.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "constants.h"
+
+namespace {
+
+constexpr double patch_size = 16;
+
+} // namespace
+
+double CostTable::stepFlops(const PlanStep& step) {
+    const double n = static_cast<double>(tr_height);
+    switch (step.kind) {
+    case StepKind::Embed: {
+        const double w = static_cast<double>(step.output_shape.back());
+        return 2.0 * (n - 1) * (in_numChannels * patch_size * patch_size) * w;
+    }
+    case StepKind::Layer: {
+        const double w = static_cast<double>(step.input_shape.back());
+        return 24.0 * n * w * w + 4.0 * n * n * w;
+    }
+    case StepKind::Stitch:
+        return 2.0 * n * static_cast<double>(step.input_shape.back()) * static_cast<double>(step.output_shape.back());
+    case StepKind::Head:
+        return 2.0 * static_cast<double>(step.input_shape.back()) * out_numClasses;
+    }
+    return 0;
+}
+
+double CostTable::stepWeightBytes(const PlanStep& step) {
+    const double n = static_cast<double>(tr_height);
+    double parameters = 0;
+    switch (step.kind) {
+    case StepKind::Embed: {
+        const double w = static_cast<double>(step.output_shape.back());
+        parameters = (in_numChannels * patch_size * patch_size + 1) * w + w + n * w; // projection, class token, positions
+        break;
+    }
+    case StepKind::Layer: {
+        const double w = static_cast<double>(step.input_shape.back());
+        parameters = 12 * w * w + 13 * w;   // QKV, projection, MLP in and out with biases, two layer norms
+        break;
+    }
+    case StepKind::Stitch: {
+        const double w_in = static_cast<double>(step.input_shape.back()), w_out = static_cast<double>(step.output_shape.back());
+        parameters = w_in * w_out + w_out;
+        break;
+    }
+    case StepKind::Head: {
+        const double w = static_cast<double>(step.input_shape.back());
+        parameters = 2 * w + (w + 1) * out_numClasses;
+        break;
+    }
+    }
+    return parameters * sizeof(float);
+}
+
+double CostTable::stepBytes(const PlanStep& step) {
+    return stepWeightBytes(step) + static_cast<double>(step.inputElements() + step.outputElements()) * sizeof(float);
+}
+
+std::vector<double> CostTable::stepCosts(const StitchPlan& plan) {
+    std::vector<double> costs;
+    for (const PlanStep& step : plan.getSteps()) {
+        costs.push_back(stepFlops(step));
+    }
+    return costs;
+}
+
+double CostTable::planFlops(const StitchPlan& plan) {
+    double flops = 0;
+    for (const PlanStep& step : plan.getSteps()) {
+        flops += stepFlops(step);
+    }
+    return flops;
+}
+
+std::vector<size_t> CostTable::partition(const std::vector<double>& costs, size_t num_parts) {
+    const size_t n = costs.size();
+    num_parts = std::max<size_t>(1, std::min(num_parts, n));
+    std::vector<double> prefix(n + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        prefix[i + 1] = prefix[i] + costs[i];
+    }
+
+    // best[k][i]: smallest largest-range cost splitting the first i costs into k ranges
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<std::vector<double>> best(num_parts + 1, std::vector<double>(n + 1, inf));
+    std::vector<std::vector<size_t>> cut(num_parts + 1, std::vector<size_t>(n + 1, 0));
+    best[0][0] = 0;
+    for (size_t k = 1; k <= num_parts; ++k) {
+        for (size_t i = k; i <= n; ++i) {
+            for (size_t j = k - 1; j < i; ++j) {
+                double cost = std::max(best[k - 1][j], prefix[i] - prefix[j]);
+                if (cost < best[k][i]) {
+                    best[k][i] = cost;
+                    cut[k][i] = j;
+                }
+            }
+        }
+    }
+
+    std::vector<size_t> bounds(num_parts + 1);
+    bounds[num_parts] = n;
+    for (size_t k = num_parts; k > 0; --k) {
+        bounds[k - 1] = cut[k][bounds[k]];
+    }
+    return bounds;
+}
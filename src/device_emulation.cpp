@@ -0,0 +1,176 @@
+#include "device_emulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include "numa_topology.h"
+#include "storage_throttle.h"
+
+namespace {
+
+double parseSize(const std::string& text) {
+    size_t end = 0;
+    double value = std::stod(text, &end);
+    std::string suffix = text.substr(end);
+    if (suffix == "k" || suffix == "K") value *= 1024;
+    else if (suffix == "m" || suffix == "M") value *= 1024 * 1024;
+    else if (suffix == "g" || suffix == "G") value *= 1024.0 * 1024 * 1024;
+    else if (!suffix.empty()) throw std::invalid_argument("Bad size: " + text);
+    return value;
+}
+
+// Writes an existing control file; never creates one
+bool writeFile(const std::string& path, const std::string& value) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write(fd, value.data(), value.size()) == static_cast<ssize_t>(value.size());
+    close(fd);
+    return ok;
+}
+
+// Directory of this process' cgroup v2, empty without one. On hybrid hosts
+// /sys/fs/cgroup is a tmpfs holding the v1 hierarchies, and v2 is mounted below it.
+std::string ownCgroup() {
+    std::ifstream file("/proc/self/cgroup");
+    std::string line;
+    while (getline(file, line)) {
+        if (line.rfind("0::", 0) != 0) {
+            continue;
+        }
+        for (const char* mount : { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" }) {
+            struct statfs fs;
+            if (statfs(mount, &fs) == 0 && fs.f_type == CGROUP2_SUPER_MAGIC) {
+                return mount + line.substr(3);
+            }
+        }
+    }
+    return "";
+}
+
+} // namespace
+
+DeviceProfile DeviceProfile::parse(const std::string& spec) {
+    DeviceProfile profile;
+    std::stringstream items(spec);
+    for (std::string item; getline(items, item, ',');) {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            throw std::invalid_argument("Expected key=value in device profile: " + item);
+        }
+        const std::string key = item.substr(0, eq), value = item.substr(eq + 1);
+        try {
+            if (key == "cores") profile.cores = std::max(0, std::stoi(value));
+            else if (key == "memory") profile.memory_bytes = static_cast<size_t>(parseSize(value));
+            else if (key == "duty") profile.duty_cycle = std::stod(value);
+            else if (key == "period") profile.duty_period_ms = std::max(10, std::stoi(value));
+            else if (key == "storage") profile.storage_bytes_per_s = parseSize(value);
+            else throw std::invalid_argument("Unknown device profile key: " + key);
+        } catch (const std::logic_error& e) {
+            throw std::invalid_argument("Bad device profile entry \"" + item + "\": " + e.what());
+        }
+    }
+    if (!(profile.duty_cycle > 0 && profile.duty_cycle <= 1)) {
+        throw std::invalid_argument("Duty cycle must be in (0, 1]");
+    }
+    return profile;
+}
+
+bool DeviceProfile::empty() const {
+    return cores == 0 && memory_bytes == 0 && duty_cycle >= 1 && storage_bytes_per_s <= 0;
+}
+
+bool DeviceEmulation::enterCgroup(const DeviceProfile& profile, EmulationReport& report) {
+    const std::string parent = ownCgroup();
+    if (parent.empty()) {
+        return false;
+    }
+    // Only works where the parent is delegated to us and may enable controllers for children
+    writeFile(parent + "/cgroup.subtree_control", "+memory +cpu");
+    const std::string child = parent + "/snnet-emulation-" + std::to_string(getpid());
+    if (mkdir(child.c_str(), 0755) != 0) {
+        return false;
+    }
+    bool memory = profile.memory_bytes == 0 || writeFile(child + "/memory.max", std::to_string(profile.memory_bytes));
+    bool duty = profile.duty_cycle >= 1 ||
+        writeFile(child + "/cpu.max", std::to_string(static_cast<long>(profile.duty_cycle * profile.duty_period_ms * 1000)) +
+                                          " " + std::to_string(profile.duty_period_ms * 1000));
+    if (!memory || !duty || !writeFile(child + "/cgroup.procs", std::to_string(getpid()))) {
+        rmdir(child.c_str());
+        return false;
+    }
+    report.cgroup = child;
+    if (profile.memory_bytes > 0) report.memory_limit = "cgroup";
+    if (profile.duty_cycle < 1) report.duty_limit = "cgroup";
+    return true;
+}
+
+bool DeviceEmulation::startDutyCycler(const DeviceProfile& profile) {
+    const pid_t target = getpid();
+    const pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid > 0) {
+        return true;
+    }
+    // Helper process: dies with the target, which it always leaves running. Its own session keeps it
+    // out of the terminal's process group, so Ctrl-C stops the target only, and never mid stop window
+    setsid();
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    const auto run = std::chrono::microseconds(static_cast<long>(profile.duty_cycle * profile.duty_period_ms * 1000));
+    const auto stop = std::chrono::microseconds(profile.duty_period_ms * 1000) - run;
+    while (getppid() == target) {
+        std::this_thread::sleep_for(run);
+        kill(target, SIGSTOP);
+        std::this_thread::sleep_for(stop);
+        kill(target, SIGCONT);
+    }
+    kill(target, SIGCONT);
+    _exit(0);
+}
+
+EmulationReport DeviceEmulation::apply(const DeviceProfile& profile) {
+    EmulationReport report;
+    if (profile.cores > 0) {
+        std::vector<int> cpus = CpuAffinity::currentThread();
+        if (static_cast<int>(cpus.size()) > profile.cores) cpus.resize(profile.cores);
+        if (CpuAffinity::pinCurrentThread(cpus)) report.cores = static_cast<int>(cpus.size());
+    }
+
+    if (profile.memory_bytes > 0 || profile.duty_cycle < 1) {
+        enterCgroup(profile, report);
+    }
+    if (profile.memory_bytes > 0 && report.memory_limit.empty()) {
+        struct rlimit limit = { profile.memory_bytes, profile.memory_bytes };
+        if (setrlimit(RLIMIT_AS, &limit) == 0) report.memory_limit = "rlimit_as";
+    }
+    if (profile.duty_cycle < 1 && report.duty_limit.empty() && startDutyCycler(profile)) {
+        report.duty_limit = "signals";
+    }
+
+    if (profile.storage_bytes_per_s > 0) {
+        StorageThrottle::instance().setRate(profile.storage_bytes_per_s);
+        report.storage = true;
+    }
+    return report;
+}
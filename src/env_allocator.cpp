@@ -0,0 +1,100 @@
+#include "env_allocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// Each block starts with a header holding its size; keeps the payload 64-byte aligned like ORT's own allocator
+constexpr size_t block_header = 64;
+
+} // namespace
+
+CountingAllocator::CountingAllocator()
+    : memory_info(Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeDefault)) {
+    version = ORT_API_VERSION;
+    Alloc = [](OrtAllocator* self, size_t size) { return static_cast<CountingAllocator*>(self)->allocate(size); };
+    Free = [](OrtAllocator* self, void* p) { static_cast<CountingAllocator*>(self)->release(p); };
+    Info = [](const OrtAllocator* self) { return static_cast<const CountingAllocator*>(self)->info(); };
+}
+
+CountingAllocator& CountingAllocator::instance() {
+    static CountingAllocator allocator;
+    return allocator;
+}
+
+void* CountingAllocator::allocate(size_t size) {
+    void* block = nullptr;
+    if (posix_memalign(&block, block_header, size + block_header) != 0) {
+        return nullptr; // called from ORT through a C function pointer, so no exceptions
+    }
+    *static_cast<size_t*>(block) = size;
+    ++allocations;
+    size_t live = live_bytes += size;
+    size_t peak = peak_bytes.load();
+    while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {}
+    return static_cast<char*>(block) + block_header;
+}
+
+void CountingAllocator::release(void* p) {
+    if (p == nullptr) {
+        return;
+    }
+    void* block = static_cast<char*>(p) - block_header;
+    live_bytes -= *static_cast<size_t*>(block);
+    free(block);
+}
+
+void CountingAllocator::resetPeak() {
+    peak_bytes = live_bytes.load();
+}
+
+AllocationStats CountingAllocator::getStats() const {
+    return { allocations.load(), live_bytes.load(), peak_bytes.load() };
+}
+
+ArenaCalibration ArenaCalibration::load(const std::string& path) {
+    ArenaCalibration calibration;
+    std::ifstream file(path);
+    int stitch_id;
+    size_t bytes;
+    while (file >> stitch_id >> bytes) {
+        calibration.peak_bytes[stitch_id] = bytes;
+    }
+    return calibration;
+}
+
+void ArenaCalibration::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    for (const auto& entry : peak_bytes) {
+        file << entry.first << " " << entry.second << "\n";
+    }
+    if (!file) {
+        throw std::runtime_error("Failed to write arena calibration: " + path);
+    }
+}
+
+void ArenaCalibration::setPeakBytes(int stitch_id, size_t bytes) {
+    peak_bytes[stitch_id] = bytes;
+}
+
+size_t ArenaCalibration::getReserveBytes(int stitch_id) const {
+    size_t bytes = 0;
+    auto it = peak_bytes.find(stitch_id);
+    if (it != peak_bytes.end()) {
+        bytes = it->second;
+    } else {
+        for (const auto& entry : peak_bytes) {
+            bytes = std::max(bytes, entry.second);
+        }
+    }
+    if (bytes == 0) {
+        return 0;
+    }
+    // The arena rounds every request up to its bins and fragments a little; 1/8 extra, in whole MBs
+    constexpr size_t mb = 1024 * 1024;
+    bytes += bytes / 8;
+    return (bytes + mb - 1) / mb * mb;
+}
@@ -0,0 +1,166 @@
+#include "huge_pages.h"
+
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+size_t pageSize() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+// Widens [addr, addr + length) to whole pages, as madvise and mlock want.
+void pageAlign(const void* addr, size_t length, uintptr_t& begin, size_t& aligned_length) {
+    uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+    begin = start & ~(pageSize() - 1);
+    aligned_length = start + length - begin;
+}
+
+// Anonymous mapping whose start is huge page aligned, so THP can back all of it
+void* mapAligned(size_t length) {
+    size_t reserved = length + huge_page_size;
+    void* p = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return nullptr;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(p);
+    uintptr_t aligned = (start + huge_page_size - 1) & ~(huge_page_size - 1);
+    if (aligned > start) {
+        munmap(p, aligned - start);
+    }
+    size_t tail = start + reserved - (aligned + length);
+    if (tail > 0) {
+        munmap(reinterpret_cast<void*>(aligned + length), tail);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+
+// From <numaif.h>, which needs libnuma's headers
+constexpr int mpol_preferred = 1;
+
+} // namespace
+
+void PageResidency::adviseHugePages(const void* addr, size_t length) {
+#ifdef MADV_HUGEPAGE
+    uintptr_t begin;
+    size_t aligned_length;
+    pageAlign(addr, length, begin, aligned_length);
+    madvise(reinterpret_cast<void*>(begin), aligned_length, MADV_HUGEPAGE);
+#else
+    (void)addr;
+    (void)length;
+#endif
+}
+
+size_t PageResidency::prefault(const void* addr, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    uintptr_t begin;
+    size_t aligned_length;
+    pageAlign(addr, length, begin, aligned_length);
+    madvise(reinterpret_cast<void*>(begin), aligned_length, MADV_WILLNEED); // read ahead in big I/Os first
+
+    const volatile uint8_t* bytes = static_cast<const volatile uint8_t*>(addr);
+    uint8_t sink = 0;
+    for (size_t offset = 0; offset < length; offset += pageSize()) {
+        sink ^= bytes[offset];
+    }
+    sink ^= bytes[length - 1];
+    (void)sink;
+    return length;
+}
+
+bool PageResidency::lock(const void* addr, size_t length) {
+    return length == 0 || mlock(addr, length) == 0;
+}
+
+bool PageResidency::bindToNode(const void* addr, size_t length, int numa_node) {
+#ifdef SYS_mbind
+    if (numa_node < 0 || numa_node >= 64 || length == 0) {
+        return false;
+    }
+    uintptr_t begin;
+    size_t aligned_length;
+    pageAlign(addr, length, begin, aligned_length);
+    unsigned long nodemask = 1UL << numa_node;
+    // maxnode counts one past the last bit the kernel reads
+    return syscall(SYS_mbind, begin, aligned_length, mpol_preferred, &nodemask, sizeof(nodemask) * 8 + 1, 0) == 0;
+#else
+    (void)addr;
+    (void)length;
+    (void)numa_node;
+    return false;
+#endif
+}
+
+HugePageBuffer::HugePageBuffer() : addr(nullptr), length(0), hugetlb(false) {}
+
+HugePageBuffer::HugePageBuffer(size_t bytes, int numa_node) : addr(nullptr), length(0), hugetlb(false) {
+    length = (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+    if (length == 0) {
+        return;
+    }
+#ifdef MAP_HUGETLB
+    void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        addr = p;
+        hugetlb = true;
+    }
+#endif
+    if (addr == nullptr) {
+        addr = mapAligned(length);
+        if (addr == nullptr) {
+            length = 0;
+            throw std::bad_alloc();
+        }
+        // Advise before touching, or the pages would be faulted in as small ones
+        PageResidency::adviseHugePages(addr, length);
+    }
+    if (numa_node >= 0) {
+        PageResidency::bindToNode(addr, length, numa_node);
+    }
+    volatile uint8_t* pages = static_cast<volatile uint8_t*>(addr);
+    for (size_t offset = 0; offset < length; offset += pageSize()) {
+        pages[offset] = 0;
+    }
+}
+
+HugePageBuffer::~HugePageBuffer() {
+    release();
+}
+
+HugePageBuffer::HugePageBuffer(HugePageBuffer&& other) noexcept
+    : addr(other.addr), length(other.length), hugetlb(other.hugetlb) {
+    other.addr = nullptr;
+    other.length = 0;
+}
+
+HugePageBuffer& HugePageBuffer::operator=(HugePageBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        addr = other.addr;
+        length = other.length;
+        hugetlb = other.hugetlb;
+        other.addr = nullptr;
+        other.length = 0;
+    }
+    return *this;
+}
+
+bool HugePageBuffer::lock() {
+    return PageResidency::lock(addr, length);
+}
+
+void HugePageBuffer::release() {
+    if (addr != nullptr) {
+        munmap(addr, length);
+        addr = nullptr;
+        length = 0;
+    }
+}
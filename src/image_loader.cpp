@@ -1,9 +1,9 @@
 #include <filesystem>
 #include <fstream>
-#include <iostream>
 #include <array>
 
 #include <image_loader.h>
+#include <trace.h>
 
 #include<opencv2/core.hpp>
 #include<opencv2/highgui.hpp>
@@ -11,19 +11,44 @@
 
 
 std::vector<float> ImageHelpers::loadImage(const std::string& filename, int sizeX, int sizeY) {
+    SNNET_TRACE_SCOPE("preprocess", "load_image");
     cv::Mat image = cv::imread(filename);
     if (image.empty()) {
-        std::cout << "No image found.";
+        return {};
     }
+    return toTensor(image, sizeX, sizeY);
+}
+
+std::vector<float> ImageHelpers::decodeImage(const unsigned char* data, size_t size, int sizeX, int sizeY) {
+    SNNET_TRACE_SCOPE("preprocess", "decode_image");
+    cv::Mat encoded(1, static_cast<int>(size), CV_8UC1, const_cast<unsigned char*>(data));
+    cv::Mat image = cv::imdecode(encoded, cv::IMREAD_COLOR);
+    if (image.empty()) {
+        return {};
+    }
+    return toTensor(image, sizeX, sizeY);
+}
 
+std::vector<float> ImageHelpers::toTensor(const cv::Mat& image, int sizeX, int sizeY) {
+    return toCHW(resize(toRgb(image), sizeX, sizeY));
+}
+
+cv::Mat ImageHelpers::toRgb(const cv::Mat& bgr) {
     // convert from BGR to RGB
-    cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
+    cv::Mat rgb;
+    cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+    return rgb;
+}
 
-    // resize
-    cv::resize(image, image, cv::Size(sizeX, sizeY));
+cv::Mat ImageHelpers::resize(const cv::Mat& image, int sizeX, int sizeY) {
+    cv::Mat resized;
+    cv::resize(image, resized, cv::Size(sizeX, sizeY));
+    return resized;
+}
 
+std::vector<float> ImageHelpers::toCHW(const cv::Mat& rgb) {
     // reshape to 1D
-    image = image.reshape(1, 1);
+    cv::Mat image = rgb.reshape(1, 1);
 
     // uint_8, [0, 255] -> float, [0, 1]
     // Normalize number to between 0 and 1
@@ -0,0 +1,411 @@
+#include "inference_engine.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <climits>
+#include <stdexcept>
+#include <thread>
+
+#include <onnxruntime_session_options_config_keys.h>
+
+#include "constants.h"
+#include "metrics.h"
+#include "trace.h"
+
+namespace {
+
+// ORT affinity string for the `threads` - 1 pool threads (the caller is the first thread):
+// ";"-separated per thread, 1-based processor ids. Empty when there is nothing to pin.
+std::string threadAffinities(const std::vector<int>& cpus, int threads) {
+    std::string affinities;
+    for (int t = 1; t < threads && !cpus.empty(); ++t) {
+        if (!affinities.empty()) affinities += ";";
+        affinities += std::to_string(cpus[t % cpus.size()] + 1);
+    }
+    return affinities;
+}
+
+/* Tensors wrapping the step buffers of this thread's recent runs. Creating an Ort::Value
+ * allocates, so steady-state runs over the same context and caller buffers reuse them.
+ * Keyed by buffer and shape; the oldest entry is replaced when all are taken. */
+struct TensorCache {
+    struct Entry {
+        const float* data = nullptr;
+        std::vector<int64_t> shape;
+        Ort::Value value{ nullptr };
+    };
+    std::array<Entry, 64> entries;
+    size_t next = 0;
+
+    Ort::Value& wrap(const Ort::MemoryInfo& memory_info, float* data, int64_t elements, const std::vector<int64_t>& shape) {
+        for (Entry& entry : entries) {
+            if (entry.data == data && entry.shape == shape) {
+                return entry.value;
+            }
+        }
+        Entry& entry = entries[next];
+        next = (next + 1) % entries.size();
+        entry.value = Ort::Value::CreateTensor<float>(memory_info, data, elements, shape.data(), shape.size());
+        entry.data = data;
+        entry.shape = shape;
+        return entry.value;
+    }
+};
+
+thread_local TensorCache tensor_cache;
+
+Ort::Env makeEnv(const EngineOptions& options) {
+    if (!options.shared_thread_pools) {
+        return Ort::Env(ORT_LOGGING_LEVEL_WARNING, "ModelInference");
+    }
+    // One intra-op and one inter-op pool for the whole process, used by every session
+    Ort::ThreadingOptions threading_options;
+    threading_options.SetGlobalIntraOpNumThreads(options.intra_op_threads);
+    threading_options.SetGlobalInterOpNumThreads(1);
+    std::string affinities = threadAffinities(options.cpu_affinity, options.intra_op_threads);
+    if (!affinities.empty()) {
+        Ort::ThrowOnError(Ort::GetApi().SetGlobalIntraOpThreadAffinity(threading_options, affinities.c_str()));
+    }
+    return Ort::Env(threading_options, ORT_LOGGING_LEVEL_WARNING, "ModelInference");
+}
+
+void setThreads(Ort::SessionOptions& session_options, const EngineOptions& options, int threads) {
+    session_options.SetIntraOpNumThreads(threads);
+    std::string affinities = threadAffinities(options.cpu_affinity, threads);
+    if (!affinities.empty()) {
+        session_options.AddConfigEntry(kOrtSessionOptionsConfigIntraOpThreadAffinities, affinities.c_str());
+    }
+}
+
+Ort::SessionOptions makeSessionOptions(const EngineOptions& options) {
+    Ort::SessionOptions session_options;
+    if (options.shared_thread_pools) {
+        session_options.DisablePerSessionThreads();
+    } else {
+        setThreads(session_options, options, options.intra_op_threads);
+    }
+    if (options.env_allocator != EnvAllocator::None) {
+        session_options.AddConfigEntry(kOrtSessionOptionsConfigUseEnvAllocators, "1");
+    }
+    return session_options;
+}
+
+void registerEnvAllocator(Ort::Env& env, const EngineOptions& options, const Ort::MemoryInfo& memory_info) {
+    try {
+        if (options.env_allocator == EnvAllocator::Counting) {
+            Ort::ThrowOnError(Ort::GetApi().RegisterAllocator(env, &CountingAllocator::instance()));
+        } else if (options.env_allocator == EnvAllocator::Arena) {
+            // Next power of two growth, so the first chunk is the whole reservation (same-as-requested
+            // would ignore it); one chunk sized from calibration means the arena never grows while running
+            int initial_chunk = static_cast<int>(std::min<size_t>(options.arena_reserve_bytes, INT_MAX));
+            Ort::ArenaCfg arena_cfg(0, 0, initial_chunk > 0 ? initial_chunk : -1, -1);
+            env.CreateAndRegisterAllocator(memory_info, arena_cfg);
+        }
+    } catch (const Ort::Exception& e) {
+        // The env is a process-wide singleton: another engine registered its allocator already
+        if (e.GetOrtErrorCode() != ORT_INVALID_ARGUMENT) throw;
+    }
+}
+
+} // namespace
+
+namespace {
+
+constexpr size_t ping_elements = std::max(maxNumInputElements, in_numChannels * in_height * in_width);
+// pong starts on a cache line of its own
+constexpr size_t pong_offset = (ping_elements * sizeof(float) + 63) / 64 * 64;
+
+} // namespace
+
+InferenceContext::InferenceContext(int numa_node)
+    : memory(pong_offset + maxNumOutputElements * sizeof(float), numa_node),
+      ping(static_cast<float*>(memory.data())),
+      pong(reinterpret_cast<float*>(static_cast<char*>(memory.data()) + pong_offset)) {}
+
+InferenceEngine::InferenceEngine(const EngineOptions& o)
+    : options(o),
+      env(makeEnv(o)),
+      session_options(makeSessionOptions(o)),
+      factory(env, session_options, o.model_dir),
+      sessions(factory),
+      memory_info(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)) {
+    registerEnvAllocator(env, options, memory_info);
+    if (!options.tuning_file.empty() && !options.shared_thread_pools) {
+        tuning = TuningTable::load(options.tuning_file);
+    }
+    if (!tuning.empty()) {
+        const int concurrency = options.throughput_mode ? static_cast<int>(std::thread::hardware_concurrency()) : 1;
+        factory.setSessionTuner([this, concurrency](const std::string& model_name, Ort::SessionOptions& session) {
+            const TuningResult* tuned = tuning.find(StitchPlan::modelWidth(model_name), concurrency);
+            if (tuned != nullptr) {
+                tuned->config.apply(session);
+                setThreads(session, options, tuned->config.intra_op_threads); // affinities for the tuned count
+            }
+        });
+    }
+    if (!options.packed_dir.empty()) {
+        factory.usePackedDir(options.packed_dir);
+    }
+    if (options.share_prepacked_weights) {
+        factory.sharePrepackedWeights();
+    }
+    // ORT format models embed their weights: cached, every session would hold its own copy of the weight store's
+    if (!options.ort_cache_dir.empty() && !factory.hasWeightStore()) {
+        factory.useOrtCache(options.ort_cache_dir, "intra_op_threads=" + std::to_string(options.intra_op_threads));
+    }
+    if (options.numa_node >= 0) {
+        factory.localizeModels(hotModelNames(), options.numa_node);
+    }
+    sessions.setMemoryBudget(options.memory_budget);
+}
+
+void InferenceEngine::preload(const StitchPlan& plan) {
+    std::vector<std::string> names = plan.getModelNames();
+    if (options.streaming) { // only the first window is kept resident
+        names.resize(std::min<size_t>(names.size(), options.prefetch_window + 1));
+    }
+    sessions.preload(names);
+}
+
+float* InferenceEngine::runSteps(const StitchPlan& plan, size_t first, size_t last, float* input, float* spare, float* logits) {
+    const std::vector<PlanStep>& steps = plan.getSteps();
+    float* output = spare;
+    for (size_t i = first; i < last; ++i) {
+        const PlanStep& step = steps[i];
+        // The last step writes straight into the caller's logits
+        float* step_output = (i + 1 == steps.size()) ? logits : output;
+        SNNET_TRACE_SCOPE_ARG("step", PlanStep::kindName(step.kind), i);
+        auto step_start = std::chrono::steady_clock::now();
+
+        [[maybe_unused]] uint64_t stage_begin = SNNET_TRACE_NOW();
+        std::shared_ptr<Ort::Session> session = sessions.get(step.model_name);
+        for (size_t ahead = i + 1; ahead <= i + options.prefetch_window && ahead < steps.size(); ++ahead) {
+            sessions.prefetch(steps[ahead].model_name);
+        }
+        SNNET_TRACE_RECORD("engine", "session", stage_begin, i);
+
+        stage_begin = SNNET_TRACE_NOW();
+        Ort::Value& input_tensor = tensor_cache.wrap(memory_info, input, step.inputElements(), step.input_shape);
+        Ort::Value& output_tensor = tensor_cache.wrap(memory_info, step_output, step.outputElements(), step.output_shape);
+        SNNET_TRACE_RECORD("engine", "bind", stage_begin, i);
+
+        stage_begin = SNNET_TRACE_NOW();
+        session->Run(Ort::RunOptions{ nullptr }, &step.input_name, &input_tensor, 1, &step.output_name, &output_tensor, 1);
+        SNNET_TRACE_RECORD("engine", "run", stage_begin, i);
+
+        session.reset();
+        if (options.streaming) {
+            sessions.release(step.model_name);
+        }
+        Metrics::global().recordStep(plan.getStitchId(), i, Metrics::microsSince(step_start));
+        if (step_output == logits) {
+            return logits;
+        }
+        std::swap(input, output);
+    }
+    return input;
+}
+
+void InferenceEngine::run(const StitchPlan& plan, const float* image, float* logits, InferenceContext& context) {
+    const std::vector<PlanStep>& steps = plan.getSteps();
+    auto start = std::chrono::steady_clock::now();
+    try {
+        // The embed step reads the caller's image in place (ORT does not write inputs); later steps ping-pong in the context
+        float* embedded = runSteps(plan, 0, 1, const_cast<float*>(image), context.ping, logits);
+        runSteps(plan, 1, steps.size(), embedded, embedded == context.ping ? context.pong : context.ping, logits);
+    } catch (...) {
+        Metrics::global().countRequestError();
+        throw;
+    }
+    Metrics::global().recordRequest(plan.getStitchId(), Metrics::microsSince(start));
+}
+
+struct InferenceEngine::AsyncRun {
+    InferenceEngine& engine;
+    const StitchPlan& plan;
+    float* logits;
+    std::function<void(std::exception_ptr)> done;
+
+    size_t step = 0;
+    float* input;
+    float* output;
+    uint64_t step_begin = 0;    // trace timestamp, see trace.h
+    std::chrono::steady_clock::time_point start, step_start;
+    // Kept alive until the step completes
+    std::shared_ptr<Ort::Session> session;
+    Ort::Value input_tensor{ nullptr };
+    Ort::Value output_tensor{ nullptr };
+};
+
+void InferenceEngine::startStep(AsyncRun* run) {
+    const std::vector<PlanStep>& steps = run->plan.getSteps();
+    const PlanStep& step = steps[run->step];
+    float* step_output = (run->step + 1 == steps.size()) ? run->logits : run->output;
+
+    run->step_begin = SNNET_TRACE_NOW();
+    run->step_start = std::chrono::steady_clock::now();
+    run->session = sessions.get(step.model_name);
+    for (size_t ahead = run->step + 1; ahead <= run->step + options.prefetch_window && ahead < steps.size(); ++ahead) {
+        sessions.prefetch(steps[ahead].model_name);
+    }
+
+    run->input_tensor = Ort::Value::CreateTensor<float>(
+        memory_info, run->input, step.inputElements(), step.input_shape.data(), step.input_shape.size());
+    run->output_tensor = Ort::Value::CreateTensor<float>(
+        memory_info, step_output, step.outputElements(), step.output_shape.data(), step.output_shape.size());
+    run->session->RunAsync(Ort::RunOptions{ nullptr }, &step.input_name, &run->input_tensor, 1, &step.output_name,
+                           &run->output_tensor, 1, &InferenceEngine::onStepDone, run);
+}
+
+void InferenceEngine::onStepDone(void* user_data, OrtValue**, size_t, OrtStatusPtr status_ptr) {
+    // Called by ORT: nothing may throw past here
+    std::unique_ptr<AsyncRun> run(static_cast<AsyncRun*>(user_data));
+    SNNET_TRACE_RECORD("step", PlanStep::kindName(run->plan.getSteps()[run->step].kind), run->step_begin, run->step);
+    Ort::Status status(status_ptr);
+    std::exception_ptr error;
+    if (!status.IsOK()) {
+        error = std::make_exception_ptr(Ort::Exception(status.GetErrorMessage(), status.GetErrorCode()));
+    } else {
+        InferenceEngine& engine = run->engine;
+        const std::vector<PlanStep>& steps = run->plan.getSteps();
+        const std::string model_name = steps[run->step].model_name;   // a copy: the plan may go with the request
+        // This thread may belong to the session's own pool, which its destructor joins: the session is
+        // held until the next step has started (so no eviction can pick it), and a streaming release
+        // is left to the cache's background thread
+        std::shared_ptr<Ort::Session> finished = std::move(run->session);
+        Metrics::global().recordStep(run->plan.getStitchId(), run->step, Metrics::microsSince(run->step_start));
+        try {
+            if (++run->step < steps.size()) {
+                std::swap(run->input, run->output);
+                engine.startStep(run.get());
+                run.release(); // owned by the next callback
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        finished.reset();   // the cache still holds it: only unheld sessions are evicted
+        if (engine.options.streaming) {
+            engine.sessions.releaseLater(model_name);
+        }
+        if (!run) {
+            return;
+        }
+    }
+    if (error) {
+        Metrics::global().countRequestError();
+    } else {
+        Metrics::global().recordRequest(run->plan.getStitchId(), Metrics::microsSince(run->start));
+    }
+    std::function<void(std::exception_ptr)> done = std::move(run->done);
+    run.reset();
+    done(error);
+}
+
+void InferenceEngine::runAsync(const StitchPlan& plan, const float* image, float* logits, InferenceContext& context,
+                               std::function<void(std::exception_ptr)> done) {
+    std::copy(image, image + plan.getSteps().front().inputElements(), context.ping);
+    std::unique_ptr<AsyncRun> run(new AsyncRun{ *this, plan, logits, std::move(done), 0, context.ping, context.pong, 0, {}, {}, nullptr });
+    run->start = std::chrono::steady_clock::now();
+    try {
+        startStep(run.get());
+        run.release();
+    } catch (...) {
+        Metrics::global().countRequestError();
+        std::function<void(std::exception_ptr)> failed = std::move(run->done);
+        run.reset();
+        failed(std::current_exception());
+    }
+}
+
+std::unique_ptr<InferenceContext> InferenceEngine::acquireContext() {
+    {
+        std::lock_guard<std::mutex> lock(context_mutex);
+        if (!spare_contexts.empty()) {
+            std::unique_ptr<InferenceContext> context = std::move(spare_contexts.back());
+            spare_contexts.pop_back();
+            return context;
+        }
+    }
+    return std::make_unique<InferenceContext>(options.numa_node);
+}
+
+void InferenceEngine::releaseContext(std::unique_ptr<InferenceContext> context) {
+    std::lock_guard<std::mutex> lock(context_mutex);
+    spare_contexts.push_back(std::move(context));
+}
+
+void InferenceEngine::submit(const std::vector<float>& image, int stitch_id,
+                             std::function<void(std::vector<float> logits, std::exception_ptr error)> callback) {
+    auto plan = std::make_shared<StitchPlan>(stitch_id);
+    if (image.size() != static_cast<size_t>(plan->getSteps().front().inputElements())) {
+        throw std::invalid_argument("Invalid image format. Must be 224x224 RGB image.");
+    }
+    auto logits = std::make_shared<std::vector<float>>(out_numClasses);
+    InferenceContext* context = acquireContext().release();
+    runAsync(*plan, image.data(), logits->data(), *context,
+             [this, plan, logits, context, callback = std::move(callback)](std::exception_ptr error) {
+                 releaseContext(std::unique_ptr<InferenceContext>(context));
+                 callback(std::move(*logits), error);
+             });
+}
+
+std::future<std::vector<float>> InferenceEngine::submit(const std::vector<float>& image, int stitch_id) {
+    auto promise = std::make_shared<std::promise<std::vector<float>>>();
+    std::future<std::vector<float>> result = promise->get_future();
+    submit(image, stitch_id, [promise](std::vector<float> logits, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(std::move(logits));
+        }
+    });
+    return result;
+}
+
+std::vector<std::string> InferenceEngine::hotModelNames() {
+    std::vector<std::string> names;
+    for (int anchor = 0; anchor < 3; ++anchor) {
+        names.push_back(StitchPlan::embedModelName(anchor));
+        names.push_back(StitchPlan::headModelName(anchor));
+    }
+    for (int s_id = 3; s_id < num_stitch_ids; ++s_id) {
+        names.push_back(StitchPlan::stitchModelName(s_id));
+    }
+    return names;
+}
+
+PinStats InferenceEngine::pinHotSet(const StitchPlan& plan, bool lock) {
+    std::vector<std::string> names = plan.getModelNames();
+    for (int s_id = 3; s_id < num_stitch_ids; ++s_id) {
+        std::string name = StitchPlan::stitchModelName(s_id);
+        if (std::find(names.begin(), names.end(), name) == names.end()) {
+            names.push_back(std::move(name));
+        }
+    }
+    return factory.pinModels(names, lock);
+}
+
+std::vector<float> InferenceEngine::infer(const std::vector<float>& image, int stitch_id) {
+    StitchPlan plan(stitch_id);
+    if (image.size() != static_cast<size_t>(plan.getSteps().front().inputElements())) {
+        throw std::invalid_argument("Invalid image format. Must be 224x224 RGB image.");
+    }
+    InferenceContext context(options.numa_node);
+    std::vector<float> logits(out_numClasses);
+    run(plan, image.data(), logits.data(), context);
+    return logits;
+}
+
+size_t InferenceEngine::calibrateArena(const StitchPlan& plan, const float* image) {
+    if (options.env_allocator != EnvAllocator::Counting) {
+        throw std::logic_error("Arena calibration needs EnvAllocator::Counting");
+    }
+    CountingAllocator& allocator = CountingAllocator::instance();
+    allocator.resetPeak();
+    preload(plan);
+    InferenceContext context;
+    std::vector<float> logits(out_numClasses);
+    run(plan, image, logits.data(), context);
+    return allocator.getStats().peak_bytes;
+}
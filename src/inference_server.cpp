@@ -0,0 +1,468 @@
+#include "inference_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "image_loader.h"
+#include "logits.h"
+#include "metrics.h"
+#include "server_protocol.h"
+#include "trace.h"
+
+namespace {
+
+// epoll ids below first_connection_id are the server's own descriptors
+constexpr uint64_t wake_id = 0, unix_id = 1, tcp_id = 2, metrics_id = 3, first_connection_id = 16;
+constexpr size_t tensor_bytes = in_numChannels * in_height * in_width * sizeof(float);
+
+int check(int result, const char* what) {
+    if (result < 0) {
+        throw std::runtime_error(std::string(what) + ": " + strerror(errno));
+    }
+    return result;
+}
+
+int listenUnix(const std::string& path) {
+    int fd = check(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket");
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        ::close(fd);
+        throw std::invalid_argument("Unix socket path too long: " + path);
+    }
+    strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str()); // left behind by an earlier server
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        ::close(fd);
+        check(-1, ("listen on " + path).c_str());
+    }
+    return fd;
+}
+
+int listenLoopback(int port) {
+    int fd = check(socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket");
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        ::close(fd);
+        check(-1, ("listen on port " + std::to_string(port)).c_str());
+    }
+    return fd;
+}
+
+} // namespace
+
+struct InferenceServer::Connection {
+    uint64_t id;
+    int fd;
+    RequestHeader header;
+    size_t header_read = 0;
+    std::unique_ptr<ServerRequest> request;     // payload being read
+    size_t payload_read = 0;
+    std::vector<char> output;                   // responses not sent yet
+    size_t output_sent = 0;
+    bool want_write = false;
+    bool reading = true;                        // EPOLLIN watched: under max_in_flight requests in flight
+    size_t in_flight = 0;                       // submitted, response not queued yet
+    bool metrics = false;                       // on the metrics socket
+    bool close_when_sent = false;               // answered: reads nothing more, closed once the output is sent
+};
+
+struct InferenceServer::ServerRequest : ExecutorTask {
+    InferenceServer& server;
+    uint64_t connection_id;
+    RequestHeader header;
+    std::unique_ptr<InferenceContext> context;
+    std::vector<unsigned char> encoded;         // encoded images, and payloads that are not a valid tensor
+
+    ResponseHeader response{};
+    std::vector<char> payload;
+
+    ServerRequest(InferenceServer& s, uint64_t id, const RequestHeader& h) : server(s), connection_id(id), header(h) {}
+
+    // Where the socket payload goes
+    char* buffer() {
+        return encoded.empty() && header.length > 0 ? reinterpret_cast<char*>(context->ping) : reinterpret_cast<char*>(encoded.data());
+    }
+
+    void run() override {
+        server.process(*this);
+        server.complete(this);
+    }
+};
+
+InferenceServer::InferenceServer(InferenceEngine& e, const ServerOptions& o)
+    : engine(e), options(o), plans(num_stitch_ids), next_connection_id(first_connection_id),
+      executor(o.workers > 0 ? o.workers : RequestExecutor::defaultWorkerCount(e.getOptions().intra_op_threads),
+               e.getOptions().cpu_affinity) {
+    for (int s_id = 0; s_id < num_stitch_ids; ++s_id) {
+        plans[s_id] = std::make_unique<StitchPlan>(s_id);
+    }
+    options.max_in_flight = std::max<size_t>(1, options.max_in_flight);
+    try {
+        epoll_fd = check(epoll_create1(EPOLL_CLOEXEC), "epoll_create1");
+        wake_fd = check(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), "eventfd");
+        watch(wake_fd, wake_id, EPOLLIN);
+        if (!options.unix_path.empty()) {
+            unix_fd = listenUnix(options.unix_path);
+            watch(unix_fd, unix_id, EPOLLIN);
+        }
+        if (options.tcp_port > 0) {
+            tcp_fd = listenLoopback(options.tcp_port);
+            watch(tcp_fd, tcp_id, EPOLLIN);
+        }
+        if (unix_fd < 0 && tcp_fd < 0) {
+            throw std::invalid_argument("Server needs a Unix socket path or a TCP port");
+        }
+        if (!options.metrics_path.empty()) {
+            metrics_fd = listenUnix(options.metrics_path);
+            watch(metrics_fd, metrics_id, EPOLLIN);
+        }
+    } catch (...) {
+        for (int fd : { metrics_fd, tcp_fd, unix_fd, wake_fd, epoll_fd }) {
+            if (fd >= 0) ::close(fd);
+        }
+        throw;
+    }
+}
+
+InferenceServer::~InferenceServer() {
+    executor.waitIdle();
+    drainCompleted();
+    while (!connections.empty()) {
+        close(connections.begin()->first);
+    }
+    for (int fd : { metrics_fd, tcp_fd, unix_fd, wake_fd, epoll_fd }) {
+        if (fd >= 0) ::close(fd);
+    }
+    if (unix_fd >= 0) {
+        unlink(options.unix_path.c_str());
+    }
+    if (metrics_fd >= 0) {
+        unlink(options.metrics_path.c_str());
+    }
+}
+
+void InferenceServer::watch(int fd, uint64_t id, uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = id;
+    check(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event), "epoll_ctl");
+}
+
+void InferenceServer::updateEvents(Connection& connection) {
+    epoll_event event{};
+    event.events = (connection.reading && !connection.close_when_sent ? static_cast<uint32_t>(EPOLLIN) : 0u) |
+                   (connection.want_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = connection.id;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void InferenceServer::run() {
+    SNNET_TRACE_THREAD_NAME("server");
+    epoll_event events[64];
+    while (!stopping.load()) {
+        int n = epoll_wait(epoll_fd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            check(n, "epoll_wait");
+        }
+        for (int i = 0; i < n; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == wake_id) {
+                uint64_t count;
+                while (read(wake_fd, &count, sizeof(count)) > 0) {}
+                drainCompleted();
+            } else if (id == unix_id || id == tcp_id) {
+                accept(id == unix_id ? unix_fd : tcp_fd, id == tcp_id, false);
+            } else if (id == metrics_id) {
+                accept(metrics_fd, false, true);
+            } else {
+                auto it = connections.find(id);
+                if (it == connections.end()) continue; // closed earlier in this batch
+                if (!it->second->reading && (events[i].events & (EPOLLHUP | EPOLLERR))) {
+                    close(id);  // reported even while not reading, and level-triggered: would spin
+                    continue;
+                }
+                if (events[i].events & EPOLLOUT) {
+                    send(*it->second);
+                }
+                if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && (it = connections.find(id)) != connections.end()) {
+                    receive(*it->second); // also notices hangups and errors, and closes
+                }
+            }
+        }
+    }
+}
+
+void InferenceServer::stop() {
+    stopping = true;
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written; // a full eventfd wakes the loop just the same
+}
+
+ServerStats InferenceServer::getStats() const {
+    return { num_connections.load(), num_requests.load(), num_errors.load() };
+}
+
+void InferenceServer::accept(int listen_fd, bool tcp, bool metrics) {
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return; // EAGAIN, or a connection that went away before we got to it
+        }
+        if (tcp) {
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->id = next_connection_id++;
+        connection->fd = fd;
+        connection->metrics = metrics;
+        watch(fd, connection->id, EPOLLIN);
+        connections.emplace(connection->id, std::move(connection));
+        if (!metrics) ++num_connections;
+    }
+}
+
+void InferenceServer::receive(Connection& connection) {
+    if (connection.metrics) {
+        receiveMetricsRequest(connection);
+        return;
+    }
+    const uint64_t id = connection.id;
+    while (true) {
+        ssize_t n;
+        if (connection.header_read < sizeof(RequestHeader)) {
+            n = recv(connection.fd, reinterpret_cast<char*>(&connection.header) + connection.header_read,
+                     sizeof(RequestHeader) - connection.header_read, 0);
+            if (n > 0 && (connection.header_read += n) == sizeof(RequestHeader) && !startRequest(connection)) {
+                close(id);
+                return;
+            }
+        } else {
+            ServerRequest& request = *connection.request;
+            n = recv(connection.fd, request.buffer() + connection.payload_read, request.header.length - connection.payload_read, 0);
+            if (n > 0) connection.payload_read += n;
+        }
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close(id); // peer closed or failed; requests in flight are dropped when they finish
+            return;
+        }
+        if (n < 0 && errno != EINTR) {
+            return; // drained
+        }
+        if (connection.request && connection.payload_read == connection.request->header.length) {
+            connection.header_read = connection.payload_read = 0;
+            ++num_requests;
+            executor.submit(connection.request.release());
+            if (++connection.in_flight >= options.max_in_flight) {
+                connection.reading = false; // resumed by drainCompleted()
+                updateEvents(connection);
+                return;
+            }
+        }
+    }
+}
+
+void InferenceServer::receiveMetricsRequest(Connection& connection) {
+    // Whatever arrives is the request, an HTTP GET or nothing: read and ignore it, then answer once
+    char discard[4096];
+    ssize_t n;
+    while ((n = recv(connection.fd, discard, sizeof(discard), 0)) > 0 || (n < 0 && errno == EINTR)) {}
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        close(connection.id);
+        return;
+    }
+    if (connection.close_when_sent) {
+        return;
+    }
+    const std::string body = Metrics::global().prometheusText();
+    const std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                                 std::to_string(body.size()) + "\r\n\r\n" + body;
+    connection.output.assign(response.begin(), response.end());
+    connection.close_when_sent = true;
+    send(connection);
+}
+
+bool InferenceServer::startRequest(Connection& connection) {
+    const RequestHeader& header = connection.header;
+    if (header.magic != request_magic || header.length > max_request_payload) {
+        return false; // not our protocol, or out of sync: nothing more on this connection can be trusted
+    }
+    auto request = std::make_unique<ServerRequest>(*this, connection.id, header);
+    if (spare_contexts.empty()) {
+        request->context = std::make_unique<InferenceContext>(engine.getOptions().numa_node); // a prefaulted 2 MB page
+    } else {
+        request->context = std::move(spare_contexts.back());
+        spare_contexts.pop_back();
+    }
+    // A tensor of the right size goes straight into the input buffer; anything else is buffered
+    if (header.kind != static_cast<uint8_t>(PayloadKind::Tensor) || header.length != tensor_bytes) {
+        request->encoded.resize(header.length);
+    }
+    connection.request = std::move(request);
+    connection.payload_read = 0;
+    return true;
+}
+
+void InferenceServer::process(ServerRequest& request) {
+    const RequestHeader& header = request.header;
+    ResponseHeader& response = request.response;
+    SNNET_TRACE_SCOPE_ARG("server", "request", header.request_id);
+    response = { response_magic, 0, header.request_id, static_cast<int32_t>(ResponseStatus::Ok), -1, 0.0f };
+    try {
+        const bool tensor = header.kind == static_cast<uint8_t>(PayloadKind::Tensor);
+        if (tensor && header.length != tensor_bytes) {
+            throw std::invalid_argument("Tensor payload must be " + std::to_string(tensor_bytes) + " bytes");
+        }
+        if (!tensor && header.kind != static_cast<uint8_t>(PayloadKind::EncodedImage)) {
+            throw std::invalid_argument("Unknown payload kind");
+        }
+        if (header.stitch_id >= num_stitch_ids || (header.stitch_id < 0 && header.budget_ms <= 0)) {
+            throw std::invalid_argument("Needs a stitch id in [0, " + std::to_string(num_stitch_ids - 1) + "] or a latency budget");
+        }
+        if (!tensor) {
+            std::vector<float> image = ImageHelpers::decodeImage(request.encoded.data(), request.encoded.size());
+            if (image.size() * sizeof(float) != tensor_bytes) {
+                throw std::invalid_argument("Cannot decode image");
+            }
+            std::copy(image.begin(), image.end(), request.context->ping);
+        }
+        const int stitch_id = header.stitch_id >= 0 ? header.stitch_id : selector.choose(header.budget_ms);
+        const StitchPlan& plan = *plans[stitch_id];
+        std::vector<float> logits(out_numClasses);
+
+        auto start = std::chrono::steady_clock::now();
+        engine.runSteps(plan, 0, plan.getSteps().size(), request.context->ping, request.context->pong, logits.data());
+        double latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        selector.observe(stitch_id, latency_ms);
+        Metrics::global().recordRequest(stitch_id, static_cast<uint64_t>(latency_ms * 1000));
+        response.stitch_id = stitch_id;
+        response.latency_ms = static_cast<float>(latency_ms);
+
+        if (header.top_k == 0) {
+            request.payload.resize(logits.size() * sizeof(float));
+            memcpy(request.payload.data(), logits.data(), request.payload.size());
+        } else {
+            std::vector<int> classes = Logits::topK(logits.data(), logits.size(), header.top_k);
+            request.payload.resize(classes.size() * (sizeof(int32_t) + sizeof(float)));
+            char* out = request.payload.data();
+            for (size_t i = 0; i < classes.size(); ++i, out += sizeof(int32_t) + sizeof(float)) {
+                const int32_t label = classes[i];
+                memcpy(out, &label, sizeof(int32_t));
+                memcpy(out + sizeof(int32_t), &logits[classes[i]], sizeof(float));
+            }
+        }
+    } catch (const std::exception& e) {
+        const bool bad_request = dynamic_cast<const std::invalid_argument*>(&e) != nullptr;
+        response.status = static_cast<int32_t>(bad_request ? ResponseStatus::BadRequest : ResponseStatus::Failed);
+        request.payload.assign(e.what(), e.what() + strlen(e.what()));
+        ++num_errors;
+        Metrics::global().countRequestError();
+    }
+    response.length = static_cast<uint32_t>(request.payload.size());
+}
+
+void InferenceServer::complete(ServerRequest* request) {
+    {
+        std::lock_guard<std::mutex> lock(completed_mutex);
+        completed.push_back(request);
+    }
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+void InferenceServer::drainCompleted() {
+    std::vector<ServerRequest*> done;
+    {
+        std::lock_guard<std::mutex> lock(completed_mutex);
+        done.swap(completed);
+    }
+    for (ServerRequest* raw : done) {
+        std::unique_ptr<ServerRequest> request(raw);
+        recycleContext(std::move(request->context));
+        auto it = connections.find(request->connection_id);
+        if (it == connections.end()) {
+            continue; // the client went away
+        }
+        Connection& connection = *it->second;
+        if (connection.in_flight-- == options.max_in_flight && !connection.close_when_sent) {
+            connection.reading = true;
+            updateEvents(connection);
+        }
+        const char* header = reinterpret_cast<const char*>(&request->response);
+        connection.output.insert(connection.output.end(), header, header + sizeof(ResponseHeader));
+        connection.output.insert(connection.output.end(), request->payload.begin(), request->payload.end());
+        send(connection);
+    }
+}
+
+void InferenceServer::send(Connection& connection) {
+    while (connection.output_sent < connection.output.size()) {
+        ssize_t n = ::send(connection.fd, connection.output.data() + connection.output_sent,
+                           connection.output.size() - connection.output_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                close(connection.id);
+                return;
+            }
+            break;
+        }
+        connection.output_sent += n;
+    }
+    const bool pending = connection.output_sent < connection.output.size();
+    if (!pending && connection.close_when_sent) {
+        close(connection.id);
+        return;
+    }
+    if (!pending) {
+        connection.output.clear();
+        connection.output_sent = 0;
+    }
+    if (pending != connection.want_write) { // only wait for EPOLLOUT while something is queued
+        connection.want_write = pending;
+        updateEvents(connection);
+    }
+}
+
+void InferenceServer::close(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) {
+        return;
+    }
+    Connection& connection = *it->second;
+    if (connection.request) {
+        recycleContext(std::move(connection.request->context));
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    ::close(connection.fd);
+    connections.erase(it);
+}
+
+void InferenceServer::recycleContext(std::unique_ptr<InferenceContext> context) {
+    // One per worker covers a steady load; contexts of a burst beyond that are unmapped
+    if (context && spare_contexts.size() < executor.getNumWorkers()) {
+        spare_contexts.push_back(std::move(context));
+    }
+}
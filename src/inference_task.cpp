@@ -0,0 +1,31 @@
+#include "inference_task.h"
+
+#include <algorithm>
+#include <utility>
+
+InferenceTask::InferenceTask(RequestExecutor& e, InferenceEngine& en, const StitchPlan& p, const float* image,
+                             float* l, InferenceContext& c, std::function<void(std::exception_ptr)> d, bool split)
+    : executor(e), engine(en), plan(p), logits(l), context(c), done(std::move(d)), split_steps(split),
+      input(c.ping), spare(c.pong) {
+    std::copy(image, image + plan.getSteps().front().inputElements(), context.ping);
+}
+
+void InferenceTask::run() {
+    const size_t num_steps = plan.getSteps().size();
+    const size_t last = split_steps ? next_step + 1 : num_steps;
+    try {
+        float* result = engine.runSteps(plan, next_step, last, input, spare, logits);
+        if (result != input) {
+            std::swap(input, spare);
+        }
+    } catch (...) {
+        done(std::current_exception());
+        return;
+    }
+    next_step = last;
+    if (next_step < num_steps) {
+        executor.submit(this);
+        return;
+    }
+    done(nullptr);
+}
@@ -0,0 +1,198 @@
+#include "json_reader.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+/* Recursive descent over the whole document in memory */
+class JsonParser {
+private:
+    const std::string& in;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("JSON: " + what + " at offset " + std::to_string(pos));
+    }
+
+    void skipSpace() {
+        while (pos < in.size() && (in[pos] == ' ' || in[pos] == '\t' || in[pos] == '\n' || in[pos] == '\r')) ++pos;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (pos < in.size() && in[pos] == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) fail(std::string("expected '") + c + "'");
+    }
+
+    void literal(const char* word) {
+        for (const char* c = word; *c != '\0'; ++c, ++pos) {
+            if (pos >= in.size() || in[pos] != *c) fail(std::string("expected ") + word);
+        }
+    }
+
+    static void appendUtf8(std::string& out, unsigned code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    unsigned hex4() {
+        if (pos + 4 > in.size()) fail("truncated \\u escape");
+        unsigned code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = in[pos++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else fail("bad \\u escape");
+        }
+        return code;
+    }
+
+    std::string string() {
+        expect('"');
+        std::string out;
+        while (true) {
+            if (pos >= in.size()) fail("unterminated string");
+            char c = in[pos++];
+            if (c == '"') return out;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos >= in.size()) fail("unterminated string");
+            switch (char e = in[pos++]) {
+                case '"': case '\\': case '/': out += e; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned code = hex4();
+                    if (code >= 0xD800 && code < 0xDC00 && pos + 6 <= in.size() && in[pos] == '\\' && in[pos + 1] == 'u') {
+                        pos += 2;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (hex4() - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: fail("bad escape");
+            }
+        }
+    }
+
+public:
+    explicit JsonParser(const std::string& document) : in(document) {}
+
+    JsonValue value() {
+        JsonValue v;
+        skipSpace();
+        if (pos >= in.size()) fail("unexpected end");
+        char c = in[pos];
+        if (c == '{') {
+            ++pos;
+            v.type = JsonValue::Type::Object;
+            if (consume('}')) return v;
+            do {
+                skipSpace();
+                std::string name = string();
+                expect(':');
+                v.members[name] = value();
+            } while (consume(','));
+            expect('}');
+        } else if (c == '[') {
+            ++pos;
+            v.type = JsonValue::Type::Array;
+            if (consume(']')) return v;
+            do {
+                v.elements.push_back(value());
+            } while (consume(','));
+            expect(']');
+        } else if (c == '"') {
+            v.type = JsonValue::Type::String;
+            v.text = string();
+        } else if (c == 't' || c == 'f') {
+            literal(c == 't' ? "true" : "false");
+            v.type = JsonValue::Type::Bool;
+            v.flag = c == 't';
+        } else if (c == 'n') {
+            literal("null");
+        } else {
+            const char* begin = in.c_str() + pos;
+            char* end = nullptr;
+            v.number = std::strtod(begin, &end);
+            if (end == begin) fail("unexpected character");
+            v.type = JsonValue::Type::Number;
+            pos += end - begin;
+        }
+        return v;
+    }
+
+    void finish() {
+        skipSpace();
+        if (pos != in.size()) fail("trailing characters");
+    }
+};
+
+JsonValue JsonValue::parse(const std::string& document) {
+    JsonParser parser(document);
+    JsonValue v = parser.value();
+    parser.finish();
+    return v;
+}
+
+JsonValue JsonValue::parseFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    std::ostringstream text;
+    text << file.rdbuf();
+    return parse(text.str());
+}
+
+bool JsonValue::asBool(bool fallback) const {
+    return type == Type::Bool ? flag : fallback;
+}
+
+double JsonValue::asNumber(double fallback) const {
+    return type == Type::Number ? number : fallback;
+}
+
+const std::string& JsonValue::asString() const {
+    static const std::string empty;
+    return type == Type::String ? text : empty;
+}
+
+const JsonValue& JsonValue::operator[](const std::string& name) const {
+    static const JsonValue null;
+    auto it = members.find(name);
+    return it != members.end() ? it->second : null;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+    static const JsonValue null;
+    return index < elements.size() ? elements[index] : null;
+}
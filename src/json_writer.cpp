@@ -0,0 +1,139 @@
+#include "json_writer.h"
+
+#include <cmath>
+#include <cstdio>
+
+JsonWriter::JsonWriter(std::ostream& o, bool c) : out(o), compact(c) {}
+
+void JsonWriter::separate() {
+    if (after_key) { // the value of a member goes on the key's line
+        after_key = false;
+        return;
+    }
+    if (empty_scopes.empty()) {
+        return;
+    }
+    if (!empty_scopes.back()) {
+        out << ",";
+    }
+    empty_scopes.back() = false;
+    if (!compact) {
+        out << "\n" << std::string(2 * empty_scopes.size(), ' ');
+    }
+}
+
+void JsonWriter::close(char bracket) {
+    bool was_empty = empty_scopes.back();
+    empty_scopes.pop_back();
+    if (!compact && !was_empty) {
+        out << "\n" << std::string(2 * empty_scopes.size(), ' ');
+    }
+    out << bracket;
+    if (empty_scopes.empty() && !compact) {
+        out << "\n";
+    }
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    separate();
+    out << "{";
+    empty_scopes.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    close('}');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    separate();
+    out << "[";
+    empty_scopes.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    close(']');
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(const std::string& name) {
+    separate();
+    out << quote(name) << (compact ? ":" : ": ");
+    after_key = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const std::string& text) {
+    separate();
+    out << quote(text);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* text) {
+    return value(std::string(text));
+}
+
+JsonWriter& JsonWriter::value(double number) {
+    separate();
+    if (!std::isfinite(number)) {
+        out << "null";
+    } else {
+        char text[32];
+        snprintf(text, sizeof(text), "%.6g", number);
+        out << text;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(double number, int decimals) {
+    separate();
+    if (!std::isfinite(number)) {
+        out << "null";
+    } else {
+        char text[64];
+        snprintf(text, sizeof(text), "%.*f", decimals, number);
+        out << text;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int64_t number) {
+    separate();
+    out << number;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(uint64_t number) {
+    separate();
+    out << number;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int number) {
+    return value(static_cast<int64_t>(number));
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+    separate();
+    out << (flag ? "true" : "false");
+    return *this;
+}
+
+std::string JsonWriter::quote(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
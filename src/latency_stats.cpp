@@ -0,0 +1,25 @@
+#include "latency_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+LatencySummary LatencySummary::of(std::vector<double> samples) {
+    LatencySummary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto rank = [&](double p) { // nearest rank: the smallest sample with at least p of them at or below it
+        size_t index = static_cast<size_t>(std::ceil(p * samples.size()));
+        return samples[std::min(samples.size(), std::max<size_t>(index, 1)) - 1];
+    };
+    summary.count = samples.size();
+    summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    summary.min = samples.front();
+    summary.p50 = rank(0.50);
+    summary.p90 = rank(0.90);
+    summary.p99 = rank(0.99);
+    summary.max = samples.back();
+    return summary;
+}
@@ -0,0 +1,85 @@
+#include "load_schedule.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+LoadSchedule LoadSchedule::generate(ArrivalPattern pattern, double rate, double duration_s, int stitch_id,
+                                    int num_images, int burst, uint32_t seed) {
+    if (rate <= 0 || duration_s <= 0) {
+        throw std::invalid_argument("Load rate and duration must be positive");
+    }
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> image(0, std::max(1, num_images) - 1);
+    const int group = pattern == ArrivalPattern::Bursty ? std::max(1, burst) : 1;
+    std::exponential_distribution<double> gap(rate / group / 1000);  // per ms
+
+    LoadSchedule schedule;
+    const double end_ms = duration_s * 1000;
+    for (double t = pattern == ArrivalPattern::Uniform ? 0 : gap(rng); t < end_ms;) {
+        for (int i = 0; i < group; i++) schedule.arrivals.push_back({ t, stitch_id, image(rng) });
+        t += pattern == ArrivalPattern::Uniform ? 1000 / rate : gap(rng);
+    }
+    return schedule;
+}
+
+LoadSchedule LoadSchedule::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open trace: " + path);
+    }
+    LoadSchedule schedule;
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        std::istringstream fields(line);
+        Arrival arrival;
+        if (!(fields >> arrival.at_ms >> arrival.stitch_id >> arrival.image_id) || arrival.at_ms < 0 || arrival.image_id < 0) {
+            throw std::runtime_error(path + ":" + std::to_string(number) + ": expected \"<ms> <stitch id> <image id>\"");
+        }
+        schedule.arrivals.push_back(arrival);
+    }
+    // Traces merged from several sources may interleave
+    std::stable_sort(schedule.arrivals.begin(), schedule.arrivals.end(),
+                     [](const Arrival& a, const Arrival& b) { return a.at_ms < b.at_ms; });
+    return schedule;
+}
+
+void LoadSchedule::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    file << "# <ms> <stitch id> <image id>\n" << std::fixed << std::setprecision(3);
+    for (const Arrival& arrival : arrivals) {
+        file << arrival.at_ms << " " << arrival.stitch_id << " " << arrival.image_id << "\n";
+    }
+    if (!file) {
+        throw std::runtime_error("Failed to write trace: " + path);
+    }
+}
+
+void LoadSchedule::scale(double speed) {
+    if (speed <= 0) {
+        throw std::invalid_argument("Replay speed must be positive");
+    }
+    for (Arrival& arrival : arrivals) arrival.at_ms /= speed;
+}
+
+ArrivalPattern LoadSchedule::parsePattern(const std::string& name) {
+    if (name == "uniform") return ArrivalPattern::Uniform;
+    if (name == "poisson") return ArrivalPattern::Poisson;
+    if (name == "bursty") return ArrivalPattern::Bursty;
+    throw std::invalid_argument("Unknown arrival pattern: " + name);
+}
+
+double LoadSchedule::offeredRate() const {
+    if (arrivals.size() < 2 || arrivals.back().at_ms <= arrivals.front().at_ms) {
+        return 0;
+    }
+    // n arrivals span n - 1 gaps
+    return (arrivals.size() - 1) * 1000.0 / (arrivals.back().at_ms - arrivals.front().at_ms);
+}
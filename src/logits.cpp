@@ -0,0 +1,21 @@
+#include "logits.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "trace.h"
+
+int Logits::argmax(const float* logits, size_t n) {
+    return static_cast<int>(std::max_element(logits, logits + n) - logits);
+}
+
+std::vector<int> Logits::topK(const float* logits, size_t n, size_t k) {
+    SNNET_TRACE_SCOPE("postprocess", "top_k");
+    std::vector<int> classes(n);
+    std::iota(classes.begin(), classes.end(), 0);
+    k = std::min(k, n);
+    std::partial_sort(classes.begin(), classes.begin() + k, classes.end(),
+                      [&](int a, int b) { return logits[a] > logits[b]; });
+    classes.resize(k);
+    return classes;
+}
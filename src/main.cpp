@@ -1,73 +1,323 @@
 /* This code is ONNX execution with the partitioned SN-Net (CVPR, 2023)
  * by Jiwon Kim, MOBED, Yonsei Univ.
- * Anchors: "deit_{type}_patch16_224_layer_#.onnx" 
+ * Anchors: "deit_{type}_patch16_224_layer_#.onnx"
  * {type}: tiny, small, base; #: 0 - 11
  *      tiny  (input: "input.1"/float32[1,197,192], output: "100"/float32[1,197,192])
  *      small (input: "input.1"/float32[1,197,384], output: "100"/float32[1,197,384])
  *      base  (input: "input.1"/float32[1,197,768], output: "100"/float32[1,197,768])
- * Stitch Layers: 
+ * Stitch Layers:
  * deit_sl_3.onnx - deit_sl_36.onnx: tiny to small
  *      (input: "onnx::MatMul_0"/float32[1,197,192], output: "5"/float32[1,197,384])
- * deit_sl_37.onnx - deit_sl_70.onnx: small to base 
+ * deit_sl_37.onnx - deit_sl_70.onnx: small to base
  *      (input: "onnx::MatMul_0"/float32[1,197,384], output: "5"/float32[1,197,768])
  */
 
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <future>
+#include <fstream>
+#include <csignal>
+#include <stdexcept>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <onnxruntime/core/providers/cpu/cpu_provider_factory.h>
 #include <onnxruntime_cxx_api.h>
 
-#include "stitch_config.h"
+#include "alloc_counter.h"
+#include "batch_runner.h"
 #include "constants.h"
+#include "env_allocator.h"
 #include "image_loader.h"
+#include "inference_server.h"
+#include "logits.h"
+#include "metrics.h"
+#include "inference_engine.h"
+#include "numa_engine.h"
+#include "numa_topology.h"
+#include "inference_task.h"
+#include "pipeline_executor.h"
+#include "request_executor.h"
+#include "resource_usage.h"
+#include "stitch_plan.h"
 
 using namespace std;
 
-class StitchLayer {
-	private:
-		int stitch_id, stitch_config_id; // stitch_id: 3-70, stitch_config_id: 0-33
-		int stitch_code; // 0: tiny, 1: small, 2: base, 3: tiny-small, 4: small-base
-		pair<int, int> anchor_layer_num; // <front, back> anchors' layer to stich
-		int num_stitchies;
-		StitchConfig config;
-
-	public:
-    StitchLayer(int s_id) : stitch_id(s_id), config(12, 2, 1) {		
-		if (stitch_id < 3) {
-			stitch_code = stitch_id, stitch_config_id = -1;
-			anchor_layer_num.first = 11, anchor_layer_num.second = 12;
-		} else if (stitch_id > 36) {
-			stitch_config_id = stitch_id - 34 - 3;
-			stitch_code = 4;
-			anchor_layer_num = config.getStitchConfig(stitch_config_id);
+/* Threads and resident memory added by loading and running one plan */
+struct SharingSample {
+	bool ok;
+	int threads;
+	long rss_bytes;
+};
+
+// Measured in a child process, so each configuration starts from a clean heap and no ORT state
+static SharingSample measureInChild(const EngineOptions& options, int stitch_id, const vector<float>& image) {
+	SharingSample sample{ false, 0, 0 };
+	int fds[2];
+	if (pipe(fds) != 0) return sample;
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(fds[0]);
+		try {
+			ResourceUsage before = ResourceUsage::current();
+			InferenceEngine engine(options);
+			engine.preload(StitchPlan(stitch_id));
+			engine.infer(image, stitch_id);
+			ResourceUsage after = ResourceUsage::current();
+			sample = { true, after.threads - before.threads, static_cast<long>(after.rss_bytes) - static_cast<long>(before.rss_bytes) };
+		} catch (const exception& e) {
+			cerr << "Measurement failed: " << e.what() << endl;
+		}
+		ssize_t written = write(fds[1], &sample, sizeof(sample));
+		_exit(written == sizeof(sample) ? 0 : 1);
+	}
+	close(fds[1]);
+	if (pid > 0) {
+		if (read(fds[0], &sample, sizeof(sample)) != sizeof(sample)) sample.ok = false;
+		waitpid(pid, nullptr, 0);
+	}
+	close(fds[0]);
+	return sample;
+}
+
+/* One engine replica per NUMA node; the request runs on the node of the CPU main runs on */
+static vector<float> runOnNumaNodes(const EngineOptions& options, const StitchPlan& plan, const vector<float>& image, bool lazy_loading) {
+	NumaEngine engine(options);
+	cout << "NUMA nodes:";
+	for (size_t i = 0; i < engine.getNumReplicas(); i++) {
+		cout << " node" << engine.getNode(i).id << " (" << engine.getNode(i).cpus.size() << " CPUs)";
+	}
+	cout << endl;
+	if (!lazy_loading) {
+		cout << "\nLoading " << plan.getSteps().size() << " ONNX models on every node..." << endl;
+		engine.preload(plan);
+	}
+	cout << "Running inference..." << endl;
+	vector<float> logits(out_numClasses);
+	size_t replica = engine.run(plan, image.data(), logits.data());
+	cout << "Served by NUMA node " << engine.getNode(replica).id << endl;
+	return logits;
+}
+
+// Parses the list given with --cpus; on a bad one prints why and returns false, so the caller prints its usage
+static bool parseCpus(const char* list, vector<int>& cpus) {
+	try {
+		cpus = NumaTopology::parseCpuList(list);
+		return true;
+	} catch (const invalid_argument& e) {
+		cerr << "--cpus: " << e.what() << endl;
+		return false;
+	}
+}
+
+/* Batch mode: snnet-onnx --batch <manifest | -> [--output <file | ->] [--binary] [--top-k K] [--budget-mb <MB>] [--cpus <list>]
+ *                               [--metrics-file <file>]
+ * Scores every manifest line with one warm engine; results go to stdout unless --output is given, progress to stderr */
+static int runBatch(int argc, char* argv[]) {
+	EngineOptions engine_options;
+	engine_options.ort_cache_dir = "./pretrained/ort_cache/";
+	BatchOptions batch_options;
+	string manifest_path = argv[2], output_path = "-", metrics_file;
+	for (int i = 3; i < argc; i++) {
+		if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			output_path = argv[++i];
+		} else if (strcmp(argv[i], "--binary") == 0) {
+			batch_options.binary = true;
+		} else if (strcmp(argv[i], "--top-k") == 0 && i + 1 < argc) {
+			batch_options.top_k = max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--budget-mb") == 0 && i + 1 < argc) {
+			engine_options.memory_budget = static_cast<size_t>(atof(argv[++i]) * 1024 * 1024);
+		} else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc && parseCpus(argv[i + 1], engine_options.cpu_affinity)) {
+			i++;
+		} else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+			metrics_file = argv[++i];
 		} else {
-			stitch_config_id = stitch_id - 34 - 3;
-			stitch_code = 3;
-			anchor_layer_num = config.getStitchConfig(stitch_config_id);
+			cerr << "Usage: " << argv[0] << " --batch <manifest | -> [--output <file | ->] [--binary] [--top-k K]"
+				<< " [--budget-mb <MB>] [--cpus <list>] [--metrics-file <file>]" << endl;
+			return 1;
 		}
-		num_stitchies = config.getNumStitches();
 	}
-	pair<int, int> getAnchorLayerNum() const {
-		return anchor_layer_num;
+	if (!engine_options.cpu_affinity.empty()) {
+		CpuAffinity::pinCurrentThread(engine_options.cpu_affinity);
 	}
-	int getStitchCode() const {
-		return stitch_code;
+	// Stitch ids are not known up front: reserve the largest calibrated peak
+	engine_options.arena_reserve_bytes = ArenaCalibration::load(string("./pretrained/") + arena_calibration_file).getReserveBytes(-1);
+
+	vector<string> labels = ImageHelpers::loadLabels(string("./assets/") + label_name);
+	ifstream manifest_file;
+	if (manifest_path != "-") {
+		manifest_file.open(manifest_path);
+		if (!manifest_file) {
+			cerr << "Failed to open manifest: " << manifest_path << endl;
+			return 1;
+		}
 	}
-	int getNumStitchies() const {
-		return num_stitchies;
+	ofstream output_file;
+	if (output_path != "-") {
+		output_file.open(output_path, batch_options.binary ? ios::binary | ios::trunc : ios::trunc);
+		if (!output_file) {
+			cerr << "Failed to open output: " << output_path << endl;
+			return 1;
+		}
 	}
-};
+	try {
+		InferenceEngine engine(engine_options); // sessions load on first use and stay warm
+		BatchRunner runner(engine, labels, batch_options);
+		BatchSummary summary = runner.run(manifest_path != "-" ? manifest_file : cin, output_path != "-" ? output_file : cout);
+		cerr << summary.requests << " requests, " << summary.failed << " failed, "
+			<< summary.inference_ms / max<size_t>(1, summary.requests - summary.failed) << " ms mean inference" << endl;
+		if (!metrics_file.empty()) {
+			Metrics::global().writeFile(metrics_file);
+		}
+		return summary.failed > 0 ? 2 : 0;
+	} catch (const exception& e) {
+		cerr << "Batch failed: " << e.what() << endl;
+		return -1;
+	}
+}
+
+static InferenceServer* running_server = nullptr;
+
+/* Server mode: snnet-onnx --serve [--unix <path>] [--tcp <port>] [--workers N] [--preload <stitch id>] [--cpus <list>]
+ *                               [--metrics <path>] [--metrics-file <file>] [--max-in-flight N]
+ * Serves the protocol of server_protocol.h until SIGINT or SIGTERM. --max-in-flight caps the requests
+ * in flight per connection (default 32); more pipelined ones wait unread. --metrics serves the Prometheus
+ * metrics on a Unix socket (curl --unix-socket <path> http://localhost/metrics), --metrics-file writes them at exit */
+static int runServer(int argc, char* argv[]) {
+	EngineOptions engine_options;
+	engine_options.ort_cache_dir = "./pretrained/ort_cache/";
+	ServerOptions server_options;
+	string metrics_file;
+	int preload_stitch = -1;
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--unix") == 0 && i + 1 < argc) {
+			server_options.unix_path = argv[++i];
+		} else if (strcmp(argv[i], "--tcp") == 0 && i + 1 < argc) {
+			server_options.tcp_port = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+			server_options.workers = max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--preload") == 0 && i + 1 < argc) {
+			preload_stitch = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc && parseCpus(argv[i + 1], engine_options.cpu_affinity)) {
+			i++;
+		} else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+			server_options.metrics_path = argv[++i];
+		} else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) {
+			metrics_file = argv[++i];
+		} else if (strcmp(argv[i], "--max-in-flight") == 0 && i + 1 < argc) {
+			server_options.max_in_flight = max(1, atoi(argv[++i]));
+		} else {
+			cerr << "Usage: " << argv[0] << " --serve [--unix <path>] [--tcp <port>] [--workers N] [--preload <stitch id>] [--cpus <list>]"
+				<< " [--metrics <path>] [--metrics-file <file>] [--max-in-flight N]" << endl;
+			return 1;
+		}
+	}
+	engine_options.arena_reserve_bytes = ArenaCalibration::load(string("./pretrained/") + arena_calibration_file).getReserveBytes(-1);
+	try {
+		InferenceEngine engine(engine_options);
+		if (preload_stitch >= 0) {
+			engine.preload(StitchPlan(preload_stitch));
+		}
+		InferenceServer server(engine, server_options);
+		running_server = &server;
+		signal(SIGINT, [](int) { running_server->stop(); });
+		signal(SIGTERM, [](int) { running_server->stop(); });
+		cout << "Serving on " << (server_options.unix_path.empty() ? "" : server_options.unix_path + " ")
+			<< (server_options.tcp_port > 0 ? "127.0.0.1:" + to_string(server_options.tcp_port) : "") << endl;
+		server.run();
+		signal(SIGINT, SIG_DFL);
+		signal(SIGTERM, SIG_DFL);
+		running_server = nullptr;
+		ServerStats stats = server.getStats();
+		cout << stats.requests << " requests on " << stats.connections << " connections, " << stats.errors << " errors" << endl;
+		if (!metrics_file.empty()) {
+			Metrics::global().writeFile(metrics_file);
+		}
+		return 0;
+	} catch (const exception& e) {
+		cerr << "Server failed: " << e.what() << endl;
+		return -1;
+	}
+}
 
 int main(int argc, char* argv[]) {
+	if (argc >= 3 && strcmp(argv[1], "--batch") == 0) {
+		return runBatch(argc, argv);
+	}
+	if (argc >= 2 && strcmp(argv[1], "--serve") == 0) {
+		return runServer(argc, argv);
+	}
+
 	/* Setting stitch layer information*/
 	cout << "Setting stitch layer information..." << endl;
-	if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <stitch layer number>" << endl;
+	EngineOptions engine_options;
+	engine_options.ort_cache_dir = "./pretrained/ort_cache/"; // optimized models in ORT format
+	bool lazy_loading = false, measure_sharing = false, calibrate_arena = false, bad_args = (argc < 2);
+	bool prefault = false, lock_hot_set = false, use_numa = false;
+	int check_allocs = 0, pipeline_stages = 0, executor_workers = -1, async_requests = 0;
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--lazy") == 0) {
+			lazy_loading = true;
+		} else if (strcmp(argv[i], "--no-ort-cache") == 0) {
+			engine_options.ort_cache_dir.clear();
+		} else if (strcmp(argv[i], "--measure-sharing") == 0) {
+			measure_sharing = true;
+		} else if (strcmp(argv[i], "--prefault") == 0) {
+			prefault = true;
+		} else if (strcmp(argv[i], "--mlock") == 0) {
+			prefault = lock_hot_set = true;
+		} else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc && parseCpus(argv[i + 1], engine_options.cpu_affinity)) {
+			i++;
+		} else if (strcmp(argv[i], "--numa") == 0) {
+			use_numa = true;
+		} else if (strcmp(argv[i], "--tuning") == 0 && i + 1 < argc) {
+			engine_options.tuning_file = argv[++i];
+			engine_options.shared_thread_pools = false; // tuned settings are per session
+		} else if (strcmp(argv[i], "--throughput") == 0) {
+			engine_options.throughput_mode = true;
+		} else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+			pipeline_stages = max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--executor") == 0 && i + 1 < argc) {
+			executor_workers = max(0, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--async") == 0 && i + 1 < argc) {
+			async_requests = max(1, atoi(argv[++i]));
+			// RunAsync schedules each step on the intra-op pool, which needs a thread besides the caller
+			engine_options.intra_op_threads = max(2, engine_options.intra_op_threads);
+		} else if (strcmp(argv[i], "--calibrate-arena") == 0) {
+			calibrate_arena = true;
+		} else if (strcmp(argv[i], "--check-allocs") == 0 && i + 1 < argc) {
+			check_allocs = max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--budget-mb") == 0 && i + 1 < argc) {
+			engine_options.memory_budget = static_cast<size_t>(atof(argv[++i]) * 1024 * 1024);
+		} else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+			engine_options.streaming = true;
+			engine_options.prefetch_window = max(1, atoi(argv[++i]));
+		} else {
+			bad_args = true;
+		}
+	}
+	if (bad_args) {
+        cerr << "Usage: " << argv[0] << " <stitch layer number> [--lazy] [--no-ort-cache] [--budget-mb <MB>] [--stream <K>] [--measure-sharing]"
+             << " [--calibrate-arena] [--check-allocs <runs>] [--prefault] [--mlock]"
+             << " [--pipeline <stages>] [--executor <workers>] [--async <requests>] [--tuning <file> [--throughput]] [--cpus <list>] [--numa]" << endl;
+        cerr << "   or: " << argv[0] << " --batch <manifest | -> [--output <file | ->] [--binary] [--top-k K]" << endl;
+        cerr << "   or: " << argv[0] << " --serve [--unix <path>] [--tcp <port>] [--workers N] [--preload <stitch id>]" << endl;
         exit(1);
     }
-	
+
+	// Requests run on the calling thread (and its ORT pool threads), so keep it on the chosen CPUs too
+	if (!engine_options.cpu_affinity.empty() && !CpuAffinity::pinCurrentThread(engine_options.cpu_affinity)) {
+		cerr << "Warning: cannot pin to the CPUs given with --cpus" << endl;
+	}
+
 	int stitch_id;
     try {
         stitch_id = stoi(argv[1]);
@@ -77,34 +327,14 @@ int main(int argc, char* argv[]) {
     }
 
     cout << "Stitch layer number: " << stitch_id << endl;
-	StitchLayer stitch_layer(stitch_id);
 
-    /* Initialize ONNX Runtime environment */
-	cout << "Initializing ONNX Runtime..." << endl;
-	Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "ModelInference");
-	Ort::SessionOptions session_options;
-	session_options.SetIntraOpNumThreads(1);
+	// Reserve the peak measured by --calibrate-arena up front, so the shared arena never grows
+	const string calibration_path = string("./pretrained/") + arena_calibration_file;
+	ArenaCalibration arena_calibration = ArenaCalibration::load(calibration_path);
+	engine_options.arena_reserve_bytes = arena_calibration.getReserveBytes(stitch_id);
 
-	const string pretrained_dir = "./pretrained/onnx/";
 	const string assets_dir = "./assets/";
-    string model_path, image_path, label_path;
-    int64_t numInputElements, numOutputElements;
-    int64_t i_width, o_width;
-	vector<const char*> input_node_names, output_node_names;
-
-	vector<int64_t> input_tensor_shape, output_tensor_shape;
-	vector<Ort::Value> input_tensors, output_tensors;
-    vector<float> input_tensor_values;
-    input_tensor_values.reserve(maxNumInputElements);
-    vector<float> output_tensor_values;
-    output_tensor_values.reserve(maxNumOutputElements);
-
-	// Anchor information setting
-	pair<int, int> anchor_num = stitch_layer.getAnchorLayerNum();
-	int frontAnchorNum = anchor_num.first, backAnchorNum = anchor_num.second;
-	int stitchCode = stitch_layer.getStitchCode();
-	int numStitchies = stitch_layer.getNumStitchies();
-	string front_anchor_name, back_anchor_name;
+    string image_path, label_path;
 
 	// load image
 	image_path = assets_dir + image_name;
@@ -122,206 +352,175 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-	try {
-		/* Embed layer execution */
-		input_node_names = { input_node_name_vit_embed };
-		output_node_names = { output_node_name_vit_embed };
-
-		if (stitchCode == 0 || stitchCode == 3) { // tiny only or front tiny
-			i_width = tr_width_t; o_width = tr_width_t;
-			front_anchor_name = vit_types[0];
-			if (stitchCode == 3) back_anchor_name = vit_types[1];
-		} else if (stitchCode == 1 || stitchCode == 4) { // small only or front small
-			i_width = tr_width_s; o_width = tr_width_s;
-			front_anchor_name = vit_types[1];
-			if (stitchCode == 4) back_anchor_name = vit_types[2];
-		} else { // stitchCode == 2 (single base model)
-			i_width = tr_width_b; o_width = tr_width_b;
-			front_anchor_name = vit_types[2];
-		}
-
-		numInputElements  = in_numChannels * in_height * in_width;
-		numOutputElements = tr_height * i_width; // Embed output shape is equal to the input shape of transformer layers
-
-		if (imageVec.size() != numInputElements) {
-			cout << "Invalid image format. Must be 224x224 RGB image." << endl;
-			return 1;
+	if (measure_sharing) {
+		/* Per-session thread pools and prepacked weights vs. process-wide ones */
+		EngineOptions separate = engine_options, shared = engine_options;
+		separate.shared_thread_pools = false, separate.share_prepacked_weights = false;
+		shared.shared_thread_pools = true, shared.share_prepacked_weights = true;
+		SharingSample s_separate = measureInChild(separate, stitch_id, imageVec);
+		SharingSample s_shared = measureInChild(shared, stitch_id, imageVec);
+		if (!s_separate.ok || !s_shared.ok) {
+			cerr << "Sharing measurement failed" << endl;
+			return -1;
 		}
+		cout << "Per-session pools/prepacking: " << s_separate.threads << " threads, " << s_separate.rss_bytes / 1024 << " KB" << endl;
+		cout << "Shared pools/prepacking:      " << s_shared.threads << " threads, " << s_shared.rss_bytes / 1024 << " KB" << endl;
+		cout << "Saved: " << s_separate.threads - s_shared.threads << " threads, "
+			<< (s_separate.rss_bytes - s_shared.rss_bytes) / 1024 << " KB" << endl;
+		return 0;
+	}
 
-		model_path = pretrained_dir + "deit_" + front_anchor_name + "_patch16_224_embed.onnx";
-		cout << "\nLoading ONNX model " + model_path + "..." << endl;
-		Ort::Session onnx_session_embed(env, model_path.c_str(), session_options);
-		Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-		// Set input and output tensor
-		input_tensor_values.assign(numInputElements, 0.5);  // Fill with 0.5 as an example
-		copy(imageVec.begin(), imageVec.end(), input_tensor_values.begin());
-		input_tensor_shape = {1, in_numChannels, in_height, in_width};  // batch size of 1 (input: float32[1,3,224,224])
-		Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
-			memory_info, input_tensor_values.data(), input_tensor_values.size(), input_tensor_shape.data(), input_tensor_shape.size());
-		input_tensors.emplace_back(move(input_tensor));
-
-		output_tensor_values.assign(numOutputElements, 0.0);
-		output_tensor_shape = {1, tr_height, o_width};  // batch size of 1
-		Ort::Value output_tensor = Ort::Value::CreateTensor<float>(
-			memory_info, output_tensor_values.data(), output_tensor_values.size(), output_tensor_shape.data(), output_tensor_shape.size());
-		output_tensors.emplace_back(move(output_tensor));
-
-		// Run inference
-		cout << "Running Embeding Layer inference..." << endl;
-		onnx_session_embed.Run(Ort::RunOptions{ nullptr }, input_node_names.data(), input_tensors.data(), 1, output_node_names.data(), output_tensors.data(), 1);
-
-		/*  ViT layers execution (front anchor) */
-		input_node_names = { input_node_name_vit_layers };
-		output_node_names = { output_node_name_vit_layers };
-
-		numInputElements  = tr_height * i_width;
-		numOutputElements = tr_height * o_width;
-		
-		for (int i = 0; i < frontAnchorNum + 1; i ++) { 
-			// Load model
-			model_path = pretrained_dir + "deit_" + front_anchor_name + "_patch16_224_layer_" + to_string(i) + ".onnx";
-			cout << "\nLoading ONNX model " + model_path + "..." << endl;
-			Ort::Session onnx_session(env, model_path.c_str(), session_options);
-			memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-			copy(output_tensor_values.begin(), output_tensor_values.end(), input_tensor_values.begin());
-			input_tensor_shape = {1, tr_height, i_width};  // batch size of 1		
-			input_tensor = Ort::Value::CreateTensor<float>(
-				memory_info, input_tensor_values.data(), input_tensor_values.size(), input_tensor_shape.data(), input_tensor_shape.size());
-			input_tensors.clear();
-			input_tensors.emplace_back(move(input_tensor));
-
-			// Set output tensor
-			output_tensor_values.clear();
-			output_tensor_values.assign(numOutputElements, 0.0);
-			output_tensor_shape = {1, tr_height, o_width};  // batch size of 1
-			output_tensor = Ort::Value::CreateTensor<float>(
-				memory_info, output_tensor_values.data(), output_tensor_values.size(), output_tensor_shape.data(), output_tensor_shape.size());
-			output_tensors.emplace_back(move(output_tensor));
-
-			// Run inference
-			cout << "Running inference..." << endl;
-			onnx_session.Run(Ort::RunOptions{ nullptr }, input_node_names.data(), input_tensors.data(), 1, output_node_names.data(), output_tensors.data(), 1);
+	vector<float> logits;
+	try {
+		StitchPlan plan(stitch_id);
+
+		if (calibrate_arena) {
+			EngineOptions counting = engine_options;
+			counting.env_allocator = EnvAllocator::Counting;
+			size_t peak_bytes = InferenceEngine(counting).calibrateArena(plan, imageVec.data());
+			arena_calibration.setPeakBytes(stitch_id, peak_bytes);
+			arena_calibration.save(calibration_path);
+			cout << "Peak arena use: " << peak_bytes << " bytes, reserving " << arena_calibration.getReserveBytes(stitch_id)
+				<< " bytes (" << calibration_path << ")" << endl;
+			return 0;
 		}
 
-		/*  Stitch layer execution */
-		input_node_names = { input_node_name_stitch_layers };
-		output_node_names = { output_node_name_stitch_layers };
-
-		bool stitch_flag = true;
-
-		// set model shape based on anchor stitch code  
-		if (stitchCode == 3) { // tiny - small
-			i_width = tr_width_t; o_width = tr_width_s;
-		} else if (stitchCode == 4) { // small - base
-			i_width = tr_width_s; o_width = tr_width_b;
-		} else { // base (stitchCode == 2|| stitchCode == 4) // base only or back base
-			stitch_flag = false;
-		}
-		numInputElements  = tr_height * i_width;
-		numOutputElements = tr_height * o_width;	
-
-		if (stitch_flag) { // if we use a single anchor, skip this phase.
-			model_path = pretrained_dir + "deit_sl_" + to_string(stitch_id) + ".onnx";
-			cout << "\nLoading ONNX model " + model_path + "..." << endl;
-			Ort::Session onnx_session_stitch(env, model_path.c_str(), session_options);
-			memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-			copy(output_tensor_values.begin(), output_tensor_values.end(), input_tensor_values.begin());
-			input_tensor_shape = {1, tr_height, i_width};  // batch size of 1
-			input_tensor = Ort::Value::CreateTensor<float>(
-				memory_info, input_tensor_values.data(), input_tensor_values.size(), input_tensor_shape.data(), input_tensor_shape.size());
-			input_tensors.clear();
-			input_tensors.emplace_back(move(input_tensor));
-
-			// Set output tensor
-			output_tensor_values.assign(numOutputElements, 0.0);
-			output_tensor_shape = {1, tr_height, o_width};  // batch size of 1
-			output_tensor = Ort::Value::CreateTensor<float>(
-				memory_info, output_tensor_values.data(), output_tensor_values.size(), output_tensor_shape.data(), output_tensor_shape.size());
-			output_tensors.clear();
-			output_tensors.emplace_back(move(output_tensor));
-
-			// Run inference
+		if (use_numa) {
+			logits = runOnNumaNodes(engine_options, plan, imageVec, lazy_loading);
+		} else {
+			/* Initialize ONNX Runtime environment */
+			cout << "Initializing ONNX Runtime..." << endl;
+			InferenceEngine engine(engine_options);
+
+			if (!lazy_loading) { // otherwise each model is loaded on first use
+				cout << "\nLoading " << plan.getSteps().size() << " ONNX models in parallel..." << endl;
+				engine.preload(plan);
+			}
+
+			// Activation buffers, prefaulted on creation
+			InferenceContext context;
+			if (prefault) {
+				PinStats pin_stats = engine.pinHotSet(plan, lock_hot_set);
+				cout << "Prefaulted " << pin_stats.prefaulted_bytes / 1024 << " KB of models and weights";
+				if (lock_hot_set) {
+					bool context_locked = context.memory.lock();
+					cout << ", locked " << pin_stats.locked_bytes / 1024 << " KB";
+					if (pin_stats.lock_failed || !context_locked) cout << " (mlock refused, check ulimit -l)";
+				}
+				cout << (context.memory.usesHugeTlb() ? ", activations on explicit huge pages" : "") << endl;
+			}
+
+			/* Embed -> layers -> stitch -> layers -> head execution */
 			cout << "Running inference..." << endl;
-			onnx_session_stitch.Run(Ort::RunOptions{ nullptr }, input_node_names.data(), input_tensors.data(), 1, output_node_names.data(), output_tensors.data(), 1);
+			if (imageVec.size() != static_cast<size_t>(plan.getSteps().front().inputElements())) {
+				throw invalid_argument("Invalid image format. Must be 224x224 RGB image.");
+			}
+			logits.resize(out_numClasses);
+			for (int request = 1; request <= 2; request++) { // the first request pays for whatever was not prefaulted
+				ResourceUsage before = ResourceUsage::current();
+				auto start = chrono::steady_clock::now();
+				engine.run(plan, imageVec.data(), logits.data(), context);
+				double run_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+				ResourceUsage after = ResourceUsage::current();
+				cout << "Request " << request << ": " << run_ms << " ms, " << after.minor_faults - before.minor_faults << " minor / "
+					<< after.major_faults - before.major_faults << " major page faults" << endl;
+			}
+
+			cout << "\nModel load times:" << endl;
+			for (const SessionLoadStats& stats : engine.getSessionCache().getLoadStats()) {
+				cout << "  " << stats.model_name << ": " << stats.load_ms << " ms (" << stats.model_bytes << " bytes)" << endl;
+			}
+			SessionCacheStats cache_stats = engine.getSessionCache().getStats();
+			cout << "Resident sessions: " << cache_stats.resident_sessions << " (" << cache_stats.resident_bytes << " bytes), "
+				<< cache_stats.evictions << " evictions" << endl;
+
+			if (pipeline_stages > 0) {
+				/* A stream of images: one after another vs. through the pipeline */
+				const int stream_length = 64;
+				vector<float> stream_logits(stream_length * out_numClasses);
+				auto start = chrono::steady_clock::now();
+				for (int i = 0; i < stream_length; i++) {
+					engine.run(plan, imageVec.data(), &stream_logits[i * out_numClasses], context);
+				}
+				double sequential_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+				PipelineExecutor pipeline(engine, plan, pipeline_stages);
+				const vector<size_t>& bounds = pipeline.getStageBounds();
+				cout << "\nPipeline stages (steps):";
+				for (size_t i = 0; i + 1 < bounds.size(); i++) cout << " [" << bounds[i] << ", " << bounds[i + 1] << ")";
+				cout << endl;
+				start = chrono::steady_clock::now();
+				for (int i = 0; i < stream_length; i++) {
+					pipeline.submit(imageVec.data(), &stream_logits[i * out_numClasses]);
+				}
+				pipeline.wait();
+				double pipelined_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+				cout << "Sequential: " << stream_length / sequential_s << " images/s, pipelined (" << pipeline.getNumStages()
+					<< " stages): " << stream_length / pipelined_s << " images/s" << endl;
+			}
+
+			if (executor_workers >= 0) {
+				/* A stream of images on the work-stealing executor, one task per step so idle workers steal the rest */
+				const int stream_length = 64;
+				size_t workers = executor_workers > 0 ? executor_workers : RequestExecutor::defaultWorkerCount(engine_options.intra_op_threads);
+				RequestExecutor executor(workers, engine_options.cpu_affinity);
+				vector<InferenceContext> contexts(2 * executor.getNumWorkers()); // requests in flight at once
+				vector<float> stream_logits(stream_length * out_numClasses);
+				atomic<int> failed{ 0 };
+				auto start = chrono::steady_clock::now();
+				for (int first = 0; first < stream_length; first += contexts.size()) {
+					vector<unique_ptr<InferenceTask>> tasks;
+					for (size_t c = 0; c < contexts.size() && first + c < static_cast<size_t>(stream_length); c++) {
+						tasks.push_back(make_unique<InferenceTask>(executor, engine, plan, imageVec.data(),
+							&stream_logits[(first + c) * out_numClasses], contexts[c],
+							[&failed](exception_ptr error) { if (error) failed++; }, true));
+						executor.submit(tasks.back().get());
+					}
+					executor.waitIdle();
+				}
+				double executor_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+				cout << "\nExecutor (" << executor.getNumWorkers() << " workers): " << stream_length / executor_s << " images/s, "
+					<< executor.getStealCount() << " steals" << (failed > 0 ? ", " + to_string(failed.load()) + " failed" : "") << endl;
+			}
+
+			if (async_requests > 0) {
+				/* Requests in flight at once from this one thread, steps chained by RunAsync callbacks */
+				vector<future<vector<float>>> results;
+				auto start = chrono::steady_clock::now();
+				for (int i = 0; i < async_requests; i++) {
+					results.push_back(engine.submit(imageVec, stitch_id));
+				}
+				double submit_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+				for (auto& result : results) {
+					result.get();
+				}
+				double async_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+				cout << "\nAsync: " << async_requests << " requests submitted in " << submit_ms << " ms, "
+					<< async_requests / async_s << " images/s" << endl;
+			}
+
+			if (check_allocs > 0) {
+				/* Steady state: with the arena reserved, runs must not grow it. ORT's Run still does
+				 * small bookkeeping mallocs of its own, reported as information */
+				if (!AllocCounter::enabled()) {
+					cerr << "--check-allocs needs a build with -DSNNET_DEBUG_ALLOC_COUNT=ON" << endl;
+					return 1;
+				}
+				vector<float> check_logits(out_numClasses);
+				uint64_t before = AllocCounter::count(), aligned_before = AllocCounter::alignedCount();
+				for (int i = 0; i < check_allocs; i++) {
+					engine.run(plan, imageVec.data(), check_logits.data(), context);
+				}
+				uint64_t allocations = AllocCounter::count() - before;
+				uint64_t aligned = AllocCounter::alignedCount() - aligned_before;
+				cout << "Aligned (arena) allocations in " << check_allocs << " steady-state runs: " << aligned << endl;
+				cout << "Other heap allocations per run: " << static_cast<double>(allocations - aligned) / check_allocs << endl;
+				if (aligned != 0) {
+					cerr << "Allocation check failed: the arena grew while running (recalibrate with --calibrate-arena)" << endl;
+					return 1;
+				}
+			}
 		}
-
-		/*  ViT layers execution (back anchor) */
-		input_node_names = { input_node_name_vit_layers };
-		output_node_names = { output_node_name_vit_layers };
-		
-		// set model shape based on anchor stitch code  
-		if (stitchCode == 0) { // tiny only
-			i_width = tr_width_t; o_width = tr_width_t;
-		} else if (stitchCode == 1 || stitchCode == 3) { // small only or back small
-			i_width = tr_width_s; o_width = tr_width_s;
-		} else { // base (stitchCode == 2|| stitchCode == 4) // base only or back base
-			i_width = tr_width_b; o_width = tr_width_b;
-		}
-		numInputElements  = tr_height * i_width;
-		numOutputElements = tr_height * o_width;	
-
-		for (int i = backAnchorNum; i < numStitchies; i ++) {
-			// Load model
-			model_path = pretrained_dir + "deit_" + back_anchor_name + "_patch16_224_layer_" + to_string(i) + ".onnx";
-			cout << "\nLoading ONNX model " + model_path + "..." << endl;
-			Ort::Session onnx_session(env, model_path.c_str(), session_options);
-			memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-			input_tensor_values.assign(numInputElements, 0.0);
-			copy(output_tensor_values.begin(), output_tensor_values.end(), input_tensor_values.begin());
-			input_tensor_shape = {1, tr_height, i_width};  // batch size of 1
-			input_tensor = Ort::Value::CreateTensor<float>(
-				memory_info, input_tensor_values.data(), input_tensor_values.size(), input_tensor_shape.data(), input_tensor_shape.size());
-			input_tensors.clear();
-			input_tensors.emplace_back(move(input_tensor));
-
-			// Set output tensor
-			output_tensor_values.assign(numOutputElements, 0.0);
-			output_tensor_shape = {1, tr_height, o_width};  // batch size of 1
-			output_tensor = Ort::Value::CreateTensor<float>(
-				memory_info, output_tensor_values.data(), output_tensor_values.size(), output_tensor_shape.data(), output_tensor_shape.size());
-			output_tensors.clear();
-			output_tensors.emplace_back(move(output_tensor));
-			
-			// Run inference
-			cout << "Running inference..." << endl;
-			onnx_session.Run(Ort::RunOptions{ nullptr }, input_node_names.data(), input_tensors.data(), 1, output_node_names.data(), output_tensors.data(), 1);
-		}		
-
-		/*  Head layer execution */
-		input_node_names = { input_node_name_vit_head };
-		output_node_names = { output_node_name_vit_head };
-		
-		numInputElements  = tr_height * o_width;
-		numOutputElements = out_numClasses;
-		
-		model_path = pretrained_dir + "deit_" + back_anchor_name + "_patch16_224_head.onnx";
-		cout << "\nLoading ONNX model " + model_path + "..." << endl;
-		Ort::Session onnx_session_head(env, model_path.c_str(), session_options);
-		memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-		copy(output_tensor_values.begin(), output_tensor_values.end(), input_tensor_values.begin());
-		input_tensor_shape = {1, tr_height, o_width};  // batch size of 1
-		input_tensor = Ort::Value::CreateTensor<float>(
-			memory_info, input_tensor_values.data(), input_tensor_values.size(), input_tensor_shape.data(), input_tensor_shape.size());
-		input_tensors.clear();
-		input_tensors.emplace_back(move(input_tensor));
-
-		// Set output tensor
-		output_tensor_values.assign(numOutputElements, 0.0);
-		output_tensor_shape = {1, out_numClasses};  // batch size of 1
-		output_tensor = Ort::Value::CreateTensor<float>(
-			memory_info, output_tensor_values.data(), output_tensor_values.size(), output_tensor_shape.data(), output_tensor_shape.size());
-		output_tensors.clear();
-		output_tensors.emplace_back(move(output_tensor));
-
-		// Run inference
-		cout << "Running inference..." << endl;
-		onnx_session_head.Run(Ort::RunOptions{ nullptr }, input_node_names.data(), input_tensors.data(), 1, output_node_names.data(), output_tensors.data(), 1);
-
 	} catch (const Ort::Exception& e) {
         cerr << "ONNX Runtime Error: " << e.what() << endl;
         return -1;
@@ -334,10 +533,9 @@ int main(int argc, char* argv[]) {
     }
 
 	/* Processing the result */
-	float* floatarr = output_tensors.front().GetTensorMutableData<float>();
-	int predicted_class = distance(floatarr, max_element(floatarr, floatarr + out_numClasses));
+	int predicted_class = Logits::argmax(logits.data(), logits.size());
 
-	if (predicted_class < labels.size()) {
+	if (predicted_class < static_cast<int>(labels.size())) {
         cout << "Predicted label is: " << labels[predicted_class] << endl;
     } else {
         cout << "Invalid predicted class index!" << endl;
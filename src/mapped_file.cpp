@@ -0,0 +1,122 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "huge_pages.h"
+
+namespace {
+
+// Maps the file at a huge page aligned address, the precondition for the kernel to
+// back read-only file pages with huge pages (CONFIG_READ_ONLY_THP_FOR_FS).
+void* mapFile(int fd, size_t length) {
+    if (length < huge_page_size) {
+        return mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    size_t reserved = length + huge_page_size;
+    void* r = mmap(nullptr, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r == MAP_FAILED) {
+        return MAP_FAILED;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(r);
+    uintptr_t aligned = (start + huge_page_size - 1) & ~(huge_page_size - 1);
+    void* p = mmap(reinterpret_cast<void*>(aligned), length, PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0);
+    if (p == MAP_FAILED) {
+        munmap(r, reserved);
+        return MAP_FAILED;
+    }
+    // Give back the unused reservation on both sides
+    if (aligned > start) {
+        munmap(r, aligned - start);
+    }
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t end = (aligned + length + page - 1) & ~(page - 1);
+    if (start + reserved > end) {
+        munmap(reinterpret_cast<void*>(end), start + reserved - end);
+    }
+    PageResidency::adviseHugePages(p, length);
+    return p;
+}
+
+} // namespace
+
+MappedFile::MappedFile() : addr(nullptr), length(0) {}
+
+MappedFile::MappedFile(const std::string& file_path) : addr(nullptr), length(0) {
+    open(file_path);
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : path(std::move(other.path)), addr(other.addr), length(other.length) {
+    other.addr = nullptr;
+    other.length = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        path = std::move(other.path);
+        addr = other.addr;
+        length = other.length;
+        other.addr = nullptr;
+        other.length = 0;
+    }
+    return *this;
+}
+
+void MappedFile::open(const std::string& file_path) {
+    release();
+
+    int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + file_path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat or empty file " + file_path);
+    }
+
+    void* p = mapFile(fd, static_cast<size_t>(st.st_size));
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("Cannot mmap " + file_path);
+    }
+
+    path = file_path;
+    addr = static_cast<uint8_t*>(p);
+    length = static_cast<size_t>(st.st_size);
+}
+
+size_t MappedFile::prefault(size_t offset, size_t bytes) const {
+    if (offset >= length) {
+        return 0;
+    }
+    return PageResidency::prefault(addr + offset, std::min(bytes, length - offset));
+}
+
+bool MappedFile::lock(size_t offset, size_t bytes) const {
+    if (offset >= length) {
+        return true;
+    }
+    return PageResidency::lock(addr + offset, std::min(bytes, length - offset));
+}
+
+void MappedFile::release() {
+    if (addr != nullptr) {
+        munmap(addr, length);
+        addr = nullptr;
+        length = 0;
+    }
+}
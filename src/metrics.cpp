@@ -0,0 +1,209 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "stitch_plan.h"
+
+namespace {
+
+// Upper bounds of the exported Prometheus buckets, in microseconds
+const uint64_t exported_bounds_us[] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 10000000,
+};
+
+std::string seconds(uint64_t us) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.6f", us / 1e6);
+    return text;
+}
+
+void writeHistogram(std::ostream& out, const char* name, const std::string& labels, const LatencyHistogram& histogram) {
+    LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+    if (snapshot.count == 0) {
+        return;
+    }
+    const std::string separator = labels.empty() ? "" : ",";
+    for (uint64_t bound : exported_bounds_us) {
+        out << name << "_bucket{" << labels << separator << "le=\"" << seconds(bound) << "\"} " << snapshot.countAtMost(bound) << "\n";
+    }
+    out << name << "_bucket{" << labels << separator << "le=\"+Inf\"} " << snapshot.count << "\n";
+    const std::string braces = labels.empty() ? "" : "{" + labels + "}";
+    out << name << "_sum" << braces << " " << seconds(snapshot.sum_us) << "\n";
+    out << name << "_count" << braces << " " << snapshot.count << "\n";
+}
+
+void writeHeader(std::ostream& out, const char* name, const char* type, const char* help) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+void writeCounter(std::ostream& out, const char* name, const char* help, uint64_t value) {
+    writeHeader(out, name, "counter", help);
+    out << name << " " << value << "\n";
+}
+
+} // namespace
+
+size_t LatencyHistogram::bucketOf(uint64_t value_us) {
+    constexpr uint64_t sub_buckets = uint64_t(1) << sub_bucket_bits;
+    if (value_us < sub_buckets) {
+        return value_us;
+    }
+    const int exponent = 63 - __builtin_clzll(value_us);
+    if (exponent > max_exponent) {
+        return num_buckets - 1;
+    }
+    // The sub_bucket_bits bits below the leading one pick the linear sub-bucket
+    const uint64_t sub_bucket = (value_us >> (exponent - sub_bucket_bits)) - sub_buckets;
+    return ((exponent - sub_bucket_bits + 1) << sub_bucket_bits) + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t bucket) {
+    constexpr uint64_t sub_buckets = uint64_t(1) << sub_bucket_bits;
+    if (bucket < sub_buckets) {
+        return bucket;
+    }
+    const int exponent = static_cast<int>(bucket >> sub_bucket_bits) + sub_bucket_bits - 1;
+    const uint64_t sub_bucket = bucket & (sub_buckets - 1);
+    return ((sub_buckets + sub_bucket + 1) << (exponent - sub_bucket_bits)) - 1;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snapshot;
+    snapshot.buckets.resize(num_buckets);
+    // The count is summed from the buckets, so it matches them even while others record
+    for (size_t b = 0; b < num_buckets; ++b) {
+        snapshot.buckets[b] = buckets[b].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[b];
+    }
+    snapshot.sum_us = sum_us.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+uint64_t LatencyHistogram::Snapshot::countAtMost(uint64_t limit_us) const {
+    uint64_t n = 0;
+    for (size_t b = 0; b < buckets.size() && bucketUpperBound(b) <= limit_us; ++b) {
+        n += buckets[b];
+    }
+    return n;
+}
+
+uint64_t LatencyHistogram::Snapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return bucketUpperBound(b);
+        }
+    }
+    return bucketUpperBound(buckets.size() - 1);
+}
+
+Metrics::Metrics()
+    : steps(new LatencyHistogram[num_stitch_ids * max_plan_steps]), requests(new LatencyHistogram[num_stitch_ids]) {}
+
+Metrics& Metrics::global() {
+    static Metrics* metrics = new Metrics();
+    return *metrics;
+}
+
+bool Metrics::valid(int stitch_id) {
+    return stitch_id >= 0 && stitch_id < num_stitch_ids;
+}
+
+void Metrics::recordStep(int stitch_id, size_t step, uint64_t latency_us) {
+    if (valid(stitch_id) && step < max_plan_steps) {
+        steps[stitch_id * max_plan_steps + step].record(latency_us);
+    }
+}
+
+void Metrics::recordRequest(int stitch_id, uint64_t latency_us) {
+    if (valid(stitch_id)) {
+        requests[stitch_id].record(latency_us);
+    }
+}
+
+const LatencyHistogram& Metrics::getStepHistogram(int stitch_id, size_t step) const {
+    if (!valid(stitch_id) || step >= max_plan_steps) {
+        throw std::out_of_range("No plan step " + std::to_string(step) + " for stitch id " + std::to_string(stitch_id));
+    }
+    return steps[stitch_id * max_plan_steps + step];
+}
+
+const LatencyHistogram& Metrics::getRequestHistogram(int stitch_id) const {
+    if (!valid(stitch_id)) {
+        throw std::out_of_range("Invalid stitch id " + std::to_string(stitch_id));
+    }
+    return requests[stitch_id];
+}
+
+void Metrics::writePrometheus(std::ostream& out) const {
+    uint64_t num_requests = 0;
+    for (int s_id = 0; s_id < num_stitch_ids; ++s_id) {
+        num_requests += requests[s_id].getCount();
+    }
+    writeCounter(out, "snnet_requests_total", "Inference requests completed", num_requests);
+    writeCounter(out, "snnet_request_errors_total", "Inference requests failed", request_errors.load(std::memory_order_relaxed));
+    writeCounter(out, "snnet_batches_total", "Batches run", batches.load(std::memory_order_relaxed));
+    writeCounter(out, "snnet_batch_images_total", "Images in batches", batch_images.load(std::memory_order_relaxed));
+    writeCounter(out, "snnet_session_cache_hits_total", "Session cache lookups served by a resident session", cache_hits.load(std::memory_order_relaxed));
+    writeCounter(out, "snnet_session_evictions_total", "Sessions evicted from the cache", evictions.load(std::memory_order_relaxed));
+
+    writeHeader(out, "snnet_session_loads_total", "counter", "Sessions created, on demand or by prefetching");
+    out << "snnet_session_loads_total{reason=\"demand\"} " << demand_loads.load(std::memory_order_relaxed) << "\n";
+    out << "snnet_session_loads_total{reason=\"prefetch\"} " << prefetch_loads.load(std::memory_order_relaxed) << "\n";
+
+    writeHeader(out, "snnet_session_load_seconds", "histogram", "Session creation time");
+    writeHistogram(out, "snnet_session_load_seconds", "", session_loads);
+
+    writeHeader(out, "snnet_request_latency_seconds", "histogram", "Inference time of a whole plan, by stitch id");
+    for (int s_id = 0; s_id < num_stitch_ids; ++s_id) {
+        writeHistogram(out, "snnet_request_latency_seconds", "stitch_id=\"" + std::to_string(s_id) + "\"", requests[s_id]);
+    }
+
+    writeHeader(out, "snnet_step_latency_seconds", "histogram", "Time of one plan step, session lookup and Run, by stitch id and step");
+    for (int s_id = 0; s_id < num_stitch_ids; ++s_id) {
+        const LatencyHistogram* row = &steps[s_id * max_plan_steps];
+        bool used = false;
+        for (size_t step = 0; step < max_plan_steps && !used; ++step) used = row[step].getCount() > 0;
+        if (!used) {
+            continue;
+        }
+        const StitchPlan plan(s_id);
+        const std::vector<PlanStep>& plan_steps = plan.getSteps();
+        for (size_t step = 0; step < plan_steps.size() && step < max_plan_steps; ++step) {
+            std::ostringstream labels;
+            labels << "stitch_id=\"" << s_id << "\",step=\"" << step << "\",kind=\"" << PlanStep::kindName(plan_steps[step].kind)
+                   << "\",width=\"" << StitchPlan::modelWidth(plan_steps[step].model_name) << "\"";
+            writeHistogram(out, "snnet_step_latency_seconds", labels.str(), row[step]);
+        }
+    }
+}
+
+std::string Metrics::prometheusText() const {
+    std::ostringstream out;
+    writePrometheus(out);
+    return out.str();
+}
+
+void Metrics::writeFile(const std::string& path) const {
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        writePrometheus(file);
+        if (!file.flush()) {
+            throw std::runtime_error("Cannot write " + temporary);
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Cannot rename " + temporary + " to " + path);
+    }
+}
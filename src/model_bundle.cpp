@@ -0,0 +1,136 @@
+#include "model_bundle.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+template <typename T>
+void appendPod(std::string& out, const T& v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+T readPod(const uint8_t*& p, const uint8_t* end) {
+    if (static_cast<size_t>(end - p) < sizeof(T)) throw std::runtime_error("Truncated model bundle table of contents");
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+}
+
+} // namespace
+
+uint64_t ModelBundle::checksum(const uint8_t* data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a 64
+    for (size_t i = 0; i < size; ++i) {
+        h ^= data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+ModelBundleWriter::ModelBundleWriter(const std::string& bundle_path)
+    : out(bundle_path, std::ios::binary | std::ios::trunc), path(bundle_path), offset(0), model_count(0) {
+    if (!out) {
+        throw std::runtime_error("Cannot create " + bundle_path);
+    }
+    // header is written by finish(), models start on the second page
+    std::string zeros(model_bundle_page, '\0');
+    out.write(zeros.data(), zeros.size());
+    offset = model_bundle_page;
+}
+
+void ModelBundleWriter::addModel(const std::string& model_name, const std::string& model) {
+    uint64_t aligned = (offset + model_bundle_page - 1) / model_bundle_page * model_bundle_page;
+    std::string zeros(aligned - offset, '\0');
+    out.write(zeros.data(), zeros.size());
+    offset = aligned;
+
+    out.write(model.data(), model.size());
+    if (!out) {
+        throw std::runtime_error("Write error while bundling " + model_name);
+    }
+
+    appendPod(toc, static_cast<uint32_t>(model_name.size()));
+    toc += model_name;
+    appendPod(toc, offset);
+    appendPod(toc, static_cast<uint64_t>(model.size()));
+    appendPod(toc, ModelBundle::checksum(reinterpret_cast<const uint8_t*>(model.data()), model.size()));
+    offset += model.size();
+    ++model_count;
+}
+
+uint64_t ModelBundleWriter::finish() {
+    ModelBundleHeader header{};
+    std::memcpy(header.magic, "SNMB", 4);
+    header.version = 1;
+    header.model_count = model_count;
+    header.toc_offset = offset;
+    header.toc_size = toc.size();
+
+    out.write(toc.data(), toc.size());
+    offset += toc.size();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Write error while finishing " + path);
+    }
+    return offset;
+}
+
+ModelBundle::ModelBundle(const std::string& bundle_path) : file(bundle_path) {
+    ModelBundleHeader header;
+    if (file.size() < sizeof(header)) {
+        throw std::runtime_error("Invalid model bundle " + bundle_path);
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, "SNMB", 4) != 0 || header.version != 1 ||
+        header.toc_offset + header.toc_size > file.size()) {
+        throw std::runtime_error("Invalid model bundle " + bundle_path);
+    }
+
+    const uint8_t* p = file.data() + header.toc_offset;
+    const uint8_t* end = p + header.toc_size;
+    for (uint32_t i = 0; i < header.model_count; ++i) {
+        uint32_t len = readPod<uint32_t>(p, end);
+        if (static_cast<size_t>(end - p) < len) throw std::runtime_error("Truncated model bundle table of contents");
+        std::string name(reinterpret_cast<const char*>(p), len);
+        p += len;
+
+        Entry entry;
+        entry.offset = readPod<uint64_t>(p, end);
+        entry.size = readPod<uint64_t>(p, end);
+        entry.checksum = readPod<uint64_t>(p, end);
+        entry.verified = std::make_unique<std::atomic<bool>>(false);
+        if (entry.offset + entry.size > header.toc_offset) {
+            throw std::runtime_error("Model bundle entry out of range: " + name);
+        }
+        entries.emplace(std::move(name), std::move(entry));
+    }
+}
+
+std::pair<const uint8_t*, size_t> ModelBundle::getModel(const std::string& model_name) const {
+    auto it = entries.find(model_name);
+    if (it == entries.end()) {
+        throw std::runtime_error("Model not in bundle: " + model_name);
+    }
+    const Entry& entry = it->second;
+    const uint8_t* data = file.data() + entry.offset;
+    if (!entry.verified->load(std::memory_order_acquire)) {
+        if (checksum(data, entry.size) != entry.checksum) {
+            throw std::runtime_error("Checksum mismatch in model bundle: " + model_name);
+        }
+        entry.verified->store(true, std::memory_order_release);
+    }
+    return { data, static_cast<size_t>(entry.size) };
+}
+
+std::vector<std::string> ModelBundle::getModelNames() const {
+    std::vector<std::string> names;
+    for (const auto& entry : entries) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
@@ -0,0 +1,95 @@
+#include "numa_engine.h"
+
+#include <algorithm>
+#include <exception>
+#include <map>
+#include <thread>
+
+namespace {
+
+// Runs `work` on a new thread restricted to `cpus`; threads it starts inherit the restriction.
+template <typename Work>
+void runOnCpus(const std::vector<int>& cpus, Work&& work, std::exception_ptr& error) {
+    std::thread([&] {
+        CpuAffinity::pinCurrentThread(cpus);
+        try {
+            work();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }).join();
+}
+
+} // namespace
+
+NumaEngine::NumaEngine(const EngineOptions& options, const NumaTopology& t) : topology(t) {
+    for (const NumaNode& node : topology.getNodes()) {
+        auto replica = std::make_unique<Replica>();
+        replica->node = node;
+
+        EngineOptions node_options = options;
+        node_options.cpu_affinity = node.cpus;
+        node_options.numa_node = node.id;
+        node_options.intra_op_threads = std::min<int>(options.intra_op_threads, static_cast<int>(node.cpus.size()));
+        node_options.shared_thread_pools = false;
+        node_options.env_allocator = EnvAllocator::None;
+
+        std::exception_ptr error;
+        runOnCpus(node.cpus, [&] { replica->engine = std::make_unique<InferenceEngine>(node_options); }, error);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        replicas.push_back(std::move(replica));
+    }
+}
+
+void NumaEngine::preload(const StitchPlan& plan) {
+    std::vector<std::thread> loaders;
+    std::vector<std::exception_ptr> errors(replicas.size());
+    for (size_t i = 0; i < replicas.size(); ++i) {
+        loaders.emplace_back([this, &plan, &errors, i] {
+            Replica& replica = *replicas[i];
+            runOnCpus(replica.node.cpus, [&] { replica.engine->preload(plan); }, errors[i]);
+        });
+    }
+    for (std::thread& t : loaders) {
+        t.join();
+    }
+    for (std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+size_t NumaEngine::route() const {
+    const int node = topology.nodeOfCpu(CpuAffinity::currentCpu());
+    for (size_t i = 0; i < replicas.size(); ++i) {
+        if (replicas[i]->node.id == node) return i;
+    }
+    return 0;
+}
+
+size_t NumaEngine::run(const StitchPlan& plan, const float* image, float* logits) {
+    const size_t index = route();
+    Replica& replica = *replicas[index];
+    ++replica.requests;
+
+    // Stay on the node for the whole request, then give the caller its CPUs back
+    std::vector<int> caller_cpus = CpuAffinity::currentThread();
+    CpuAffinity::pinCurrentThread(replica.node.cpus);
+
+    // Activation buffers per caller thread and node, allocated on the node
+    thread_local std::map<int, std::unique_ptr<InferenceContext>> contexts;
+    std::unique_ptr<InferenceContext>& context = contexts[replica.node.id];
+    if (!context) {
+        context = std::make_unique<InferenceContext>(replica.node.id);
+    }
+
+    try {
+        replica.engine->run(plan, image, logits, *context);
+    } catch (...) {
+        CpuAffinity::pinCurrentThread(caller_cpus);
+        throw;
+    }
+    CpuAffinity::pinCurrentThread(caller_cpus);
+    return index;
+}
@@ -0,0 +1,111 @@
+#include "numa_topology.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+NumaTopology NumaTopology::detect(const std::string& sys_node_dir) {
+    NumaTopology topology;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(sys_node_dir, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+            !std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        std::ifstream file(entry.path() / "cpulist");
+        std::string list;
+        getline(file, list);
+        NumaNode node{ std::stoi(name.substr(4)), parseCpuList(list) };
+        if (!node.cpus.empty()) { // memory-only nodes run nothing
+            topology.nodes.push_back(std::move(node));
+        }
+    }
+    std::sort(topology.nodes.begin(), topology.nodes.end(), [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+
+    if (topology.nodes.empty()) {
+        NumaNode node{ 0, {} };
+        for (int cpu = 0; cpu < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++cpu) {
+            node.cpus.push_back(cpu);
+        }
+        topology.nodes.push_back(std::move(node));
+    }
+    return topology;
+}
+
+std::vector<int> NumaTopology::parseCpuList(const std::string& list) {
+    const auto bad = [&list](const std::string& token, const std::string& why) {
+        return std::invalid_argument("Bad list entry \"" + token + "\" in \"" + list + "\": " + why);
+    };
+    // Non-negative decimal number filling all of `text`
+    const auto number = [&](const std::string& text, const std::string& token) {
+        if (text.empty() || text.size() > 9 || !std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            throw bad(token, "expected N or A-B");
+        }
+        return std::stoi(text);
+    };
+
+    std::vector<int> cpus;
+    std::istringstream ranges(list);
+    std::string token;
+    while (getline(ranges, token, ',')) {
+        const size_t begin = token.find_first_not_of(" \t\n");
+        if (begin == std::string::npos) {
+            continue; // empty, e.g. the cpulist of a memory-only node
+        }
+        token = token.substr(begin, token.find_last_not_of(" \t\n") + 1 - begin);
+        const size_t dash = token.find('-');
+        const int first = number(token.substr(0, dash), token);
+        const int last = dash == std::string::npos ? first : number(token.substr(dash + 1), token);
+        if (last < first) {
+            throw bad(token, "reversed range");
+        }
+        if (static_cast<size_t>(last - first) + 1 > max_list_size - cpus.size()) {
+            throw bad(token, "more than " + std::to_string(max_list_size) + " entries");
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+int NumaTopology::nodeOfCpu(int cpu) const {
+    for (const NumaNode& node : nodes) {
+        if (std::find(node.cpus.begin(), node.cpus.end(), cpu) != node.cpus.end()) {
+            return node.id;
+        }
+    }
+    return 0;
+}
+
+bool CpuAffinity::pinCurrentThread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+std::vector<int> CpuAffinity::currentThread() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+int CpuAffinity::currentCpu() {
+    return sched_getcpu();
+}
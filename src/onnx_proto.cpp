@@ -0,0 +1,315 @@
+#include "onnx_proto.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+/* onnx.proto field numbers */
+constexpr uint32_t model_graph = 7;
+constexpr uint32_t graph_initializer = 5;
+constexpr uint32_t tensor_dims = 1;
+constexpr uint32_t tensor_data_type = 2;
+constexpr uint32_t tensor_float_data = 4;
+constexpr uint32_t tensor_int32_data = 5;
+constexpr uint32_t tensor_int64_data = 7;
+constexpr uint32_t tensor_name = 8;
+constexpr uint32_t tensor_raw_data = 9;
+constexpr uint32_t tensor_double_data = 10;
+constexpr uint32_t tensor_uint64_data = 11;
+constexpr uint32_t tensor_external_data = 13;
+constexpr uint32_t tensor_data_location = 14;
+constexpr uint32_t entry_key = 1;
+constexpr uint32_t entry_value = 2;
+constexpr uint64_t location_external = 1;
+
+/* protobuf wire types */
+constexpr uint32_t wire_varint = 0;
+constexpr uint32_t wire_fixed64 = 1;
+constexpr uint32_t wire_bytes = 2;
+constexpr uint32_t wire_fixed32 = 5;
+
+struct Field {
+    uint32_t number;
+    uint32_t wire_type;
+    uint64_t value;         // varint / fixed value
+    const uint8_t* data;    // length-delimited payload
+    size_t size;
+    const uint8_t* begin;   // whole field including the tag, for verbatim copies
+    const uint8_t* end;
+};
+
+class Reader {
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+
+public:
+    Reader(const uint8_t* data, size_t size) : p(data), end(data + size) {}
+
+    bool done() const {
+        return p >= end;
+    }
+
+    uint64_t readVarint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) throw std::runtime_error("Truncated varint in ONNX model");
+            uint8_t b = *p++;
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) return v;
+        }
+        throw std::runtime_error("Malformed varint in ONNX model");
+    }
+
+    Field next() {
+        Field f{};
+        f.begin = p;
+        uint64_t tag = readVarint();
+        f.number = static_cast<uint32_t>(tag >> 3);
+        f.wire_type = static_cast<uint32_t>(tag & 7);
+        switch (f.wire_type) {
+        case wire_varint:
+            f.value = readVarint();
+            break;
+        case wire_fixed64:
+            if (end - p < 8) throw std::runtime_error("Truncated fixed64 in ONNX model");
+            std::memcpy(&f.value, p, 8);
+            p += 8;
+            break;
+        case wire_bytes: {
+            uint64_t len = readVarint();
+            if (len > static_cast<uint64_t>(end - p)) throw std::runtime_error("Truncated field in ONNX model");
+            f.data = p;
+            f.size = static_cast<size_t>(len);
+            p += len;
+            break;
+        }
+        case wire_fixed32: {
+            if (end - p < 4) throw std::runtime_error("Truncated fixed32 in ONNX model");
+            uint32_t v;
+            std::memcpy(&v, p, 4);
+            f.value = v;
+            p += 4;
+            break;
+        }
+        default:
+            throw std::runtime_error("Unsupported protobuf wire type in ONNX model");
+        }
+        f.end = p;
+        return f;
+    }
+};
+
+void writeVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+void writeTag(std::string& out, uint32_t number, uint32_t wire_type) {
+    writeVarint(out, (static_cast<uint64_t>(number) << 3) | wire_type);
+}
+
+void writeBytes(std::string& out, uint32_t number, const void* data, size_t size) {
+    writeTag(out, number, wire_bytes);
+    writeVarint(out, size);
+    out.append(static_cast<const char*>(data), size);
+}
+
+void writeBytes(std::string& out, uint32_t number, const std::string& s) {
+    writeBytes(out, number, s.data(), s.size());
+}
+
+void appendLittleEndian(std::string& out, uint64_t v, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        out.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+    }
+}
+
+// Appends the values of a repeated scalar field, packed or not, in raw_data layout.
+void appendRepeated(std::string& out, const Field& f, size_t elem_size, bool fixed) {
+    if (f.wire_type != wire_bytes) {
+        appendLittleEndian(out, f.value, elem_size);
+        return;
+    }
+    if (fixed) { // packed float/double are already little-endian
+        out.append(reinterpret_cast<const char*>(f.data), f.size);
+        return;
+    }
+    Reader packed(f.data, f.size);
+    while (!packed.done()) {
+        appendLittleEndian(out, packed.readVarint(), elem_size);
+    }
+}
+
+// Decodes a TensorProto. Returns false if the tensor has no inline data we can externalize.
+bool decodeTensor(const uint8_t* data, size_t size, OnnxInitializer& tensor) {
+    Reader r(data, size);
+    bool external = false, has_strings = false;
+    std::string raw, typed;
+    while (!r.done()) {
+        Field f = r.next();
+        switch (f.number) {
+        case tensor_dims:
+            if (f.wire_type == wire_bytes) {
+                Reader packed(f.data, f.size);
+                while (!packed.done()) tensor.dims.push_back(static_cast<int64_t>(packed.readVarint()));
+            } else {
+                tensor.dims.push_back(static_cast<int64_t>(f.value));
+            }
+            break;
+        case tensor_data_type:
+            tensor.data_type = static_cast<int32_t>(f.value);
+            break;
+        case tensor_name:
+            tensor.name.assign(reinterpret_cast<const char*>(f.data), f.size);
+            break;
+        case tensor_raw_data:
+            raw.assign(reinterpret_cast<const char*>(f.data), f.size);
+            break;
+        case tensor_float_data:
+            appendRepeated(typed, f, 4, true);
+            break;
+        case tensor_double_data:
+            appendRepeated(typed, f, 8, true);
+            break;
+        case tensor_int32_data:
+        case tensor_int64_data:
+        case tensor_uint64_data:
+            // element size depends on data_type, which may come later; store as 8-byte values first
+            appendRepeated(typed, f, 8, false);
+            break;
+        case tensor_data_location:
+            external = (f.value == location_external);
+            break;
+        case 6: // string_data
+            has_strings = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    size_t elem_size = OnnxProto::elementSize(tensor.data_type);
+    if (external || has_strings || elem_size == 0) return false;
+
+    if (!raw.empty()) {
+        tensor.data = std::move(raw);
+    } else if (elem_size == 4 && tensor.data_type == 1) { // FLOAT from float_data
+        tensor.data = std::move(typed);
+    } else if (tensor.data_type == 11) { // DOUBLE from double_data
+        tensor.data = std::move(typed);
+    } else { // integer types widened to 8 bytes above; narrow to the real element size
+        for (size_t i = 0; i + 8 <= typed.size(); i += 8) {
+            tensor.data.append(typed, i, elem_size);
+        }
+    }
+
+    size_t count = 1;
+    for (int64_t d : tensor.dims) count *= static_cast<size_t>(d);
+    return tensor.data.size() == count * elem_size;
+}
+
+std::string encodeExternalTensor(const OnnxInitializer& tensor, const OnnxExternalData& ext) {
+    std::string out;
+    for (int64_t d : tensor.dims) {
+        writeTag(out, tensor_dims, wire_varint);
+        writeVarint(out, static_cast<uint64_t>(d));
+    }
+    writeTag(out, tensor_data_type, wire_varint);
+    writeVarint(out, static_cast<uint64_t>(tensor.data_type));
+    writeBytes(out, tensor_name, tensor.name);
+
+    const std::pair<const char*, std::string> entries[] = {
+        {"location", ext.location},
+        {"offset", std::to_string(ext.offset)},
+        {"length", std::to_string(ext.length)},
+    };
+    for (const auto& e : entries) {
+        std::string entry;
+        writeBytes(entry, entry_key, e.first, std::strlen(e.first));
+        writeBytes(entry, entry_value, e.second);
+        writeBytes(out, tensor_external_data, entry);
+    }
+    writeTag(out, tensor_data_location, wire_varint);
+    writeVarint(out, location_external);
+    return out;
+}
+
+// Walks the ModelProto/GraphProto and calls `on_tensor` for each initializer field.
+// `on_tensor` returns the replacement bytes, or an empty string to keep the original field.
+std::string rewriteGraphInitializers(
+    const std::string& model,
+    const std::function<std::string(const uint8_t*, size_t)>& on_tensor) {
+    std::string out;
+    out.reserve(model.size());
+    Reader r(reinterpret_cast<const uint8_t*>(model.data()), model.size());
+    while (!r.done()) {
+        Field f = r.next();
+        if (f.number != model_graph || f.wire_type != wire_bytes) {
+            out.append(reinterpret_cast<const char*>(f.begin), f.end - f.begin);
+            continue;
+        }
+        std::string graph;
+        Reader g(f.data, f.size);
+        while (!g.done()) {
+            Field gf = g.next();
+            std::string replacement;
+            if (gf.number == graph_initializer && gf.wire_type == wire_bytes) {
+                replacement = on_tensor(gf.data, gf.size);
+            }
+            if (replacement.empty()) {
+                graph.append(reinterpret_cast<const char*>(gf.begin), gf.end - gf.begin);
+            } else {
+                writeBytes(graph, graph_initializer, replacement);
+            }
+        }
+        writeBytes(out, model_graph, graph);
+    }
+    return out;
+}
+
+} // namespace
+
+size_t OnnxProto::elementSize(int32_t data_type) {
+    switch (data_type) {
+    case 1:  return 4; // FLOAT
+    case 2:  return 1; // UINT8
+    case 3:  return 1; // INT8
+    case 4:  return 2; // UINT16
+    case 5:  return 2; // INT16
+    case 6:  return 4; // INT32
+    case 7:  return 8; // INT64
+    case 9:  return 1; // BOOL
+    case 10: return 2; // FLOAT16
+    case 11: return 8; // DOUBLE
+    case 12: return 4; // UINT32
+    case 13: return 8; // UINT64
+    case 16: return 2; // BFLOAT16
+    default: return 0; // STRING, complex and 8-bit float types are left inline
+    }
+}
+
+std::vector<OnnxInitializer> OnnxProto::readInitializers(const std::string& model) {
+    std::vector<OnnxInitializer> initializers;
+    rewriteGraphInitializers(model, [&](const uint8_t* data, size_t size) {
+        OnnxInitializer tensor;
+        if (decodeTensor(data, size, tensor)) initializers.push_back(std::move(tensor));
+        return std::string();
+    });
+    return initializers;
+}
+
+std::string OnnxProto::externalizeInitializers(
+    const std::string& model,
+    const std::function<bool(const OnnxInitializer&, OnnxExternalData&)>& externalize) {
+    return rewriteGraphInitializers(model, [&](const uint8_t* data, size_t size) {
+        OnnxInitializer tensor;
+        OnnxExternalData ext;
+        if (!decodeTensor(data, size, tensor) || !externalize(tensor, ext)) return std::string();
+        return encodeExternalTensor(tensor, ext);
+    });
+}
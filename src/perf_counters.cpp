@@ -0,0 +1,124 @@
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+struct EventConfig {
+    uint32_t type;
+    uint64_t config;
+};
+
+const EventConfig event_configs[num_perf_events] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+int openEvent(const EventConfig& event, int group_fd) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.disabled = group_fd < 0 ? 1 : 0;   // the leader starts the group
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+} // namespace
+
+PerfSample& PerfSample::operator+=(const PerfSample& other) {
+    for (size_t e = 0; e < num_perf_events; ++e) {
+        counts[e] += other.counts[e];
+        valid[e] = valid[e] || other.valid[e];
+    }
+    return *this;
+}
+
+PerfCounters::PerfCounters() {
+    for (size_t e = 0; e < num_perf_events; ++e) fds[e] = -1;
+    fds[0] = openEvent(event_configs[0], -1);
+    if (fds[0] < 0) {
+        error = std::string("perf_event_open: ") + strerror(errno);
+        return;
+    }
+    group_index[0] = num_open++;
+    for (size_t e = 1; e < num_perf_events; ++e) {
+        fds[e] = openEvent(event_configs[e], fds[0]);
+        if (fds[e] >= 0) {
+            group_index[e] = num_open++;
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+void PerfCounters::start() {
+    if (!available()) {
+        return;
+    }
+    ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+bool PerfCounters::read(uint64_t* counts) const {
+    // PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, then one value per event
+    std::vector<uint64_t> buffer(3 + num_open);
+    const ssize_t size = static_cast<ssize_t>(buffer.size() * sizeof(uint64_t));
+    if (::read(fds[0], buffer.data(), size) != size || buffer[0] != num_open) {
+        return false;
+    }
+    const uint64_t enabled = buffer[1], running = buffer[2];
+    for (size_t i = 0; i < num_open; ++i) {
+        counts[i] = running > 0 && running < enabled
+            ? static_cast<uint64_t>(static_cast<double>(buffer[3 + i]) * enabled / running)
+            : buffer[3 + i];
+    }
+    return true;
+}
+
+PerfSample PerfCounters::stop() {
+    PerfSample sample;
+    if (!available()) {
+        return sample;
+    }
+    ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    uint64_t counts[num_perf_events];
+    if (!read(counts)) {
+        return sample;
+    }
+    for (size_t e = 0; e < num_perf_events; ++e) {
+        if (fds[e] >= 0) {
+            sample.counts[e] = counts[group_index[e]];
+            sample.valid[e] = true;
+        }
+    }
+    return sample;
+}
+
+const char* PerfCounters::eventName(PerfEvent event) {
+    switch (event) {
+        case PerfEvent::Cycles: return "cycles";
+        case PerfEvent::Instructions: return "instructions";
+        case PerfEvent::LlcMisses: return "llc_misses";
+        case PerfEvent::DtlbMisses: return "dtlb_misses";
+        case PerfEvent::BranchMisses: return "branch_misses";
+    }
+    return "";
+}
@@ -0,0 +1,103 @@
+#include "pipeline_executor.h"
+
+#include <algorithm>
+
+#include "cost_table.h"
+#include "numa_topology.h"
+#include "trace.h"
+
+namespace {
+
+constexpr size_t jobs_per_stage = 2; // one running, one queued, so no stage waits on a hand-off
+
+} // namespace
+
+PipelineExecutor::PipelineExecutor(InferenceEngine& e, const StitchPlan& p, size_t num_stages, const std::vector<int>& cores)
+    : engine(e), plan(p), bounds(CostTable::partition(CostTable::stepCosts(p), num_stages)) {
+    const size_t stages = getNumStages();
+    const size_t num_jobs = stages * jobs_per_stage;
+    for (size_t i = 0; i < num_jobs; ++i) {
+        jobs.push_back(std::make_unique<Job>(e.getOptions().numa_node));
+        free_jobs.push_back(jobs.back().get());
+    }
+    for (size_t i = 0; i <= stages; ++i) {
+        queues.push_back(std::make_unique<SpscQueue<Job*>>(num_jobs + 1)); // + 1 for the stop marker
+    }
+
+    // Without explicit cores, stages go round the engine's CPUs (all CPUs if it has none)
+    std::vector<int> engine_cpus = e.getOptions().cpu_affinity;
+    for (int cpu = 0; engine_cpus.empty() && cpu < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++cpu) {
+        engine_cpus.push_back(cpu);
+    }
+    for (size_t stage = 0; stage < stages; ++stage) {
+        int core = stage < cores.size() ? cores[stage] : engine_cpus[stage % engine_cpus.size()];
+        threads.emplace_back(&PipelineExecutor::stageLoop, this, stage, core);
+    }
+}
+
+PipelineExecutor::~PipelineExecutor() {
+    // The stop marker follows the last job through every stage
+    queues.front()->push(nullptr);
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
+void PipelineExecutor::stageLoop(size_t stage, int core) {
+    CpuAffinity::pinCurrentThread({ core }); // best effort, e.g. in a restricted cpuset
+    SNNET_TRACE_THREAD_NAME("stage " + std::to_string(stage));
+    const bool last_stage = (stage + 1 == getNumStages());
+    SpscQueue<Job*>& input = *queues[stage];
+    SpscQueue<Job*>& output = *queues[stage + 1];
+    while (true) {
+        Job* job = input.pop();
+        if (job == nullptr) {
+            if (!last_stage) output.push(nullptr);
+            return;
+        }
+        if (!job->failed) {
+            try {
+                float* spare = (job->current == job->context.ping) ? job->context.pong : job->context.ping;
+                job->current = engine.runSteps(plan, bounds[stage], bounds[stage + 1], job->current, spare, job->logits);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+                job->failed = true;
+            }
+        }
+        output.push(job);
+    }
+}
+
+void PipelineExecutor::complete(Job* job) {
+    job->failed = false;
+    free_jobs.push_back(job);
+    --in_flight;
+}
+
+void PipelineExecutor::submit(const float* image, float* logits) {
+    if (free_jobs.empty()) {
+        complete(queues.back()->pop());
+    }
+    Job* job = free_jobs.back();
+    free_jobs.pop_back();
+
+    const PlanStep& first = plan.getSteps().front();
+    std::copy(image, image + first.inputElements(), job->context.ping);
+    job->current = job->context.ping;
+    job->logits = logits;
+    ++in_flight;
+    queues.front()->push(job);
+}
+
+void PipelineExecutor::wait() {
+    while (in_flight > 0) {
+        complete(queues.back()->pop());
+    }
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if (error) {
+        std::exception_ptr first = error;
+        error = nullptr;
+        std::rethrow_exception(first);
+    }
+}
@@ -0,0 +1,169 @@
+#include "request_executor.h"
+
+#include <algorithm>
+
+#include "numa_topology.h"
+#include "trace.h"
+
+namespace {
+
+constexpr int idle_spins = 256; // rounds of looking for work before parking
+
+// The executor and worker index of the calling thread
+thread_local const RequestExecutor* current_executor = nullptr;
+thread_local int current_worker = -1;
+
+class FunctionTask : public ExecutorTask {
+private:
+    std::function<void()> fn;
+
+public:
+    explicit FunctionTask(std::function<void()> f) : fn(std::move(f)) {}
+
+    void run() override {
+        std::unique_ptr<FunctionTask> self(this); // deleted even if fn throws
+        fn();
+    }
+};
+
+} // namespace
+
+RequestExecutor::RequestExecutor(size_t num_workers, const std::vector<int>& cpus, size_t queue_capacity)
+    : ingress(queue_capacity) {
+    if (num_workers == 0) {
+        num_workers = defaultWorkerCount(1);
+    }
+    for (size_t i = 0; i < num_workers; ++i) {
+        workers.push_back(std::make_unique<Worker>(queue_capacity));
+    }
+    // Started after every worker exists, since they steal from each other
+    for (size_t i = 0; i < num_workers; ++i) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        workers[i]->thread = std::thread(&RequestExecutor::workerLoop, this, i, cpu);
+    }
+}
+
+RequestExecutor::~RequestExecutor() {
+    waitIdle();
+    {
+        std::lock_guard<std::mutex> lock(park_mutex);
+        stopping = true;
+    }
+    park_cv.notify_all();
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+size_t RequestExecutor::defaultWorkerCount(int intra_op_threads) {
+    int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    return static_cast<size_t>(std::max(1, cores - std::max(0, intra_op_threads - 1)));
+}
+
+int RequestExecutor::currentWorker() const {
+    return current_executor == this ? current_worker : -1;
+}
+
+void RequestExecutor::submit(ExecutorTask* task) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    int worker = currentWorker();
+    if (worker < 0 || !workers[worker]->deque.push(task)) {
+        while (!ingress.tryPush(task)) {
+            std::this_thread::yield();
+        }
+    }
+    wake();
+}
+
+void RequestExecutor::submit(std::function<void()> fn) {
+    submit(new FunctionTask(std::move(fn)));
+}
+
+void RequestExecutor::wake() {
+    // Pairs with the fence in workerLoop: either we see the sleeper, or it sees the task
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(park_mutex);
+        park_cv.notify_one();
+    }
+}
+
+void RequestExecutor::finished() {
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        idle_cv.notify_all();
+    }
+}
+
+void RequestExecutor::waitIdle() {
+    std::unique_lock<std::mutex> lock(idle_mutex);
+    idle_cv.wait(lock, [&] { return pending.load(std::memory_order_acquire) == 0; });
+}
+
+bool RequestExecutor::hasWork() const {
+    if (!ingress.empty()) {
+        return true;
+    }
+    for (const auto& worker : workers) {
+        if (!worker->deque.empty()) return true;
+    }
+    return false;
+}
+
+ExecutorTask* RequestExecutor::findTask(size_t index, uint32_t& rng) {
+    if (ExecutorTask* task = workers[index]->deque.pop()) {
+        return task;
+    }
+    ExecutorTask* task = nullptr;
+    if (ingress.tryPop(task)) {
+        return task;
+    }
+    // Steal, starting from a random victim so thieves spread out
+    rng ^= rng << 13, rng ^= rng >> 17, rng ^= rng << 5;
+    const size_t n = workers.size();
+    for (size_t k = 0, start = rng % n; k < n; ++k) {
+        size_t victim = (start + k) % n;
+        if (victim == index) continue;
+        if ((task = workers[victim]->deque.steal()) != nullptr) {
+            steals.fetch_add(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void RequestExecutor::workerLoop(size_t index, int cpu) {
+    if (cpu >= 0) {
+        CpuAffinity::pinCurrentThread({ cpu });
+    }
+    current_executor = this;
+    current_worker = static_cast<int>(index);
+    SNNET_TRACE_THREAD_NAME("worker " + std::to_string(index));
+    uint32_t rng = static_cast<uint32_t>(index) * 2654435761u + 1;
+
+    while (true) {
+        ExecutorTask* task = nullptr;
+        for (int spin = 0; spin < idle_spins && task == nullptr; ++spin) {
+            task = findTask(index, rng);
+            if (task == nullptr && spin > idle_spins / 2) std::this_thread::yield();
+        }
+        if (task != nullptr) {
+            try {
+                task->run();
+            } catch (...) {
+                // Tasks report their own errors; an escaping exception must not kill the worker
+            }
+            finished();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(park_mutex);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        park_cv.wait(lock, [&] { return stopping.load() || hasWork(); });
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        if (stopping && !hasWork()) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#include "resource_usage.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <sys/resource.h>
+
+ResourceUsage ResourceUsage::current() {
+    ResourceUsage usage;
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (getline(status, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        size_t value = 0;
+        fields >> key >> value;
+        if (key == "Threads:") {
+            usage.threads = static_cast<int>(value);
+        } else if (key == "VmRSS:") {
+            usage.rss_bytes = value * 1024;
+        } else if (key == "VmHWM:") {
+            usage.peak_rss_bytes = value * 1024;
+        }
+    }
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        usage.minor_faults = ru.ru_minflt;
+        usage.major_faults = ru.ru_majflt;
+        usage.voluntary_switches = ru.ru_nvcsw;
+        usage.involuntary_switches = ru.ru_nivcsw;
+        usage.cpu_s = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    }
+    return usage;
+}
@@ -0,0 +1,256 @@
+#include "session_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+
+#include "metrics.h"
+#include "trace.h"
+
+SessionCache::SessionCache(SessionFactory& f) : factory(f) {}
+
+SessionCache::~SessionCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    prefetch_cv.notify_all();
+    if (prefetch_thread.joinable()) {
+        prefetch_thread.join();
+    }
+}
+
+void SessionCache::setMemoryBudget(size_t bytes) {
+    std::vector<std::shared_ptr<Ort::Session>> evicted;
+    std::lock_guard<std::mutex> lock(mutex);
+    memory_budget = bytes;
+    evictFor(0, evicted);
+}
+
+void SessionCache::touch(const std::string& model_name, Entry& entry) {
+    if (entry.in_lru) {
+        lru.splice(lru.begin(), lru, entry.lru_pos);
+    } else {
+        lru.push_front(model_name);
+        entry.lru_pos = lru.begin();
+        entry.in_lru = true;
+    }
+}
+
+void SessionCache::evictFor(size_t incoming, std::vector<std::shared_ptr<Ort::Session>>& evicted) {
+    if (memory_budget == 0) {
+        return;
+    }
+    auto it = lru.end();
+    while (resident_bytes + incoming > memory_budget && it != lru.begin()) {
+        --it;
+        Entry& entry = entries[*it];
+        // use_count() == 1: only the cache holds it, so no Run() is using the session
+        if (entry.loading || !entry.session || entry.session.use_count() > 1) {
+            continue;
+        }
+        evicted.push_back(std::move(entry.session));
+        resident_bytes -= entry.footprint;
+        entry.in_lru = false;
+        it = lru.erase(it);
+        ++evictions;
+        Metrics::global().countEviction();
+    }
+}
+
+void SessionCache::lockCounted(std::unique_lock<std::mutex>& lock) {
+    if (lock.try_lock()) {
+        ++lock_acquisitions;
+        return;
+    }
+    // Only contended locks pay for the clock
+    auto start = std::chrono::steady_clock::now();
+    lock.lock();
+    ++lock_acquisitions;
+    ++lock_contentions;
+    lock_wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::shared_ptr<Ort::Session> SessionCache::acquire(const std::string& model_name, bool prefetch) {
+    std::vector<std::shared_ptr<Ort::Session>> evicted; // destroyed after the lock is released
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+    lockCounted(lock);
+    Entry& entry = entries[model_name];
+    loaded_cv.wait(lock, [&] { return !entry.loading; });
+    if (entry.session) {
+        if (!prefetch) {
+            ++hits;
+            Metrics::global().countCacheHit();
+            touch(model_name, entry);
+        }
+        return entry.session;
+    }
+    if (prefetch) ++prefetches;
+    else ++misses;
+
+    // Reserve the footprint before loading so concurrent loads respect the budget
+    entry.loading = true;
+    entry.footprint = factory.getModelFootprint(model_name);
+    evictFor(entry.footprint, evicted);
+    resident_bytes += entry.footprint;
+    lock.unlock();
+    evicted.clear();
+
+    std::shared_ptr<Ort::Session> session;
+    auto start = std::chrono::steady_clock::now();
+    try {
+        SNNET_TRACE_SCOPE("load", Tracer::intern(model_name));
+        session = std::make_shared<Ort::Session>(factory.create(model_name));
+    } catch (...) {
+        lock.lock();
+        entry.loading = false;
+        resident_bytes -= entry.footprint;
+        loaded_cv.notify_all();
+        throw;
+    }
+    double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    lock.lock();
+    entry.session = session;
+    entry.loading = false;
+    touch(model_name, entry);
+    load_stats.push_back({ model_name, load_ms, factory.getModelSize(model_name) });
+    Metrics::global().recordSessionLoad(prefetch, static_cast<uint64_t>(load_ms * 1000));
+    loaded_cv.notify_all();
+    return session;
+}
+
+std::shared_ptr<Ort::Session> SessionCache::get(const std::string& model_name) {
+    return acquire(model_name, false);
+}
+
+void SessionCache::preload(const std::vector<std::string>& model_names, int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    num_threads = std::min<int>(num_threads, static_cast<int>(model_names.size()));
+
+    std::atomic<size_t> next{ 0 };
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto worker = [&] {
+        for (size_t i = next++; i < model_names.size(); i = next++) {
+            try {
+                acquire(model_names[i], true);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void SessionCache::prefetch(const std::string& model_name) {
+    {
+        std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+        lockCounted(lock);
+        auto it = entries.find(model_name);
+        if (it != entries.end() && (it->second.session || it->second.loading)) {
+            return;
+        }
+        if (std::find(prefetch_queue.begin(), prefetch_queue.end(), model_name) != prefetch_queue.end()) {
+            return;
+        }
+        prefetch_queue.push_back(model_name);
+        if (!prefetch_thread.joinable()) {
+            prefetch_thread = std::thread(&SessionCache::prefetchLoop, this);
+        }
+    }
+    prefetch_cv.notify_one();
+}
+
+void SessionCache::releaseLater(const std::string& model_name) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        release_queue.push_back(model_name);
+        if (!prefetch_thread.joinable()) {
+            prefetch_thread = std::thread(&SessionCache::prefetchLoop, this);
+        }
+    }
+    prefetch_cv.notify_one();
+}
+
+void SessionCache::prefetchLoop() {
+    SNNET_TRACE_THREAD_NAME("prefetch");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        prefetch_cv.wait(lock, [&] { return stopping || !prefetch_queue.empty() || !release_queue.empty(); });
+        if (stopping) {
+            return;
+        }
+        // Releases first: they free the memory the loads may need
+        if (!release_queue.empty()) {
+            std::string model_name = std::move(release_queue.front());
+            release_queue.pop_front();
+            lock.unlock();
+            release(model_name);
+            lock.lock();
+            continue;
+        }
+        std::string model_name = std::move(prefetch_queue.front());
+        prefetch_queue.pop_front();
+        lock.unlock();
+        try {
+            acquire(model_name, true);
+        } catch (...) {
+            // reported by the get() that needs the model
+        }
+        lock.lock();
+    }
+}
+
+void SessionCache::release(const std::string& model_name) {
+    std::shared_ptr<Ort::Session> evicted;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(model_name);
+    if (it == entries.end()) {
+        return;
+    }
+    Entry& entry = it->second;
+    if (entry.loading || !entry.session || entry.session.use_count() > 1) {
+        return;
+    }
+    evicted = std::move(entry.session);
+    resident_bytes -= entry.footprint;
+    if (entry.in_lru) {
+        lru.erase(entry.lru_pos);
+        entry.in_lru = false;
+    }
+    ++evictions;
+    Metrics::global().countEviction();
+}
+
+bool SessionCache::isResident(const std::string& model_name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(model_name);
+    return it != entries.end() && it->second.session != nullptr;
+}
+
+std::vector<SessionLoadStats> SessionCache::getLoadStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return load_stats;
+}
+
+SessionCacheStats SessionCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return { hits, misses, prefetches, evictions, resident_bytes, memory_budget, lru.size(),
+             lock_acquisitions, lock_contentions, lock_wait_ms };
+}
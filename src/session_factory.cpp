@@ -0,0 +1,274 @@
+#include "session_factory.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include <onnxruntime_session_options_config_keys.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "storage_throttle.h"
+
+namespace {
+
+// CPU feature flags as reported by the kernel ("flags" on x86, "Features" on ARM).
+// ORT_ENABLE_ALL applies layout and kernel choices specific to them.
+std::string cpuFeatures() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (getline(cpuinfo, line)) {
+        if (line.rfind("flags", 0) == 0 || line.rfind("Features", 0) == 0) {
+            return line;
+        }
+    }
+    return "unknown";
+}
+
+// Identifies the source of a model, so edited or repacked models are re-optimized.
+std::string sourceStamp(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return "missing";
+    }
+    return std::to_string(st.st_size) + "-" + std::to_string(st.st_mtime);
+}
+
+std::string toHex(uint64_t v) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+    return buf;
+}
+
+} // namespace
+
+SessionFactory::SessionFactory(const Ort::Env& e, const Ort::SessionOptions& options, const std::string& dir)
+    : env(e), session_options(options.Clone()), model_dir(dir) {}
+
+SessionFactory::~SessionFactory() {
+    if (prepacked_weights != nullptr) {
+        Ort::GetApi().ReleasePrepackedWeightsContainer(prepacked_weights);
+    }
+}
+
+void SessionFactory::sharePrepackedWeights() {
+    if (prepacked_weights == nullptr) {
+        Ort::ThrowOnError(Ort::GetApi().CreatePrepackedWeightsContainer(&prepacked_weights));
+    }
+}
+
+void SessionFactory::setSessionTuner(std::function<void(const std::string&, Ort::SessionOptions&)> tuner) {
+    session_tuner = std::move(tuner);
+}
+
+void SessionFactory::useWeightStore(const std::string& packed_dir) {
+    weight_store = std::make_unique<WeightStore>(packed_dir + weight_store_file);
+    model_dir = packed_dir;
+}
+
+void SessionFactory::useBundle(const std::string& bundle_path) {
+    model_bundle = std::make_unique<ModelBundle>(bundle_path);
+}
+
+bool SessionFactory::usePackedDir(const std::string& packed_dir) {
+    bool found = false;
+    if (std::filesystem::exists(packed_dir + weight_store_file)) {
+        useWeightStore(packed_dir);
+        found = true;
+    }
+    if (std::filesystem::exists(packed_dir + model_bundle_file)) {
+        useBundle(packed_dir + model_bundle_file);
+        found = true;
+    }
+    return found;
+}
+
+void SessionFactory::useOrtCache(const std::string& cache_dir, const std::string& options_tag) {
+    std::filesystem::create_directories(cache_dir);
+    ort_cache_dir = cache_dir;
+    ort_cache_tag = Ort::GetVersionString() + "|" + cpuFeatures() + "|" + options_tag;
+}
+
+std::string SessionFactory::getModelPath(const std::string& model_name) const {
+    if (model_bundle && model_bundle->hasModel(model_name)) {
+        return model_bundle->getFile().getPath() + ":" + model_name;
+    }
+    return model_dir + model_name + ".onnx";
+}
+
+std::string SessionFactory::getOrtCachePath(const std::string& model_name) const {
+    std::string key = ort_cache_tag + "|" + model_name;
+    if (model_bundle && model_bundle->hasModel(model_name)) {
+        key += "|" + sourceStamp(model_bundle->getFile().getPath());
+    } else {
+        key += "|" + sourceStamp(model_dir + model_name + ".onnx");
+    }
+    if (weight_store && weight_store->hasModel(model_name)) {
+        key += "|" + sourceStamp(weight_store->getBlob().getPath());
+    }
+    uint64_t hash = ModelBundle::checksum(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+    return ort_cache_dir + model_name + "." + toHex(hash) + ".ort";
+}
+
+size_t SessionFactory::getModelSize(const std::string& model_name) const {
+    if (model_bundle && model_bundle->hasModel(model_name)) {
+        return model_bundle->getModel(model_name).second;
+    }
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(model_dir + model_name + ".onnx", ec);
+    return ec ? 0 : static_cast<size_t>(size);
+}
+
+size_t SessionFactory::getModelFootprint(const std::string& model_name) const {
+    if (!ort_cache_dir.empty()) { // ORT format models hold their weights
+        std::error_code ec;
+        uintmax_t size = std::filesystem::file_size(getOrtCachePath(model_name), ec);
+        if (!ec) return static_cast<size_t>(size);
+    }
+    size_t footprint = getModelSize(model_name);
+    if (weight_store) {
+        footprint += weight_store->getModelBytes(model_name);
+    }
+    return footprint;
+}
+
+Ort::Session SessionFactory::createFromSource(const std::string& model_name, const Ort::SessionOptions& base_options) {
+    const Ort::SessionOptions* options = &base_options;
+    Ort::SessionOptions model_options{ nullptr };
+    const bool use_weight_store = weight_store && weight_store->hasModel(model_name);
+    if (session_tuner || use_weight_store) {
+        model_options = base_options.Clone();
+        options = &model_options;
+    }
+    if (session_tuner) {
+        session_tuner(model_name, model_options);
+    }
+    if (use_weight_store) {
+        weight_store->addInitializers(model_name, model_options, prepacked_weights != nullptr);
+    }
+
+    if (model_bundle && model_bundle->hasModel(model_name)) {
+        std::pair<const uint8_t*, size_t> model = model_bundle->getModel(model_name);
+        return prepacked_weights ? Ort::Session(env, model.first, model.second, *options, prepacked_weights)
+                                 : Ort::Session(env, model.first, model.second, *options);
+    }
+    std::string model_path = getModelPath(model_name);
+    return prepacked_weights ? Ort::Session(env, model_path.c_str(), *options, prepacked_weights)
+                             : Ort::Session(env, model_path.c_str(), *options);
+}
+
+Ort::Session SessionFactory::createFromOrtCache(const std::string& model_name, const std::string& cached_path) {
+    const void* model_data;
+    size_t model_size;
+    {
+        std::lock_guard<std::mutex> lock(ort_models_mutex);
+        std::unique_ptr<MappedFile>& mapped = ort_models[model_name];
+        if (!mapped) {
+            mapped = std::make_unique<MappedFile>(cached_path);
+        }
+        model_data = mapped->data();
+        model_size = mapped->size();
+        if (local_models.count(model_name) != 0) {
+            auto local = local_ort_models.find(model_name);
+            if (local == local_ort_models.end()) {
+                HugePageBuffer copy(model_size, local_node);
+                std::memcpy(copy.data(), mapped->data(), model_size);
+                local = local_ort_models.emplace(model_name, std::move(copy)).first;
+            }
+            model_data = local->second.data();
+        }
+    }
+
+    // The mapping (or local copy) lives as long as the factory, so ORT can use the bytes (and initializers) in place
+    Ort::SessionOptions options = session_options.Clone();
+    options.AddConfigEntry(kOrtSessionOptionsConfigLoadModelFormat, "ORT");
+    options.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesDirectly, "1");
+    options.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesForInitializers, "1");
+    if (session_tuner) {
+        session_tuner(model_name, options);
+    }
+    return prepacked_weights ? Ort::Session(env, model_data, model_size, options, prepacked_weights)
+                             : Ort::Session(env, model_data, model_size, options);
+}
+
+Ort::Session SessionFactory::create(const std::string& model_name) {
+    if (StorageThrottle::instance().enabled()) { // emulating slow storage; the footprint costs two stats
+        StorageThrottle::instance().charge(getModelFootprint(model_name));
+    }
+    if (ort_cache_dir.empty()) {
+        return createFromSource(model_name, session_options);
+    }
+
+    std::string cached_path = getOrtCachePath(model_name);
+    if (std::filesystem::exists(cached_path)) {
+        return createFromOrtCache(model_name, cached_path);
+    }
+
+    // First load: optimize at the highest level and save the result in ORT format.
+    // Written under a temporary name so concurrent processes never map a partial file.
+    std::string tmp_path = cached_path + ".tmp" + std::to_string(getpid()) + "-" +
+        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    Ort::SessionOptions options = session_options.Clone();
+    options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+    options.SetOptimizedModelFilePath(tmp_path.c_str());
+    options.AddConfigEntry(kOrtSessionOptionsConfigSaveModelFormat, "ORT");
+
+    Ort::Session session = createFromSource(model_name, options);
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, cached_path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp_path, ec);
+    }
+    return session;
+}
+
+void SessionFactory::localizeModels(const std::vector<std::string>& model_names, int numa_node) {
+    {
+        std::lock_guard<std::mutex> lock(ort_models_mutex);
+        local_node = numa_node;
+        local_models.insert(model_names.begin(), model_names.end());
+    }
+    if (weight_store) {
+        weight_store->localize(model_names, numa_node);
+    }
+}
+
+PinStats SessionFactory::pinModels(const std::vector<std::string>& model_names, bool lock) {
+    PinStats stats;
+    auto pin = [&](const MappedFile& file, size_t offset, size_t bytes) {
+        stats.prefaulted_bytes += file.prefault(offset, bytes);
+        if (!lock) {
+            return;
+        }
+        if (file.lock(offset, bytes)) {
+            stats.locked_bytes += bytes;
+        } else {
+            stats.lock_failed = true;
+        }
+    };
+
+    for (const std::string& model_name : model_names) {
+        const MappedFile* ort_model = nullptr;
+        {
+            std::lock_guard<std::mutex> lock_models(ort_models_mutex);
+            auto it = ort_models.find(model_name);
+            if (it != ort_models.end()) {
+                ort_model = it->second.get();
+            }
+        }
+        if (ort_model != nullptr) { // holds the initializers too
+            pin(*ort_model, 0, ort_model->size());
+            continue;
+        }
+        if (model_bundle && model_bundle->hasModel(model_name)) {
+            std::pair<const uint8_t*, size_t> model = model_bundle->getModel(model_name);
+            pin(model_bundle->getFile(), model.first - model_bundle->getFile().data(), model.second);
+        }
+        if (weight_store && weight_store->hasModel(model_name)) {
+            std::pair<uint64_t, uint64_t> range = weight_store->getModelRange(model_name);
+            pin(weight_store->getBlob(), range.first, range.second);
+        }
+    }
+    return stats;
+}
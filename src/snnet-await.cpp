@@ -0,0 +1,173 @@
+/* C++20 check of inference_awaitable.h, built with -std=c++20 while the rest is C++17
+ * Usage: snnet-await [--stitch S] [--requests N] [--model-dir <dir>] [--packed <dir>]
+ * Starts N coroutines that each co_await inferAsync() on the same image, half of them
+ * resumed on ORT's thread and half through a resume function that queues them for the
+ * main thread, plus one with an image of the wrong size whose error must be rethrown
+ * from the co_await. Every result is compared with InferenceEngine::run(); exits 1 on
+ * any mismatch or missing error.
+ *   --stitch    stitch id (default 0)
+ *   --requests  coroutines in flight at once (default 8)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+#include "inference_awaitable.h"
+#include "inference_engine.h"
+#include "stitch_plan.h"
+
+using namespace std;
+
+namespace {
+
+/* Fire-and-forget coroutine: runs to its first co_await at once, frees itself at the end */
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
+
+/* Handles queued by the resume function, resumed by the main thread, and the count of finished coroutines */
+struct MainLoop {
+    mutex m;
+    condition_variable cv;
+    deque<coroutine_handle<>> ready;
+    int finished = 0;
+
+    void post(coroutine_handle<> handle) {
+        {
+            lock_guard<mutex> lock(m);
+            ready.push_back(handle);
+        }
+        cv.notify_one();
+    }
+
+    void finish() {
+        {
+            lock_guard<mutex> lock(m);
+            finished++;
+        }
+        cv.notify_one();
+    }
+
+    // Resumes queued coroutines on this thread until `count` have finished
+    void run(int count) {
+        unique_lock<mutex> lock(m);
+        while (finished < count) {
+            cv.wait(lock, [&] { return finished >= count || !ready.empty(); });
+            while (!ready.empty()) {
+                coroutine_handle<> handle = ready.front();
+                ready.pop_front();
+                lock.unlock();
+                handle.resume();
+                lock.lock();
+            }
+        }
+    }
+};
+
+Detached infer(InferenceEngine& engine, const vector<float>& image, int stitch_id, const vector<float>& expected,
+               MainLoop* loop, MainLoop& done, atomic<int>& failures) {
+    std::function<void(coroutine_handle<>)> resume;
+    if (loop != nullptr) {
+        resume = [loop](coroutine_handle<> handle) { loop->post(handle); };
+    }
+    try {
+        vector<float> logits = co_await inferAsync(engine, image, stitch_id, resume);
+        if (logits != expected) {
+            cerr << "Logits differ from InferenceEngine::run()" << endl;
+            failures++;
+        }
+    } catch (const exception& e) {
+        cerr << "co_await failed: " << e.what() << endl;
+        failures++;
+    }
+    done.finish();
+}
+
+Detached inferInvalid(InferenceEngine& engine, int stitch_id, MainLoop& done, bool& rethrown) {
+    const vector<float> image(3); // not 3x224x224
+    try {
+        co_await inferAsync(engine, image, stitch_id);
+    } catch (const invalid_argument&) {
+        rethrown = true;
+    }
+    done.finish();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int stitch_id = 0, requests = 8;
+    EngineOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stitch") == 0 && i + 1 < argc) stitch_id = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) requests = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--model-dir") == 0 && i + 1 < argc) options.model_dir = string(argv[++i]) + "/";
+        else if (strcmp(argv[i], "--packed") == 0 && i + 1 < argc) options.packed_dir = string(argv[++i]) + "/";
+        else {
+            cerr << "Usage: " << argv[0] << " [--stitch S] [--requests N] [--model-dir <dir>] [--packed <dir>]" << endl;
+            return 1;
+        }
+    }
+    if (stitch_id < 0 || stitch_id >= num_stitch_ids) {
+        cerr << "Stitch id out of range: " << stitch_id << endl;
+        return 1;
+    }
+    // RunAsync schedules each step on the intra-op pool, which needs a thread besides the caller
+    options.intra_op_threads = 2;
+
+    try {
+        InferenceEngine engine(options);
+        StitchPlan plan(stitch_id);
+        engine.preload(plan);
+        const vector<float> image(in_numChannels * in_height * in_width, 0.5f);
+        vector<float> expected(out_numClasses);
+        InferenceContext context;
+        engine.run(plan, image.data(), expected.data(), context);
+
+        MainLoop loop;
+        atomic<int> failures{0};
+        bool rethrown = false;
+        for (int r = 0; r < requests; r++) {
+            infer(engine, image, stitch_id, expected, r % 2 == 0 ? &loop : nullptr, loop, failures);
+        }
+        inferInvalid(engine, stitch_id, loop, rethrown);
+        loop.run(requests + 1);
+
+        if (!rethrown) {
+            cerr << "The invalid request's error was not rethrown from co_await" << endl;
+            failures++;
+        }
+        cout << requests << " co_await requests, " << failures << " failures" << endl;
+        return failures == 0 ? 0 : 1;
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,608 @@
+/* End-to-end benchmark of stitch plans
+ * Usage: snnet-bench [--stitches <list | all>] [--iterations N] [--warmup W] [--threads <list>]
+ *                    [--concurrency <list>] [--scaling [--streams <list>]] [--model-dir <dir>]
+ *                    [--counters [--roofline <GFLOP/s>,<GB/s>]] [--packed <dir>] [--budget-mb <MB>]
+ *                    [--emulate <device profile>] [--output <json>]
+ * For every stitch id, with a fresh engine: cold load time of its sessions (and of each
+ * layer), warm end-to-end and per-layer latency percentiles over N runs after W warmup
+ * runs, and throughput for every combination of intra-op threads and concurrent callers
+ * (the models take batch size 1, so concurrent requests stand in for batches). Peak RSS
+ * is reported per stitch and for the whole run. Results are written as JSON, with the
+ * host and build, so runs on different hosts and builds can be diffed.
+ * --scaling measures multi-core scaling instead: K streams (threads) each run N requests
+ * back to back over resident sessions, for every K in --streams, with one stitch (the first
+ * of --stitches) or a mix of all of them, and with one set of sessions shared by every
+ * stream or an engine per stream. Each stream runs its steps on its own thread (one intra-op
+ * thread), so per request, CPU time growing with K points at memory bandwidth or cache
+ * contention, and wall minus CPU time at waiting: for a core, or for a lock. Along with
+ * throughput, scaling efficiency and latency percentiles, it records the session cache lock
+ * contention and the process' context switches.
+ * --counters samples hardware counters (cycles, instructions, LLC, dTLB and branch misses,
+ * see PerfCounters) around every step's session Run instead, with one intra-op thread so
+ * the kernels run on the counted thread. Each step gets its CostTable FLOPs and bytes, the
+ * achieved GFLOP/s, the modelled arithmetic intensity and the measured one (FLOPs per byte
+ * of LLC misses), and the steps are aggregated per kind and width. A step is memory-bound
+ * when its intensity is left of the roofline's ridge point: --roofline gives the peaks,
+ * else compute is the best GFLOP/s achieved by any step and memory a single-thread copy.
+ * Without counter access (perf_event_paranoid, VMs without a PMU), FLOPs, bytes and
+ * GFLOP/s are still reported.
+ *   --stitches     stitch ids, e.g. 0-2,10,40 (default 0,1,2,20,50)
+ *   --iterations   timed runs per measurement (default 50)
+ *   --warmup       untimed runs before timing (default 5)
+ *   --threads      intra-op thread counts for throughput (default 1 and cores)
+ *   --concurrency  callers for throughput (default 1 and cores)
+ *   --streams      K for --scaling (default 1 to cores)
+ *   --roofline     peak GFLOP/s and GB/s of one core for --counters, e.g. 150,20
+ *   --budget-mb    session memory budget of every engine (default: unlimited)
+ *   --emulate      run under a smaller device's constraints, e.g. cores=4,memory=3g,duty=0.6,storage=150m
+ *                  (see DeviceEmulation); "cores" is then the emulated count
+ *   --output       JSON report (default: stdout)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <time.h>
+#include <unistd.h>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "constants.h"
+#include "cost_table.h"
+#include "device_emulation.h"
+#include "inference_engine.h"
+#include "json_writer.h"
+#include "latency_stats.h"
+#include "numa_topology.h"
+#include "perf_counters.h"
+#include "resource_usage.h"
+#include "stitch_plan.h"
+
+using namespace std;
+
+struct BenchConfig {
+    vector<int> stitch_ids = { 0, 1, 2, 20, 50 };
+    int iterations = 50, warmup = 5;
+    vector<int> threads, concurrency, streams;
+    bool scaling = false, counters = false;
+    double peak_gflops = 0, peak_gbs = 0;   // --roofline; 0: estimated
+    string model_dir = "./pretrained/onnx/", packed_dir = "./pretrained/packed/";
+    size_t memory_budget = 0;
+};
+
+static double msSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static string cpuModel() {
+    ifstream cpuinfo("/proc/cpuinfo");
+    string line;
+    while (getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0) return line.substr(line.find(':') + 2);
+    }
+    return "";
+}
+
+static void writeLatency(JsonWriter& json, const string& name, const LatencySummary& s) {
+    json.key(name).beginObject()
+        .member("count", static_cast<uint64_t>(s.count)).member("mean", s.mean).member("min", s.min)
+        .member("p50", s.p50).member("p90", s.p90).member("p99", s.p99).member("max", s.max)
+        .endObject();
+}
+
+static EngineOptions engineOptions(const BenchConfig& config, int threads) {
+    EngineOptions options;
+    options.model_dir = config.model_dir;
+    options.packed_dir = config.packed_dir;
+    options.intra_op_threads = threads;
+    options.memory_budget = config.memory_budget;
+    options.shared_thread_pools = false; // the env is a process singleton: its global pools would keep the first thread count
+    return options;
+}
+
+static void benchStitch(const BenchConfig& config, int stitch_id, const vector<float>& image, JsonWriter& json) {
+    StitchPlan plan(stitch_id);
+    const vector<PlanStep>& steps = plan.getSteps();
+    json.beginObject().member("stitch_id", stitch_id).member("flops", CostTable::planFlops(plan));
+
+    {
+        /* Cold load, then warm latency of the whole plan and of each step, with one thread */
+        auto start = chrono::steady_clock::now();
+        InferenceEngine engine(engineOptions(config, 1));
+        engine.preload(plan);
+        json.member("cold_load_ms", msSince(start)).member("rss_after_load_bytes", static_cast<uint64_t>(ResourceUsage::current().rss_bytes));
+
+        InferenceContext context;
+        vector<float> logits(out_numClasses);
+        for (int i = 0; i < config.warmup; i++) engine.run(plan, image.data(), logits.data(), context);
+        vector<double> samples;
+        for (int i = 0; i < config.iterations; i++) {
+            auto run_start = chrono::steady_clock::now();
+            engine.run(plan, image.data(), logits.data(), context);
+            samples.push_back(msSince(run_start));
+        }
+        writeLatency(json, "latency_ms", LatencySummary::of(samples));
+
+        vector<SessionLoadStats> loads = engine.getSessionCache().getLoadStats();
+        json.key("layers").beginArray();
+        for (size_t s = 0; s < steps.size(); s++) {
+            json.beginObject().member("step", static_cast<uint64_t>(s)).member("model", steps[s].model_name)
+                .member("kind", PlanStep::kindName(steps[s].kind)).member("flops", CostTable::stepFlops(steps[s]));
+            auto load = find_if(loads.begin(), loads.end(), [&](const SessionLoadStats& l) { return l.model_name == steps[s].model_name; });
+            if (load != loads.end()) json.member("load_ms", load->load_ms).member("model_bytes", static_cast<uint64_t>(load->model_bytes));
+            // Activations do not matter to the timing; the buffers are reused as they are
+            for (int i = 0; i < config.warmup; i++) engine.runSteps(plan, s, s + 1, context.ping, context.pong, logits.data());
+            samples.clear();
+            for (int i = 0; i < config.iterations; i++) {
+                auto step_start = chrono::steady_clock::now();
+                engine.runSteps(plan, s, s + 1, context.ping, context.pong, logits.data());
+                samples.push_back(msSince(step_start));
+            }
+            writeLatency(json, "latency_ms", LatencySummary::of(samples));
+            json.endObject();
+        }
+        json.endArray();
+    }
+
+    /* Throughput for every thread count and number of callers */
+    json.key("throughput").beginArray();
+    for (int threads : config.threads) {
+        InferenceEngine engine(engineOptions(config, threads));
+        engine.preload(plan);
+        for (int callers : config.concurrency) {
+            // The clock starts once every caller has warmed up, as in benchScaling
+            atomic<int> remaining{ config.iterations * callers };
+            atomic<int> ready{ 0 };
+            atomic<bool> go{ false };
+            vector<thread> workers;
+            for (int c = 0; c < callers; c++) {
+                workers.emplace_back([&] {
+                    InferenceContext context;
+                    vector<float> logits(out_numClasses);
+                    for (int i = 0; i < config.warmup; i++) engine.run(plan, image.data(), logits.data(), context);
+                    ready++;
+                    while (!go.load()) this_thread::yield();
+                    while (remaining-- > 0) engine.run(plan, image.data(), logits.data(), context);
+                });
+            }
+            while (ready.load() < callers) this_thread::yield();
+            auto start = chrono::steady_clock::now();
+            go = true;
+            for (thread& worker : workers) worker.join();
+            double seconds = msSince(start) / 1000;
+            json.beginObject().member("intra_op_threads", threads).member("concurrency", callers)
+                .member("images_per_s", config.iterations * callers / seconds).endObject();
+        }
+    }
+    json.endArray();
+    json.member("peak_rss_bytes", static_cast<uint64_t>(ResourceUsage::current().peak_rss_bytes));
+    json.endObject();
+}
+
+static double threadCpuMs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void benchScaling(const BenchConfig& config, const vector<float>& image, JsonWriter& json) {
+    vector<unique_ptr<StitchPlan>> plans;
+    for (int stitch_id : config.stitch_ids) plans.push_back(make_unique<StitchPlan>(stitch_id));
+    const int max_streams = *max_element(config.streams.begin(), config.streams.end());
+
+    json.key("scaling").beginArray();
+    for (bool mixed : { false, true }) {
+        if (mixed && plans.size() < 2) continue;
+        const size_t num_plans = mixed ? plans.size() : 1;
+        for (bool per_stream : { false, true }) {
+            const char* mode_name = mixed ? (per_stream ? "mixed, per-stream sessions" : "mixed, shared sessions")
+                                          : (per_stream ? "single, per-stream sessions" : "single, shared sessions");
+            cerr << "Scaling: " << mode_name << "..." << endl;
+            vector<unique_ptr<InferenceEngine>> engines;
+            for (int e = 0; e < (per_stream ? max_streams : 1); e++) {
+                engines.push_back(make_unique<InferenceEngine>(engineOptions(config, 1)));
+                for (size_t p = 0; p < num_plans; p++) engines.back()->preload(*plans[p]);
+            }
+
+            json.beginObject().member("stitches", mixed ? "mixed" : "single").member("sessions", per_stream ? "per_stream" : "shared");
+            json.key("streams").beginArray();
+            double single_stream_rate = 0;
+            for (int streams : config.streams) {
+                auto cacheTotals = [&] {
+                    SessionCacheStats total{};
+                    for (auto& engine : engines) {
+                        SessionCacheStats stats = engine->getSessionCache().getStats();
+                        total.lock_acquisitions += stats.lock_acquisitions;
+                        total.lock_contentions += stats.lock_contentions;
+                        total.lock_wait_ms += stats.lock_wait_ms;
+                    }
+                    return total;
+                };
+                vector<vector<double>> wall_ms(streams), cpu_ms(streams);
+                atomic<int> ready{ 0 };
+                atomic<bool> go{ false };
+                vector<thread> workers;
+                for (int k = 0; k < streams; k++) {
+                    workers.emplace_back([&, k] {
+                        InferenceEngine& engine = *engines[per_stream ? k : 0];
+                        InferenceContext context;
+                        vector<float> logits(out_numClasses);
+                        for (int i = 0; i < config.warmup; i++) {
+                            engine.run(*plans[(k + i) % num_plans], image.data(), logits.data(), context);
+                        }
+                        ready++;
+                        while (!go.load()) this_thread::yield();
+                        for (int i = 0; i < config.iterations; i++) {
+                            auto start = chrono::steady_clock::now();
+                            double cpu_start = threadCpuMs();
+                            engine.run(*plans[(k + i) % num_plans], image.data(), logits.data(), context);
+                            cpu_ms[k].push_back(threadCpuMs() - cpu_start);
+                            wall_ms[k].push_back(msSince(start));
+                        }
+                    });
+                }
+                while (ready.load() < streams) this_thread::yield();
+                SessionCacheStats cache_before = cacheTotals();
+                ResourceUsage usage_before = ResourceUsage::current();
+                auto start = chrono::steady_clock::now();
+                go = true;
+                for (thread& worker : workers) worker.join();
+                double seconds = msSince(start) / 1000;
+                SessionCacheStats cache_after = cacheTotals();
+                ResourceUsage usage_after = ResourceUsage::current();
+
+                vector<double> all_wall, all_cpu, all_wait;
+                for (int k = 0; k < streams; k++) {
+                    for (size_t i = 0; i < wall_ms[k].size(); i++) all_wait.push_back(max(0.0, wall_ms[k][i] - cpu_ms[k][i]));
+                    all_wall.insert(all_wall.end(), wall_ms[k].begin(), wall_ms[k].end());
+                    all_cpu.insert(all_cpu.end(), cpu_ms[k].begin(), cpu_ms[k].end());
+                }
+                const double rate = config.iterations * streams / seconds;
+                if (streams == 1) single_stream_rate = rate;
+                const LatencySummary latency = LatencySummary::of(all_wall);
+                json.beginObject().member("streams", streams).member("images_per_s", rate);
+                if (single_stream_rate > 0) json.member("efficiency", rate / (single_stream_rate * streams));
+                writeLatency(json, "latency_ms", latency);
+                writeLatency(json, "cpu_ms", LatencySummary::of(all_cpu));
+                writeLatency(json, "wait_ms", LatencySummary::of(all_wait));
+                json.member("process_cpu_utilization", (usage_after.cpu_s - usage_before.cpu_s) / seconds)
+                    .member("lock_acquisitions", cache_after.lock_acquisitions - cache_before.lock_acquisitions)
+                    .member("lock_contentions", cache_after.lock_contentions - cache_before.lock_contentions)
+                    .member("lock_wait_ms", cache_after.lock_wait_ms - cache_before.lock_wait_ms)
+                    .member("voluntary_switches", static_cast<int64_t>(usage_after.voluntary_switches - usage_before.voluntary_switches))
+                    .member("involuntary_switches", static_cast<int64_t>(usage_after.involuntary_switches - usage_before.involuntary_switches))
+                    .endObject();
+                // Columns to plot throughput and p99 against K
+                cerr << "  K=" << streams << "\t" << rate << " images/s\tp99 " << latency.p99 << " ms" << endl;
+            }
+            json.endArray().endObject();
+        }
+    }
+    json.endArray();
+}
+
+/* Counts and time of one step (or of a kind and width, summed over steps), over all timed runs */
+struct StepCounters {
+    double flops = 0, bytes = 0, weight_bytes = 0; // per run
+    int runs = 0;
+    double ms = 0;
+    PerfSample sample;
+
+    StepCounters& operator+=(const StepCounters& other) {
+        // FLOPs and bytes are per run, so steps weigh by their runs, as time does
+        flops = (flops * runs + other.flops * other.runs) / max(1, runs + other.runs);
+        bytes = (bytes * runs + other.bytes * other.runs) / max(1, runs + other.runs);
+        weight_bytes = (weight_bytes * runs + other.weight_bytes * other.runs) / max(1, runs + other.runs);
+        runs += other.runs;
+        ms += other.ms;
+        sample += other.sample;
+        return *this;
+    }
+
+    double gflops() const {
+        return ms > 0 ? flops * runs / (ms * 1e6) : 0;
+    }
+
+    // FLOPs per byte of LLC misses (64-byte lines), i.e. of DRAM traffic; 0 without the counter
+    double dramIntensity() const {
+        const double miss_bytes = static_cast<double>(sample.get(PerfEvent::LlcMisses)) * 64;
+        return sample.has(PerfEvent::LlcMisses) && miss_bytes > 0 ? flops * runs / miss_bytes : 0;
+    }
+
+    double intensity() const {
+        return bytes > 0 ? flops / bytes : 0;
+    }
+};
+
+static int stepWidth(const PlanStep& step) {
+    return static_cast<int>(step.kind == StepKind::Embed ? step.output_shape.back() : step.input_shape.back());
+}
+
+// Single-thread copy bandwidth over buffers well past the LLC, in GB/s (read + write)
+static double copyBandwidth() {
+    const size_t floats = 64 << 20 >> 2;
+    vector<float> source(floats, 1.0f), target(floats);
+    double best_ms = 0;
+    for (int i = 0; i < 5; i++) {
+        auto start = chrono::steady_clock::now();
+        memcpy(target.data(), source.data(), floats * sizeof(float));
+        const double ms = msSince(start);
+        if (i == 0 || ms < best_ms) best_ms = ms;
+    }
+    return 2.0 * floats * sizeof(float) / (best_ms * 1e6);
+}
+
+static void writeCounters(JsonWriter& json, const StepCounters& c) {
+    json.member("runs", c.runs).member("flops", c.flops).member("bytes", c.bytes).member("weight_bytes", c.weight_bytes)
+        .member("ms", c.ms / max(1, c.runs)).member("gflops_per_s", c.gflops()).member("intensity", c.intensity());
+    if (c.sample.has(PerfEvent::Cycles)) {
+        json.key("per_run").beginObject();
+        for (size_t e = 0; e < num_perf_events; e++) {
+            if (c.sample.valid[e]) json.member(PerfCounters::eventName(static_cast<PerfEvent>(e)), static_cast<double>(c.sample.counts[e]) / c.runs);
+        }
+        json.endObject();
+        if (c.sample.has(PerfEvent::Instructions)) {
+            json.member("ipc", static_cast<double>(c.sample.get(PerfEvent::Instructions)) / max<uint64_t>(1, c.sample.get(PerfEvent::Cycles)));
+        }
+        if (c.sample.has(PerfEvent::LlcMisses)) {
+            json.member("dram_intensity", c.dramIntensity())
+                .member("dram_gb_per_s", c.ms > 0 ? static_cast<double>(c.sample.get(PerfEvent::LlcMisses)) * 64 / (c.ms * 1e6) : 0);
+        }
+    }
+}
+
+static void benchCounters(const BenchConfig& config, JsonWriter& json) {
+    PerfCounters counters;
+    json.member("counters_available", counters.available());
+    if (!counters.available()) {
+        json.member("counters_error", counters.getError());
+        cerr << "Hardware counters unavailable (" << counters.getError() << "), timing only" << endl;
+    }
+
+    // Keyed by kind and width (and output width, for stitch layers)
+    map<tuple<StepKind, int, int>, StepCounters> by_shape;
+    json.key("stitches").beginArray();
+    for (int stitch_id : config.stitch_ids) {
+        cerr << "Stitch " << stitch_id << "..." << endl;
+        StitchPlan plan(stitch_id);
+        const vector<PlanStep>& steps = plan.getSteps();
+        InferenceEngine engine(engineOptions(config, 1));
+        engine.preload(plan);
+        InferenceContext context;
+        vector<float> logits(out_numClasses);
+
+        json.beginObject().member("stitch_id", stitch_id).key("steps").beginArray();
+        for (size_t s = 0; s < steps.size(); s++) {
+            const PlanStep& step = steps[s];
+            StepCounters c;
+            c.flops = CostTable::stepFlops(step);
+            c.bytes = CostTable::stepBytes(step);
+            c.weight_bytes = CostTable::stepWeightBytes(step);
+            // Activations do not matter to the counts; the buffers are reused as they are
+            for (int i = 0; i < config.warmup; i++) engine.runSteps(plan, s, s + 1, context.ping, context.pong, logits.data());
+            for (int i = 0; i < config.iterations; i++) {
+                auto start = chrono::steady_clock::now();
+                counters.start();
+                engine.runSteps(plan, s, s + 1, context.ping, context.pong, logits.data());
+                c.sample += counters.stop();
+                c.ms += msSince(start);
+                c.runs++;
+            }
+            const int width = stepWidth(step);
+            const int width_out = step.kind == StepKind::Stitch ? static_cast<int>(step.output_shape.back()) : width;
+            json.beginObject().member("step", static_cast<uint64_t>(s)).member("model", step.model_name)
+                .member("kind", PlanStep::kindName(step.kind)).member("width", width);
+            if (width_out != width) json.member("width_out", width_out);
+            writeCounters(json, c);
+            json.endObject();
+            by_shape[make_tuple(step.kind, width, width_out)] += c;
+        }
+        json.endArray().endObject();
+    }
+    json.endArray();
+
+    /* Roofline: a step left of the ridge point cannot reach the compute peak however good its kernels */
+    double peak_gflops = config.peak_gflops, peak_gbs = config.peak_gbs;
+    const bool estimated = peak_gflops <= 0 || peak_gbs <= 0;
+    if (peak_gflops <= 0) {
+        for (const auto& entry : by_shape) peak_gflops = max(peak_gflops, entry.second.gflops());
+    }
+    if (peak_gbs <= 0) peak_gbs = copyBandwidth();
+    const double ridge = peak_gflops / peak_gbs;
+    json.key("roofline").beginObject().member("peak_gflops_per_s", peak_gflops).member("peak_gb_per_s", peak_gbs)
+        .member("ridge_intensity", ridge).member("estimated", estimated).endObject();
+
+    cerr << "kind\twidth\tGFLOP/s\tFLOP/B\tDRAM FLOP/B\tIPC\tLLC MPKI\tbound" << endl;
+    json.key("by_shape").beginArray();
+    for (const auto& entry : by_shape) {
+        const StepCounters& c = entry.second;
+        const StepKind kind = get<0>(entry.first);
+        const int width = get<1>(entry.first), width_out = get<2>(entry.first);
+        // Measured DRAM traffic when there is a count: weights that stay cached make the model pessimistic
+        const double intensity = c.dramIntensity() > 0 ? c.dramIntensity() : c.intensity();
+        const char* bound = intensity < ridge ? "memory" : "compute";
+        json.beginObject().member("kind", PlanStep::kindName(kind)).member("width", width);
+        if (width_out != width) json.member("width_out", width_out);
+        writeCounters(json, c);
+        json.member("bound", bound).endObject();
+
+        const uint64_t instructions = c.sample.get(PerfEvent::Instructions);
+        cerr << PlanStep::kindName(kind) << "\t" << width;
+        if (width_out != width) cerr << ">" << width_out;
+        cerr << "\t" << c.gflops() << "\t" << c.intensity() << "\t";
+        if (c.sample.has(PerfEvent::LlcMisses)) cerr << c.dramIntensity();
+        else cerr << "-";
+        cerr << "\t";
+        if (c.sample.has(PerfEvent::Instructions)) cerr << static_cast<double>(instructions) / max<uint64_t>(1, c.sample.get(PerfEvent::Cycles));
+        else cerr << "-";
+        cerr << "\t";
+        if (c.sample.has(PerfEvent::LlcMisses) && instructions > 0) cerr << 1000.0 * c.sample.get(PerfEvent::LlcMisses) / instructions;
+        else cerr << "-";
+        cerr << "\t" << bound << endl;
+    }
+    json.endArray();
+    json.member("peak_rss_bytes", static_cast<uint64_t>(ResourceUsage::current().peak_rss_bytes));
+}
+
+// Parses a "0-2,5" list option; on a bad one prints why and returns false, so the caller prints the usage
+static bool parseList(const char* option, const char* list, vector<int>& values) {
+    try {
+        values = NumaTopology::parseCpuList(list); // same syntax as CPU lists
+        return true;
+    } catch (const invalid_argument& e) {
+        cerr << option << ": " << e.what() << endl;
+        return false;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Emulation goes first: it must start before any thread does, and the defaults below use the CPUs it leaves
+    DeviceProfile device;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--emulate") != 0) continue;
+        try {
+            device = DeviceProfile::parse(argv[i + 1]);
+        } catch (const invalid_argument& e) {
+            cerr << e.what() << endl;
+            exit(1);
+        }
+    }
+    EmulationReport emulation;
+    if (!device.empty()) {
+        emulation = DeviceEmulation::apply(device);
+    }
+
+    BenchConfig config;
+    const int cores = static_cast<int>(max<size_t>(1, CpuAffinity::currentThread().size()));
+    config.threads = cores > 1 ? vector<int>{ 1, cores } : vector<int>{ 1 };
+    config.concurrency = config.threads;
+    for (int k = 1; k <= cores; k++) config.streams.push_back(k);
+    string output_path;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stitches") == 0 && i + 1 < argc && strcmp(argv[i + 1], "all") == 0) {
+            config.stitch_ids.clear();
+            for (int s = 0; s < num_stitch_ids; s++) config.stitch_ids.push_back(s);
+            i++;
+        } else if (strcmp(argv[i], "--stitches") == 0 && i + 1 < argc && parseList("--stitches", argv[i + 1], config.stitch_ids)) i++;
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) config.iterations = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) config.warmup = max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && parseList("--threads", argv[i + 1], config.threads)) i++;
+        else if (strcmp(argv[i], "--concurrency") == 0 && i + 1 < argc && parseList("--concurrency", argv[i + 1], config.concurrency)) i++;
+        else if (strcmp(argv[i], "--scaling") == 0) config.scaling = true;
+        else if (strcmp(argv[i], "--counters") == 0) config.counters = true;
+        else if (strcmp(argv[i], "--roofline") == 0 && i + 1 < argc) {
+            const char* peaks = argv[++i];
+            const char* comma = strchr(peaks, ',');
+            config.peak_gflops = atof(peaks);
+            config.peak_gbs = comma != nullptr ? atof(comma + 1) : 0;
+        }
+        else if (strcmp(argv[i], "--streams") == 0 && i + 1 < argc && parseList("--streams", argv[i + 1], config.streams)) i++;
+        else if (strcmp(argv[i], "--model-dir") == 0 && i + 1 < argc) config.model_dir = string(argv[++i]) + "/";
+        else if (strcmp(argv[i], "--packed") == 0 && i + 1 < argc) config.packed_dir = string(argv[++i]) + "/";
+        else if (strcmp(argv[i], "--budget-mb") == 0 && i + 1 < argc) config.memory_budget = static_cast<size_t>(atof(argv[++i]) * 1024 * 1024);
+        else if (strcmp(argv[i], "--emulate") == 0 && i + 1 < argc) ++i; // applied above
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) output_path = argv[++i];
+        else {
+            cerr << "Usage: " << argv[0] << " [--stitches <list | all>] [--iterations N] [--warmup W] [--threads <list>]"
+                 << " [--concurrency <list>] [--scaling [--streams <list>]] [--model-dir <dir>]"
+                 << " [--counters [--roofline <GFLOP/s>,<GB/s>]] [--packed <dir>]"
+                 << " [--budget-mb <MB>] [--emulate <device profile>] [--output <json>]" << endl;
+            exit(1);
+        }
+    }
+    for (int s : config.stitch_ids) {
+        if (s < 0 || s >= num_stitch_ids) {
+            cerr << "Stitch id out of range: " << s << endl;
+            exit(1);
+        }
+    }
+    if (config.stitch_ids.empty() || config.streams.empty() || *min_element(config.streams.begin(), config.streams.end()) < 1) {
+        cerr << "Need at least one stitch id, and at least one stream per scaling run" << endl;
+        exit(1);
+    }
+
+    ofstream output_file;
+    if (!output_path.empty()) {
+        output_file.open(output_path, ios::trunc);
+        if (!output_file) {
+            cerr << "Failed to open " << output_path << endl;
+            exit(1);
+        }
+    }
+    JsonWriter json(output_path.empty() ? cout : output_file);
+
+    char hostname[256] = "";
+    gethostname(hostname, sizeof(hostname) - 1);
+    json.beginObject();
+    json.key("host").beginObject().member("name", hostname).member("cpu", cpuModel()).member("cores", cores)
+        .member("ort_version", Ort::GetVersionString()).endObject();
+    json.key("build").beginObject().member("compiler", __VERSION__)
+#ifdef __OPTIMIZE__
+        .member("optimized", true)
+#else
+        .member("optimized", false)
+#endif
+        .endObject();
+    json.key("config").beginObject().member("iterations", config.iterations).member("warmup", config.warmup)
+        .member("memory_budget_bytes", static_cast<uint64_t>(config.memory_budget)).endObject();
+    if (!device.empty()) {
+        json.key("emulation").beginObject()
+            .member("cores", emulation.cores).member("memory_bytes", static_cast<uint64_t>(device.memory_bytes))
+            .member("memory_limit", emulation.memory_limit).member("duty_cycle", device.duty_cycle)
+            .member("duty_limit", emulation.duty_limit).member("storage_bytes_per_s", device.storage_bytes_per_s)
+            .endObject();
+        if (!emulation.cgroup.empty()) cerr << "Emulation cgroup (rmdir after the run): " << emulation.cgroup << endl;
+    }
+
+    // A fixed mid-gray image: every run does the same work, and no assets are needed
+    vector<float> image(in_numChannels * in_height * in_width, 0.5f);
+    if (config.scaling) {
+        try {
+            benchScaling(config, image, json);
+        } catch (const exception& e) {
+            cerr << "Scaling benchmark failed: " << e.what() << endl;
+            return 1;
+        }
+        json.member("peak_rss_bytes", static_cast<uint64_t>(ResourceUsage::current().peak_rss_bytes));
+        json.endObject();
+        return 0;
+    }
+    if (config.counters) {
+        try {
+            benchCounters(config, json);
+        } catch (const exception& e) {
+            cerr << "Counter benchmark failed: " << e.what() << endl;
+            return 1;
+        }
+        json.endObject();
+        return 0;
+    }
+
+    json.key("stitches").beginArray();
+    for (int stitch_id : config.stitch_ids) {
+        cerr << "Stitch " << stitch_id << "..." << endl;
+        try {
+            benchStitch(config, stitch_id, image, json);
+        } catch (const exception& e) {
+            // A partial report would diff as if the stitch got faster, so there is none
+            cerr << "Stitch " << stitch_id << " failed: " << e.what() << endl;
+            return 1;
+        }
+    }
+    json.endArray();
+    json.member("peak_rss_bytes", static_cast<uint64_t>(ResourceUsage::current().peak_rss_bytes));
+    json.endObject();
+    return 0;
+}
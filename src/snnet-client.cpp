@@ -0,0 +1,141 @@
+/* Load-test client for snnet-onnx --serve
+ * Usage: snnet-client [--unix <path> | --tcp <port>] [--requests N] [--concurrency C]
+ *                     [--stitch S | --budget <ms>] [--top-k K] [--image <file>]
+ * Each of C connections sends requests one after another (closed loop) until N
+ * have been sent in total, and the end-to-end latency percentiles, throughput and
+ * the server's inference time are printed.
+ *   --unix         server socket (default /tmp/snnet.sock)
+ *   --tcp          loopback TCP port instead
+ *   --stitch       stitch id (default 0); --budget asks the server to pick one for a latency budget
+ *   --top-k        ask for the top K classes instead of all logits
+ *   --image        send this encoded image; default: a random preprocessed tensor
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "client_socket.h"
+#include "constants.h"
+#include "server_protocol.h"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    string unix_path = "/tmp/snnet.sock", image_path;
+    int tcp_port = 0, stitch_id = 0, top_k = 0;
+    long requests = 1000;
+    int concurrency = 1;
+    float budget_ms = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--unix") == 0 && i + 1 < argc) unix_path = argv[++i];
+        else if (strcmp(argv[i], "--tcp") == 0 && i + 1 < argc) tcp_port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) requests = max(1L, atol(argv[++i]));
+        else if (strcmp(argv[i], "--concurrency") == 0 && i + 1 < argc) concurrency = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--stitch") == 0 && i + 1 < argc) stitch_id = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) budget_ms = static_cast<float>(atof(argv[++i])), stitch_id = -1;
+        else if (strcmp(argv[i], "--top-k") == 0 && i + 1 < argc) top_k = min(255, max(0, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) image_path = argv[++i];
+        else {
+            cerr << "Usage: " << argv[0] << " [--unix <path> | --tcp <port>] [--requests N] [--concurrency C]"
+                 << " [--stitch S | --budget <ms>] [--top-k K] [--image <file>]" << endl;
+            exit(1);
+        }
+    }
+
+    vector<char> payload;
+    PayloadKind kind = PayloadKind::Tensor;
+    if (!image_path.empty()) {
+        ifstream file(image_path, ios::binary);
+        payload.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        if (payload.empty()) {
+            cerr << "Failed to read image: " << image_path << endl;
+            exit(1);
+        }
+        kind = PayloadKind::EncodedImage;
+    } else {
+        vector<float> tensor(in_numChannels * in_height * in_width);
+        mt19937 rng(42);
+        uniform_real_distribution<float> pixel(0.0f, 1.0f);
+        for (float& v : tensor) v = pixel(rng);
+        payload.resize(tensor.size() * sizeof(float));
+        memcpy(payload.data(), tensor.data(), payload.size());
+    }
+
+    atomic<long> next{ 0 };
+    atomic<long> errors{ 0 };
+    vector<vector<double>> latencies(concurrency);
+    vector<double> server_ms(concurrency);
+    auto start = chrono::steady_clock::now();
+    vector<thread> clients;
+    for (int c = 0; c < concurrency; c++) {
+        clients.emplace_back([&, c] {
+            int fd = ClientSocket::connectTo(unix_path, tcp_port);
+            if (fd < 0) {
+                cerr << "Cannot connect to " << (tcp_port > 0 ? "port " + to_string(tcp_port) : unix_path) << endl;
+                errors += 1;
+                return;
+            }
+            vector<char> response;
+            for (long id; (id = next++) < requests;) {
+                RequestHeader header{ request_magic, static_cast<uint32_t>(payload.size()), static_cast<uint32_t>(id),
+                                      static_cast<uint8_t>(kind), static_cast<uint8_t>(top_k), 0, stitch_id, budget_ms };
+                auto sent = chrono::steady_clock::now();
+                ResponseHeader reply;
+                if (!ClientSocket::sendAll(fd, &header, sizeof(header)) ||
+                    !ClientSocket::sendAll(fd, payload.data(), payload.size()) ||
+                    !ClientSocket::receiveAll(fd, &reply, sizeof(reply)) || reply.magic != response_magic) {
+                    cerr << "Connection lost" << endl;
+                    errors += 1;
+                    break;
+                }
+                response.resize(reply.length);
+                if (!ClientSocket::receiveAll(fd, response.data(), response.size())) {
+                    errors += 1;
+                    break;
+                }
+                latencies[c].push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - sent).count());
+                if (reply.status != static_cast<int32_t>(ResponseStatus::Ok)) {
+                    if (errors++ == 0) cerr << "Request failed: " << string(response.begin(), response.end()) << endl;
+                } else {
+                    server_ms[c] += reply.latency_ms;
+                }
+            }
+            close(fd);
+        });
+    }
+    for (thread& client : clients) client.join();
+    double elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<double> all;
+    double server_total = 0;
+    for (int c = 0; c < concurrency; c++) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        server_total += server_ms[c];
+    }
+    if (all.empty()) {
+        cerr << "No responses" << endl;
+        return 1;
+    }
+    sort(all.begin(), all.end());
+    auto percentile = [&](double p) { return all[min(all.size() - 1, static_cast<size_t>(p * all.size()))]; };
+    long ok = static_cast<long>(all.size()) - errors.load();
+    cout << fixed << setprecision(3);
+    cout << all.size() << " responses, " << errors.load() << " errors, " << all.size() / elapsed_s << " requests/s" << endl;
+    cout << "Latency ms: p50 " << percentile(0.50) << ", p90 " << percentile(0.90) << ", p99 " << percentile(0.99)
+         << ", max " << all.back() << endl;
+    if (ok > 0) cout << "Server inference ms (mean): " << server_total / ok << endl;
+    return errors.load() > 0 ? 2 : 0;
+}
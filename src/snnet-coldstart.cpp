@@ -0,0 +1,320 @@
+/* Cold-start profiler
+ * Usage: snnet-coldstart [--stitch S] [--model-dir <dir>] [--image <file>] [--repeat R] [--drop-caches]
+ *                        [--output <json>]
+ * Breaks the time to first inference of a stitch plan into phases, per model of the plan:
+ *   file_io            reading the .onnx, with its pages evicted from the page cache (cold) and again (warm)
+ *   proto_parse        one pass over the protobuf wire format (OnnxProto), a lower bound of ORT's parse
+ *   session_minimal    ORT session from the bytes with graph optimization and prepacking off:
+ *                      parse, graph resolution, kernel creation, initializer copies
+ *   graph_optimization extra time of ORT_ENABLE_ALL
+ *   prepacking         extra time of weight prepacking
+ *   first_run          first Run minus a warm Run: arena growth and lazy kernel setup
+ * and once: env creation (the first in the process), image decode (cold and warm), and end to end,
+ * a fresh engine's first inference with cold and with warm model files. Session timings are the
+ * fastest of --repeat (default 3), from bytes already in memory, on one intra-op thread.
+ * Pages are evicted with posix_fadvise(DONTNEED), which needs no privileges; each model row reports
+ * the share of its file still resident after that. With --drop-caches (root only), the whole page
+ * cache is dropped first as well. Per-model table on stderr, JSON on stdout or to --output.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <onnxruntime_cxx_api.h>
+#include <onnxruntime_session_options_config_keys.h>
+
+#include "constants.h"
+#include "image_loader.h"
+#include "inference_engine.h"
+#include "json_writer.h"
+#include "onnx_proto.h"
+#include "stitch_plan.h"
+
+using namespace std;
+
+struct ModelPhases {
+    string model_name;
+    size_t file_bytes = 0;
+    double resident_after_evict = 0;    // share of the file's pages still cached
+    double file_io_cold_ms = 0, file_io_warm_ms = 0;
+    double proto_parse_ms = 0;
+    double session_minimal_ms = 0, graph_optimization_ms = 0, prepacking_ms = 0;
+    double first_run_ms = 0, warm_run_ms = 0;
+};
+
+static double msSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Evicts the file's clean pages from the page cache. Needs no privileges.
+static bool evictFromPageCache(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+}
+
+// Share of the file's pages in the page cache, 0..1
+static double residentShare(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return 0;
+    }
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    vector<unsigned char> pages((st.st_size + page - 1) / page);
+    size_t resident = 0;
+    if (mincore(addr, st.st_size, pages.data()) == 0) {
+        for (unsigned char p : pages) resident += p & 1;
+    }
+    munmap(addr, st.st_size);
+    return pages.empty() ? 0 : static_cast<double>(resident) / pages.size();
+}
+
+// Drops the whole page cache; only root may.
+static bool dropPageCache() {
+    sync();
+    ofstream drop("/proc/sys/vm/drop_caches");
+    drop << "1" << endl;
+    return static_cast<bool>(drop);
+}
+
+static string readFile(const string& path) {
+    ifstream file(path, ios::binary);
+    string bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    if (bytes.empty()) {
+        throw runtime_error("Failed to read " + path);
+    }
+    return bytes;
+}
+
+static Ort::SessionOptions sessionOptions(GraphOptimizationLevel level, bool prepacking) {
+    Ort::SessionOptions options;
+    options.SetIntraOpNumThreads(1);
+    options.SetGraphOptimizationLevel(level);
+    if (!prepacking) {
+        options.AddConfigEntry(kOrtSessionOptionsConfigDisablePrepacking, "1");
+    }
+    return options;
+}
+
+// Fastest of `repeat` session creations from `model`
+static double sessionMs(const Ort::Env& env, const string& model, const Ort::SessionOptions& options, int repeat) {
+    double best = 0;
+    for (int i = 0; i < repeat; i++) {
+        auto start = chrono::steady_clock::now();
+        Ort::Session session(env, model.data(), model.size(), options);
+        double ms = msSince(start);
+        best = i == 0 ? ms : min(best, ms);
+    }
+    return best;
+}
+
+// Times the first and a second Run on zero inputs
+static void timeRuns(Ort::Session& session, ModelPhases& phases) {
+    Ort::AllocatorWithDefaultOptions allocator;
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    vector<Ort::AllocatedStringPtr> name_holders;
+    vector<const char*> input_names, output_names;
+    vector<vector<float>> buffers;
+    vector<Ort::Value> inputs;
+    for (size_t i = 0; i < session.GetInputCount(); i++) {
+        name_holders.push_back(session.GetInputNameAllocated(i, allocator));
+        input_names.push_back(name_holders.back().get());
+        Ort::TypeInfo type = session.GetInputTypeInfo(i);
+        auto tensor = type.GetTensorTypeAndShapeInfo();
+        if (tensor.GetElementType() != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+            throw runtime_error(phases.model_name + ": only float inputs are supported");
+        }
+        vector<int64_t> shape = tensor.GetShape();
+        size_t elements = 1;
+        for (int64_t& d : shape) {
+            d = max<int64_t>(d, 1); // symbolic dims: batch 1
+            elements *= static_cast<size_t>(d);
+        }
+        buffers.emplace_back(elements, 0.0f);
+        inputs.push_back(Ort::Value::CreateTensor<float>(memory_info, buffers.back().data(), elements, shape.data(), shape.size()));
+    }
+    for (size_t i = 0; i < session.GetOutputCount(); i++) {
+        name_holders.push_back(session.GetOutputNameAllocated(i, allocator));
+        output_names.push_back(name_holders.back().get());
+    }
+    for (double* ms : { &phases.first_run_ms, &phases.warm_run_ms }) {
+        auto start = chrono::steady_clock::now();
+        session.Run(Ort::RunOptions{ nullptr }, input_names.data(), inputs.data(), inputs.size(),
+                    output_names.data(), output_names.size());
+        *ms = msSince(start);
+    }
+}
+
+static ModelPhases profileModel(const Ort::Env& env, const string& model_dir, const string& model_name, int repeat) {
+    ModelPhases phases;
+    phases.model_name = model_name;
+    const string path = model_dir + model_name + ".onnx";
+
+    evictFromPageCache(path);
+    phases.resident_after_evict = residentShare(path);
+    auto start = chrono::steady_clock::now();
+    string model = readFile(path);
+    phases.file_io_cold_ms = msSince(start);
+    phases.file_bytes = model.size();
+    start = chrono::steady_clock::now();
+    readFile(path);
+    phases.file_io_warm_ms = msSince(start);
+
+    start = chrono::steady_clock::now();
+    OnnxProto::readInitializers(model);
+    phases.proto_parse_ms = msSince(start);
+
+    double minimal = sessionMs(env, model, sessionOptions(ORT_DISABLE_ALL, false), repeat);
+    double optimized = sessionMs(env, model, sessionOptions(ORT_ENABLE_ALL, false), repeat);
+    double full = sessionMs(env, model, sessionOptions(ORT_ENABLE_ALL, true), repeat);
+    phases.session_minimal_ms = minimal;
+    phases.graph_optimization_ms = max(0.0, optimized - minimal);
+    phases.prepacking_ms = max(0.0, full - optimized);
+
+    Ort::Session session(env, model.data(), model.size(), sessionOptions(ORT_ENABLE_ALL, true));
+    timeRuns(session, phases);
+    return phases;
+}
+
+// A fresh engine's first inference of `plan`, from construction to logits
+static double firstInferenceMs(const string& model_dir, const StitchPlan& plan, const vector<float>& image) {
+    EngineOptions options;
+    options.model_dir = model_dir;
+    options.packed_dir = "";    // the phases are measured on the .onnx files
+    options.shared_thread_pools = false;
+    options.env_allocator = EnvAllocator::None;
+    auto start = chrono::steady_clock::now();
+    InferenceEngine engine(options);
+    InferenceContext context;
+    vector<float> logits(out_numClasses);
+    engine.run(plan, image.data(), logits.data(), context);
+    return msSince(start);
+}
+
+int main(int argc, char* argv[]) {
+    int stitch_id = 0, repeat = 3;
+    bool drop_caches = false;
+    string model_dir = "./pretrained/onnx/", image_path = string("./assets/") + image_name, output_path;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stitch") == 0 && i + 1 < argc) stitch_id = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--model-dir") == 0 && i + 1 < argc) model_dir = string(argv[++i]) + "/";
+        else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) image_path = argv[++i];
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--drop-caches") == 0) drop_caches = true;
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) output_path = argv[++i];
+        else {
+            cerr << "Usage: " << argv[0] << " [--stitch S] [--model-dir <dir>] [--image <file>] [--repeat R]"
+                 << " [--drop-caches] [--output <json>]" << endl;
+            exit(1);
+        }
+    }
+    if (stitch_id < 0 || stitch_id >= num_stitch_ids) {
+        cerr << "Stitch id out of range: " << stitch_id << endl;
+        exit(1);
+    }
+
+    bool dropped = false;
+    if (drop_caches) {
+        dropped = dropPageCache();
+        if (!dropped) cerr << "Cannot drop the page cache (needs root); evicting the model files only" << endl;
+    }
+
+    try {
+        // The env is a process singleton: this first one pays for ORT's own initialization
+        auto start = chrono::steady_clock::now();
+        Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "snnet-coldstart");
+        const double env_ms = msSince(start);
+
+        StitchPlan plan(stitch_id);
+        vector<string> model_names = plan.getModelNames();
+        vector<ModelPhases> models;
+        for (const string& model_name : model_names) {
+            cerr << "Profiling " << model_name << "..." << endl;
+            models.push_back(profileModel(env, model_dir, model_name, repeat));
+        }
+
+        // Without the image, decode times are null and a mid-gray image is inferred
+        vector<float> image(in_numChannels * in_height * in_width, 0.5f);
+        double decode_cold_ms = nan(""), decode_warm_ms = nan("");
+        if (access(image_path.c_str(), R_OK) == 0) {
+            evictFromPageCache(image_path);
+            start = chrono::steady_clock::now();
+            image = ImageHelpers::loadImage(image_path);
+            decode_cold_ms = msSince(start);
+            start = chrono::steady_clock::now();
+            ImageHelpers::loadImage(image_path);
+            decode_warm_ms = msSince(start);
+        }
+
+        for (const string& model_name : model_names) evictFromPageCache(model_dir + model_name + ".onnx");
+        const double first_inference_cold_ms = firstInferenceMs(model_dir, plan, image);
+        const double first_inference_warm_ms = firstInferenceMs(model_dir, plan, image);
+
+        /* Per-model table */
+        cerr << left << setw(40) << "model" << right << setw(9) << "io cold" << setw(9) << "io warm" << setw(9) << "parse"
+             << setw(9) << "session" << setw(9) << "optimize" << setw(9) << "prepack" << setw(10) << "1st run" << setw(9) << "run"
+             << setw(10) << "resident" << endl;
+        cerr << fixed << setprecision(2);
+        for (const ModelPhases& m : models) {
+            cerr << left << setw(40) << m.model_name << right << setw(9) << m.file_io_cold_ms << setw(9) << m.file_io_warm_ms
+                 << setw(9) << m.proto_parse_ms << setw(9) << m.session_minimal_ms << setw(9) << m.graph_optimization_ms
+                 << setw(9) << m.prepacking_ms << setw(10) << m.first_run_ms << setw(9) << m.warm_run_ms
+                 << setw(9) << m.resident_after_evict * 100 << "%" << endl;
+        }
+        cerr << "Env " << env_ms << " ms, image decode " << decode_cold_ms << " / " << decode_warm_ms
+             << " ms, first inference " << first_inference_cold_ms << " ms cold, " << first_inference_warm_ms << " ms warm" << endl;
+
+        ofstream output_file;
+        if (!output_path.empty()) {
+            output_file.open(output_path, ios::trunc);
+        }
+        JsonWriter json(output_path.empty() ? cout : output_file);
+        json.beginObject().member("stitch_id", stitch_id).member("repeat", repeat).member("page_cache_dropped", dropped)
+            .member("ort_version", Ort::GetVersionString()).member("env_ms", env_ms)
+            .member("image_decode_cold_ms", decode_cold_ms).member("image_decode_warm_ms", decode_warm_ms)
+            .member("first_inference_cold_ms", first_inference_cold_ms)
+            .member("first_inference_warm_ms", first_inference_warm_ms);
+        json.key("models").beginArray();
+        for (const ModelPhases& m : models) {
+            json.beginObject().member("model", m.model_name).member("file_bytes", static_cast<uint64_t>(m.file_bytes))
+                .member("resident_after_evict", m.resident_after_evict)
+                .member("file_io_cold_ms", m.file_io_cold_ms).member("file_io_warm_ms", m.file_io_warm_ms)
+                .member("proto_parse_ms", m.proto_parse_ms).member("session_minimal_ms", m.session_minimal_ms)
+                .member("graph_optimization_ms", m.graph_optimization_ms).member("prepacking_ms", m.prepacking_ms)
+                .member("first_run_ms", m.first_run_ms).member("warm_run_ms", m.warm_run_ms)
+                .member("first_run_extra_ms", max(0.0, m.first_run_ms - m.warm_run_ms))
+                .endObject();
+        }
+        json.endArray().endObject();
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
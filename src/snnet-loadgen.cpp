@@ -0,0 +1,456 @@
+/* Open-loop load generator
+ * Usage: snnet-loadgen [--in-process | --unix <path> | --tcp <port>] [--rates <list>] [--duration S]
+ *                      [--arrivals uniform|poisson|bursty] [--burst B] [--trace <file>] [--speed X]
+ *                      [--stitch S | --budget <ms>] [--images <list>] [--timeout-ms T] [--max-outstanding N]
+ *                      [--warmup-s W] [--connections C] [--threads T] [--model-dir <dir>] [--packed <dir>]
+ *                      [--record <file>] [--seed N] [--output <json>]
+ * Requests are sent when they are due, whether or not earlier ones have finished, and latency is
+ * measured from when a request was due rather than from when it could be sent, so a saturated
+ * target shows up as growing latency instead of as a slower sender. For every offered rate: latency
+ * percentiles, achieved rate, drops (more than N requests outstanding), timeouts, errors and how
+ * often each stitch id ran, which shows the choices of the budget controller. The saturation knee
+ * is the highest rate served at 95% with under 1% of requests lost.
+ *   --in-process       run an InferenceEngine in this process (submit()) instead of talking to --serve
+ *   --unix, --tcp      server socket (default /tmp/snnet.sock)
+ *   --rates            offered requests/s, one run each, e.g. 5,10,20,40 (default 10)
+ *   --duration         seconds per run (default 10)
+ *   --arrivals         gaps between requests (default poisson); bursty: bursts of --burst (default 8)
+ *   --trace            replay "<ms> <stitch id> <image id>" lines instead, --speed times faster
+ *   --stitch, --budget stitch id of generated requests (default 0), or -1 with a latency budget
+ *   --images           file with one encoded image path per line, picked by image id; default: a random tensor
+ *   --timeout-ms       later responses count as timeouts (default 1000)
+ *   --warmup-s         requests due in the first W seconds are not counted (default 1)
+ *   --connections      sockets to the server (default 4)
+ *   --threads          intra-op threads of the in-process engine (default 2, the minimum for RunAsync)
+ *   --record           save the generated arrivals as a trace (suffixed with the rate if several)
+ *   --output           JSON report (default: stdout); a table goes to stderr
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "client_socket.h"
+#include "constants.h"
+#include "image_loader.h"
+#include "inference_engine.h"
+#include "json_writer.h"
+#include "latency_stats.h"
+#include "load_schedule.h"
+#include "server_protocol.h"
+#include "stitch_plan.h"
+#include "stitch_selector.h"
+
+using namespace std;
+
+struct LoadConfig {
+    bool in_process = false;
+    string unix_path = "/tmp/snnet.sock";
+    int tcp_port = 0, connections = 4;
+    float budget_ms = 0;
+    double timeout_ms = 1000, warmup_ms = 1000;
+    long max_outstanding = 1024;
+};
+
+/* Outcome of every request of one run; completions may come from any thread */
+class LoadRun {
+private:
+    const vector<Arrival>& arrivals;
+    const LoadConfig& config;
+    chrono::steady_clock::time_point start;
+
+    mutex m;
+    condition_variable finished;
+    long outstanding = 0;
+    vector<bool> pending;   // by request id: admitted, not finished
+    vector<double> latencies;
+    map<int, uint64_t> stitches;
+    uint64_t completed = 0, dropped = 0, timeouts = 0, errors = 0;
+
+    bool counted(uint32_t id) const {
+        return arrivals[id].at_ms >= config.warmup_ms;
+    }
+
+public:
+    LoadRun(const vector<Arrival>& arrivals, const LoadConfig& config)
+        : arrivals(arrivals), config(config), start(chrono::steady_clock::now()), pending(arrivals.size()) {}
+
+    chrono::steady_clock::time_point due(uint32_t id) const {
+        return start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(arrivals[id].at_ms));
+    }
+
+    // False if too many requests are outstanding: the request is dropped.
+    bool admit(uint32_t id) {
+        lock_guard<mutex> lock(m);
+        if (outstanding >= config.max_outstanding) {
+            if (counted(id)) dropped++;
+            return false;
+        }
+        outstanding++;
+        pending[id] = true;
+        return true;
+    }
+
+    void finish(uint32_t id, int stitch_id, bool ok) {
+        double latency_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - due(id)).count();
+        lock_guard<mutex> lock(m);
+        if (counted(id)) {
+            if (!ok) {
+                errors++;
+            } else if (latency_ms > config.timeout_ms) {
+                timeouts++;
+            } else {
+                completed++;
+                latencies.push_back(latency_ms);
+            }
+            if (ok) stitches[stitch_id]++;
+        }
+        pending[id] = false;
+        if (--outstanding == 0) finished.notify_all();
+    }
+
+    // Waits for the outstanding requests until `deadline`; returns how many are still outstanding.
+    long wait(chrono::steady_clock::time_point deadline) {
+        unique_lock<mutex> lock(m);
+        finished.wait_until(lock, deadline, [&] { return outstanding == 0; });
+        return outstanding;
+    }
+
+    // Requests never answered count as timeouts. Call once the target has ended, so that
+    // a late answer is counted by finish() or here, never both.
+    void abandon() {
+        lock_guard<mutex> lock(m);
+        for (uint32_t id = 0; id < pending.size(); id++) {
+            if (pending[id] && counted(id)) timeouts++;
+        }
+    }
+
+    // Writes the results and returns whether the target kept up: 95% of the offered rate served,
+    // under 1% of the requests lost.
+    bool report(JsonWriter& json, double offered_rate) {
+        lock_guard<mutex> lock(m);
+        uint64_t measured = count_if(arrivals.begin(), arrivals.end(), [&](const Arrival& a) { return a.at_ms >= config.warmup_ms; });
+        double span_s = arrivals.empty() ? 0 : (arrivals.back().at_ms - max(config.warmup_ms, arrivals.front().at_ms)) / 1000;
+        double achieved = span_s > 0 ? completed / span_s : 0;
+        LatencySummary latency = LatencySummary::of(latencies);
+        json.beginObject()
+            .member("offered_rate", offered_rate).member("achieved_rate", achieved)
+            .member("requests", measured).member("completed", completed).member("dropped", dropped)
+            .member("timeouts", timeouts).member("errors", errors);
+        json.key("latency_ms").beginObject()
+            .member("count", static_cast<uint64_t>(latency.count)).member("mean", latency.mean).member("min", latency.min)
+            .member("p50", latency.p50).member("p90", latency.p90).member("p99", latency.p99).member("max", latency.max)
+            .endObject();
+        json.key("stitches").beginObject();
+        for (const auto& entry : stitches) json.member(to_string(entry.first), entry.second);
+        json.endObject().endObject();
+
+        cerr << fixed << setprecision(1) << setw(10) << offered_rate << setw(10) << achieved << setw(10) << latency.p50
+             << setw(10) << latency.p99 << setw(8) << dropped << setw(8) << timeouts << setw(8) << errors << endl;
+        return span_s > 0 && achieved >= 0.95 * offered_rate && dropped + timeouts + errors <= measured / 100;
+    }
+};
+
+/* Where requests go: the engine in this process or a server */
+class LoadTarget {
+public:
+    virtual ~LoadTarget() = default;
+    virtual void begin(LoadRun& run) = 0;
+    virtual void send(uint32_t id, const Arrival& arrival) = 0;
+    // Called once no more requests will be sent; the target must not touch `run` afterwards.
+    virtual void end() = 0;
+};
+
+class EngineTarget : public LoadTarget {
+private:
+    InferenceEngine& engine;
+    const vector<vector<float>>& images;
+    float budget_ms;
+    StitchSelector selector;
+    LoadRun* run = nullptr;
+
+public:
+    EngineTarget(InferenceEngine& engine, const vector<vector<float>>& images, float budget_ms)
+        : engine(engine), images(images), budget_ms(budget_ms) {}
+
+    void begin(LoadRun& load_run) override {
+        run = &load_run;
+    }
+
+    void send(uint32_t id, const Arrival& arrival) override {
+        const int stitch_id = arrival.stitch_id >= 0 ? arrival.stitch_id : selector.choose(budget_ms);
+        auto sent = chrono::steady_clock::now();
+        LoadRun* load_run = run;
+        try {
+            engine.submit(images[arrival.image_id % images.size()], stitch_id,
+                          [this, load_run, id, stitch_id, sent](vector<float>, exception_ptr error) {
+                              selector.observe(stitch_id, chrono::duration<double, milli>(chrono::steady_clock::now() - sent).count());
+                              load_run->finish(id, stitch_id, !error);
+                          });
+        } catch (const exception&) {
+            load_run->finish(id, stitch_id, false);
+        }
+    }
+
+    void end() override {
+        // Submitted requests cannot be cancelled: runLoad() has waited for all of them
+        run = nullptr;
+    }
+};
+
+/* Pipelines requests over a few connections; one receiving thread per connection */
+class SocketTarget : public LoadTarget {
+private:
+    const LoadConfig& config;
+    const vector<vector<char>>& payloads;
+    PayloadKind kind;
+    vector<int> fds;
+    vector<thread> receivers;
+    size_t next = 0;
+    LoadRun* run = nullptr;
+
+    void receive(int fd) {
+        vector<char> payload;
+        ResponseHeader reply;
+        while (ClientSocket::receiveAll(fd, &reply, sizeof(reply)) && reply.magic == response_magic) {
+            payload.resize(reply.length);
+            if (!ClientSocket::receiveAll(fd, payload.data(), payload.size())) {
+                break;
+            }
+            run->finish(reply.request_id, reply.stitch_id, reply.status == static_cast<int32_t>(ResponseStatus::Ok));
+        }
+    }
+
+public:
+    SocketTarget(const LoadConfig& config, const vector<vector<char>>& payloads, PayloadKind kind)
+        : config(config), payloads(payloads), kind(kind) {}
+
+    void begin(LoadRun& load_run) override {
+        run = &load_run;
+        for (int c = 0; c < config.connections; c++) {
+            int fd = ClientSocket::connectTo(config.unix_path, config.tcp_port);
+            if (fd < 0) {
+                end();
+                throw runtime_error("Cannot connect to " + (config.tcp_port > 0 ? "port " + to_string(config.tcp_port) : config.unix_path));
+            }
+            fds.push_back(fd);
+            receivers.emplace_back(&SocketTarget::receive, this, fd);
+        }
+    }
+
+    void send(uint32_t id, const Arrival& arrival) override {
+        const vector<char>& payload = payloads[arrival.image_id % payloads.size()];
+        // Top 5 only: the full logits would be most of the response traffic
+        RequestHeader header{ request_magic, static_cast<uint32_t>(payload.size()), id, static_cast<uint8_t>(kind), 5, 0,
+                              arrival.stitch_id, config.budget_ms };
+        int fd = fds[next++ % fds.size()];
+        // A full socket buffer blocks here; the delay still counts, since latency runs from the due time
+        if (!ClientSocket::sendAll(fd, &header, sizeof(header)) || !ClientSocket::sendAll(fd, payload.data(), payload.size())) {
+            run->finish(id, arrival.stitch_id, false);
+        }
+    }
+
+    void end() override {
+        for (int fd : fds) shutdown(fd, SHUT_RDWR);
+        for (thread& receiver : receivers) receiver.join();
+        for (int fd : fds) close(fd);
+        fds.clear();
+        receivers.clear();
+        run = nullptr;
+    }
+};
+
+static bool runLoad(const LoadSchedule& schedule, const LoadConfig& config, LoadTarget& target, double offered_rate,
+                    JsonWriter& json) {
+    const vector<Arrival>& arrivals = schedule.getArrivals();
+    LoadRun run(arrivals, config);
+    target.begin(run);
+    for (uint32_t id = 0; id < arrivals.size(); id++) {
+        this_thread::sleep_until(run.due(id));
+        if (run.admit(id)) target.send(id, arrivals[id]);
+    }
+    auto deadline = arrivals.empty() ? chrono::steady_clock::now() : run.due(static_cast<uint32_t>(arrivals.size() - 1));
+    run.wait(deadline + chrono::milliseconds(static_cast<long>(config.timeout_ms)));
+    if (config.in_process) {
+        run.wait(chrono::steady_clock::time_point::max());
+    }
+    target.end();
+    run.abandon();
+    return run.report(json, offered_rate);
+}
+
+static vector<double> parseRates(const string& list) {
+    vector<double> rates;
+    stringstream stream(list);
+    for (string item; getline(stream, item, ',');) {
+        double rate = atof(item.c_str());
+        if (rate <= 0) throw invalid_argument("Invalid rate: " + item);
+        rates.push_back(rate);
+    }
+    return rates;
+}
+
+static vector<vector<char>> readImages(const string& list_path) {
+    vector<vector<char>> images;
+    ifstream list(list_path);
+    if (!list) throw runtime_error("Failed to open image list: " + list_path);
+    for (string path; getline(list, path);) {
+        if (path.empty()) continue;
+        ifstream file(path, ios::binary);
+        vector<char> bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (bytes.empty()) throw runtime_error("Failed to read image: " + path);
+        images.push_back(move(bytes));
+    }
+    if (images.empty()) throw runtime_error("No images in " + list_path);
+    return images;
+}
+
+int main(int argc, char* argv[]) {
+    LoadConfig config;
+    vector<double> rates = { 10 };
+    double duration_s = 10, speed = 1;
+    ArrivalPattern pattern = ArrivalPattern::Poisson;
+    int burst = 8, stitch_id = 0, threads = 2;
+    uint32_t seed = 1;
+    string trace_path, images_path, record_path, output_path;
+    string model_dir = "./pretrained/onnx/", packed_dir = "./pretrained/packed/";
+    try {
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--in-process") == 0) config.in_process = true;
+            else if (strcmp(argv[i], "--unix") == 0 && i + 1 < argc) config.unix_path = argv[++i];
+            else if (strcmp(argv[i], "--tcp") == 0 && i + 1 < argc) config.tcp_port = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--rates") == 0 && i + 1 < argc) rates = parseRates(argv[++i]);
+            else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) duration_s = atof(argv[++i]);
+            else if (strcmp(argv[i], "--arrivals") == 0 && i + 1 < argc) pattern = LoadSchedule::parsePattern(argv[++i]);
+            else if (strcmp(argv[i], "--burst") == 0 && i + 1 < argc) burst = max(1, atoi(argv[++i]));
+            else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) trace_path = argv[++i];
+            else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) speed = atof(argv[++i]);
+            else if (strcmp(argv[i], "--stitch") == 0 && i + 1 < argc) stitch_id = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) config.budget_ms = static_cast<float>(atof(argv[++i])), stitch_id = -1;
+            else if (strcmp(argv[i], "--images") == 0 && i + 1 < argc) images_path = argv[++i];
+            else if (strcmp(argv[i], "--timeout-ms") == 0 && i + 1 < argc) config.timeout_ms = max(1.0, atof(argv[++i]));
+            else if (strcmp(argv[i], "--max-outstanding") == 0 && i + 1 < argc) config.max_outstanding = max(1L, atol(argv[++i]));
+            else if (strcmp(argv[i], "--warmup-s") == 0 && i + 1 < argc) config.warmup_ms = max(0.0, atof(argv[++i])) * 1000;
+            else if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) config.connections = max(1, atoi(argv[++i]));
+            else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = max(2, atoi(argv[++i]));
+            else if (strcmp(argv[i], "--model-dir") == 0 && i + 1 < argc) model_dir = string(argv[++i]) + "/";
+            else if (strcmp(argv[i], "--packed") == 0 && i + 1 < argc) packed_dir = string(argv[++i]) + "/";
+            else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) record_path = argv[++i];
+            else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = static_cast<uint32_t>(atol(argv[++i]));
+            else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) output_path = argv[++i];
+            else {
+                cerr << "Usage: " << argv[0] << " [--in-process | --unix <path> | --tcp <port>] [--rates <list>] [--duration S]"
+                     << " [--arrivals uniform|poisson|bursty] [--burst B] [--trace <file>] [--speed X]"
+                     << " [--stitch S | --budget <ms>] [--images <list>] [--timeout-ms T] [--max-outstanding N]"
+                     << " [--warmup-s W] [--connections C] [--threads T] [--model-dir <dir>] [--packed <dir>]"
+                     << " [--record <file>] [--seed N] [--output <json>]" << endl;
+                exit(1);
+            }
+        }
+        if (stitch_id >= num_stitch_ids) throw invalid_argument("Stitch id out of range: " + to_string(stitch_id));
+
+        /* The schedules: one per rate, or the trace */
+        vector<pair<double, LoadSchedule>> runs;
+        vector<vector<char>> encoded = images_path.empty() ? vector<vector<char>>() : readImages(images_path);
+        const int num_images = encoded.empty() ? 1 : static_cast<int>(encoded.size());
+        if (!trace_path.empty()) {
+            LoadSchedule schedule = LoadSchedule::load(trace_path);
+            schedule.scale(speed);
+            runs.emplace_back(schedule.offeredRate(), schedule);
+        } else {
+            for (double rate : rates) {
+                runs.emplace_back(rate, LoadSchedule::generate(pattern, rate, duration_s, stitch_id, num_images, burst, seed));
+                if (!record_path.empty()) {
+                    runs.back().second.save(rates.size() > 1 ? record_path + "." + to_string(static_cast<long>(rate)) : record_path);
+                }
+            }
+        }
+
+        /* The target */
+        unique_ptr<InferenceEngine> engine;
+        vector<vector<float>> tensors;
+        vector<vector<char>> payloads;
+        unique_ptr<LoadTarget> target;
+        if (config.in_process) {
+            for (const vector<char>& bytes : encoded) {
+                tensors.push_back(ImageHelpers::decodeImage(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size()));
+                if (tensors.back().empty()) throw runtime_error("Cannot decode image " + to_string(tensors.size() - 1));
+            }
+            if (tensors.empty()) {
+                tensors.emplace_back(in_numChannels * in_height * in_width);
+                mt19937 rng(42);
+                uniform_real_distribution<float> pixel(0.0f, 1.0f);
+                for (float& v : tensors.back()) v = pixel(rng);
+            }
+            EngineOptions options;
+            options.model_dir = model_dir;
+            options.packed_dir = packed_dir;
+            options.intra_op_threads = threads;
+            engine = make_unique<InferenceEngine>(options);
+            // Loads stay out of the measurements: every stitch id the runs may use is loaded up front
+            vector<bool> used(num_stitch_ids);
+            for (const auto& run : runs) {
+                for (const Arrival& arrival : run.second.getArrivals()) {
+                    if (arrival.stitch_id < 0) fill(used.begin(), used.end(), true);
+                    else if (arrival.stitch_id < num_stitch_ids) used[arrival.stitch_id] = true;
+                }
+            }
+            for (int s = 0; s < num_stitch_ids; s++) {
+                if (used[s]) engine->preload(StitchPlan(s));
+            }
+            target = make_unique<EngineTarget>(*engine, tensors, config.budget_ms);
+        } else {
+            PayloadKind kind = PayloadKind::EncodedImage;
+            payloads = move(encoded);
+            if (payloads.empty()) {
+                vector<float> tensor(in_numChannels * in_height * in_width);
+                mt19937 rng(42);
+                uniform_real_distribution<float> pixel(0.0f, 1.0f);
+                for (float& v : tensor) v = pixel(rng);
+                payloads.emplace_back(reinterpret_cast<const char*>(tensor.data()), reinterpret_cast<const char*>(tensor.data() + tensor.size()));
+                kind = PayloadKind::Tensor;
+            }
+            target = make_unique<SocketTarget>(config, payloads, kind);
+        }
+
+        ofstream output_file;
+        if (!output_path.empty()) {
+            output_file.open(output_path, ios::trunc);
+        }
+        JsonWriter json(output_path.empty() ? cout : output_file);
+        json.beginObject()
+            .member("target", config.in_process ? string("in-process") : config.tcp_port > 0 ? "tcp:" + to_string(config.tcp_port) : config.unix_path)
+            .member("arrivals", trace_path.empty() ? (pattern == ArrivalPattern::Uniform ? "uniform" : pattern == ArrivalPattern::Poisson ? "poisson" : "bursty") : "trace")
+            .member("timeout_ms", config.timeout_ms).member("max_outstanding", static_cast<int64_t>(config.max_outstanding));
+        json.key("runs").beginArray();
+        cerr << "   offered  achieved   p50(ms)   p99(ms) dropped timeout  errors" << endl;
+        double knee = 0;
+        for (auto& run : runs) {
+            if (runLoad(run.second, config, *target, run.first, json)) knee = max(knee, run.first);
+        }
+        json.endArray().member("saturation_rate", knee).endObject();
+        cerr << "Saturation knee: " << (knee > 0 ? to_string(knee) + " requests/s" : "below the lowest rate") << endl;
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
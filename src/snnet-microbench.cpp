@@ -0,0 +1,323 @@
+/* Microbenchmarks of the code around ORT
+ * Usage: snnet-microbench [--filter <text>] [--min-time-ms T] [--workers W] [--image <file>] [--json <file>]
+ * Times the glue that runs on every request even though ORT dominates end-to-end time:
+ *   image       ImageHelpers stages: decode, BGR to RGB, resize, HWC bytes to CHW floats, all together
+ *   config      StitchConfig construction and lookups, StitchPlan construction
+ *   handoff     tensors over the ping/pong activation buffers for every step of a plan
+ *   logits      argmax and top-5 over 1000 logits
+ *   ort         MemoryInfo::CreateCpu and CreateTensor over an existing buffer
+ *   executor    RequestExecutor queues: MPMC push/pop, deque push/pop, steal, submit, nested submit
+ *   trace       one trace event, and one timestamp (no-ops unless built with SNNET_TRACING)
+ *   metrics     one always-on step latency recording, and a Prometheus export
+ * Each benchmark runs for at least --min-time-ms (default 200) and reports ns/op, and the heap
+ * bytes and allocations per op (every malloc-family call in the process during the run, counted
+ * by AllocCounter, which this binary is always built with).
+ *   --filter   only benchmarks whose name contains this
+ *   --workers  executor workers (default: cores)
+ *   --image    encoded image to decode (default: ./assets/ goldfish, else a generated JPEG)
+ *   --json     also write the results as JSON
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "alloc_counter.h"
+#include "constants.h"
+#include "image_loader.h"
+#include "inference_engine.h"
+#include "json_writer.h"
+#include "logits.h"
+#include "metrics.h"
+#include "mpmc_queue.h"
+#include "request_executor.h"
+#include "stitch_config.h"
+#include "stitch_plan.h"
+#include "trace.h"
+#include "work_stealing_deque.h"
+
+using namespace std;
+
+namespace {
+
+struct BenchResult {
+    string name;
+    double ns_per_op, bytes_per_op, allocations_per_op;
+};
+
+string filter;
+double min_time_ns = 200e6;
+vector<BenchResult> results;
+
+// Keeps the compiler from dropping a computation whose result is unused
+template <typename T>
+void keep(T&& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// `body(n)` runs n ops; n grows until one call takes at least min_time_ns
+template <typename F>
+void bench(const string& name, F&& body) {
+    if (!filter.empty() && name.find(filter) == string::npos) {
+        return;
+    }
+    body(1L); // warm up caches, lazy initialization and the allocator
+    for (long n = 1;;) {
+        uint64_t allocations = AllocCounter::count(), bytes = AllocCounter::bytes();
+        auto start = chrono::steady_clock::now();
+        body(n);
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        if (ns >= min_time_ns || n >= (1L << 32)) {
+            BenchResult r{ name, ns / n, double(AllocCounter::bytes() - bytes) / n, double(AllocCounter::count() - allocations) / n };
+            cout << left << setw(24) << r.name << right << fixed << setprecision(1) << setw(14) << r.ns_per_op
+                 << setw(14) << r.bytes_per_op << setw(12) << setprecision(2) << r.allocations_per_op << endl;
+            results.push_back(r);
+            return;
+        }
+        n = max(n * 2, min(n * 100, static_cast<long>(n * min_time_ns / max(ns, 1.0) * 1.2)));
+    }
+}
+
+vector<unsigned char> encodedImage(const string& path) {
+    ifstream file(path, ios::binary);
+    vector<unsigned char> bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    if (bytes.empty()) { // no assets: a gradient of typical ImageNet size
+        cv::Mat image(375, 500, CV_8UC3);
+        for (int y = 0; y < image.rows; y++) {
+            for (int x = 0; x < image.cols; x++) image.at<cv::Vec3b>(y, x) = cv::Vec3b(x % 256, y % 256, (x + y) % 256);
+        }
+        cv::imencode(".jpg", image, bytes);
+    }
+    return bytes;
+}
+
+void imageBenchmarks(const string& path) {
+    const vector<unsigned char> encoded = encodedImage(path);
+    const cv::Mat encoded_mat(1, static_cast<int>(encoded.size()), CV_8UC1, const_cast<unsigned char*>(encoded.data()));
+    const cv::Mat bgr = cv::imdecode(encoded_mat, cv::IMREAD_COLOR);
+    const cv::Mat rgb = ImageHelpers::toRgb(bgr);
+    const cv::Mat resized = ImageHelpers::resize(rgb, in_width, in_height);
+
+    bench("image/decode", [&](long n) {
+        for (long i = 0; i < n; i++) keep(cv::imdecode(encoded_mat, cv::IMREAD_COLOR));
+    });
+    bench("image/to_rgb", [&](long n) {
+        for (long i = 0; i < n; i++) keep(ImageHelpers::toRgb(bgr));
+    });
+    bench("image/resize", [&](long n) {
+        for (long i = 0; i < n; i++) keep(ImageHelpers::resize(rgb, in_width, in_height));
+    });
+    bench("image/to_chw", [&](long n) {
+        for (long i = 0; i < n; i++) keep(ImageHelpers::toCHW(resized));
+    });
+    bench("image/decode_image", [&](long n) {
+        for (long i = 0; i < n; i++) keep(ImageHelpers::decodeImage(encoded.data(), encoded.size()));
+    });
+}
+
+void configBenchmarks() {
+    const StitchConfig config(vit_depth, 2, 1);
+    bench("config/stitch_config", [&](long n) {
+        for (long i = 0; i < n; i++) keep(StitchConfig(vit_depth, 2, 1));
+    });
+    bench("config/get_stitch_config", [&](long n) {
+        for (long i = 0; i < n; i++) keep(config.getStitchConfig(static_cast<int>(i % config.getNumStitches())));
+    });
+    bench("config/layer_mappings", [&](long n) {
+        for (long i = 0; i < n; i++) keep(config.getLayerMappings());
+    });
+    bench("config/stitch_plan", [&](long n) {
+        for (long i = 0; i < n; i++) keep(StitchPlan(static_cast<int>(i % num_stitch_ids)));
+    });
+}
+
+void handoffBenchmark() {
+    // What runSteps does around each Run: tensors over the context's buffers, then swap them
+    const StitchPlan plan(20);
+    const Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    InferenceContext context;
+    vector<float> logits(out_numClasses);
+    bench("handoff", [&](long n) {
+        for (long i = 0; i < n; i++) {
+            float* input = context.ping;
+            float* output = context.pong;
+            for (const PlanStep& step : plan.getSteps()) {
+                float* step_output = &step == &plan.getSteps().back() ? logits.data() : output;
+                Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
+                    memory_info, input, step.inputElements(), step.input_shape.data(), step.input_shape.size());
+                Ort::Value output_tensor = Ort::Value::CreateTensor<float>(
+                    memory_info, step_output, step.outputElements(), step.output_shape.data(), step.output_shape.size());
+                keep(input_tensor);
+                keep(output_tensor);
+                swap(input, output);
+            }
+        }
+    });
+}
+
+void logitsBenchmarks() {
+    vector<float> logits(out_numClasses);
+    mt19937 rng(7);
+    normal_distribution<float> value(0.0f, 3.0f);
+    for (float& v : logits) v = value(rng);
+    bench("logits/argmax", [&](long n) {
+        for (long i = 0; i < n; i++) keep(Logits::argmax(logits.data(), logits.size()));
+    });
+    bench("logits/top5", [&](long n) {
+        for (long i = 0; i < n; i++) keep(Logits::topK(logits.data(), logits.size(), 5));
+    });
+}
+
+void ortBenchmarks() {
+    bench("ort/memory_info", [&](long n) {
+        for (long i = 0; i < n; i++) keep(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault));
+    });
+    const Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    vector<float> buffer(tr_height * tr_width_b);
+    const vector<int64_t> shape = { 1, tr_height, tr_width_b };
+    bench("ort/create_tensor", [&](long n) {
+        for (long i = 0; i < n; i++) {
+            keep(Ort::Value::CreateTensor<float>(memory_info, buffer.data(), buffer.size(), shape.data(), shape.size()));
+        }
+    });
+}
+
+struct EmptyTask : ExecutorTask {
+    void run() override {}
+};
+
+// Submits the next link of the chain from the worker running this one
+struct ChainTask : ExecutorTask {
+    RequestExecutor* executor;
+    long remaining;
+
+    void run() override {
+        if (--remaining > 0) executor->submit(this);
+    }
+};
+
+void executorBenchmarks(size_t workers) {
+    EmptyTask task;
+    MpmcQueue<ExecutorTask*> queue(1024);
+    bench("executor/mpmc", [&](long n) {
+        ExecutorTask* popped;
+        for (long i = 0; i < n; i++) {
+            queue.tryPush(&task);
+            queue.tryPop(popped);
+        }
+    });
+
+    WorkStealingDeque<ExecutorTask> deque(1024);
+    bench("executor/deque", [&](long n) {
+        for (long i = 0; i < n; i++) {
+            deque.push(&task);
+            keep(deque.pop());
+        }
+    });
+    bench("executor/steal", [&](long n) {
+        atomic<long> stolen{ 0 };
+        thread thief([&] {
+            while (stolen.load(memory_order_relaxed) < n) {
+                if (deque.steal() != nullptr) stolen.fetch_add(1, memory_order_relaxed);
+                else this_thread::yield();
+            }
+        });
+        for (long pushed = 0; pushed < n;) {
+            if (deque.push(&task)) ++pushed;
+            else this_thread::yield(); // full: let the thief catch up
+        }
+        thief.join();
+    });
+
+    RequestExecutor executor(workers);
+    bench("executor/submit", [&](long n) {
+        for (long i = 0; i < n; i++) executor.submit(&task);
+        executor.waitIdle();
+    });
+    // One chain per worker, so every worker is busy and stealing is rare
+    vector<ChainTask> chains(executor.getNumWorkers());
+    bench("executor/nested_submit", [&](long n) {
+        const long links = max(1L, n / static_cast<long>(chains.size()));
+        for (ChainTask& chain : chains) {
+            chain.executor = &executor;
+            chain.remaining = links;
+        }
+        for (ChainTask& chain : chains) executor.submit(&chain);
+        executor.waitIdle();
+    });
+}
+
+void traceBenchmarks() {
+    bench("trace/scope", [&](long n) {
+        for (long i = 0; i < n; i++) {
+            SNNET_TRACE_SCOPE_ARG("step", "layer", i);
+        }
+    });
+    bench("trace/now", [&](long n) {
+        for (long i = 0; i < n; i++) keep(SNNET_TRACE_NOW());
+    });
+}
+
+void metricsBenchmarks() {
+    Metrics& metrics = Metrics::global();
+    bench("metrics/record_step", [&](long n) {
+        for (long i = 0; i < n; i++) metrics.recordStep(3, static_cast<size_t>(i) % 15, 800 + (i & 1023));
+    });
+    bench("metrics/export", [&](long n) {
+        for (long i = 0; i < n; i++) keep(metrics.prometheusText());
+    });
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t workers = max(1u, thread::hardware_concurrency());
+    string image_path = string("./assets/") + image_name, json_path;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if (strcmp(argv[i], "--min-time-ms") == 0 && i + 1 < argc) min_time_ns = max(1.0, atof(argv[++i])) * 1e6;
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) workers = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) image_path = argv[++i];
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) json_path = argv[++i];
+        else {
+            cerr << "Usage: " << argv[0] << " [--filter <text>] [--min-time-ms T] [--workers W] [--image <file>] [--json <file>]" << endl;
+            exit(1);
+        }
+    }
+
+    cout << left << setw(24) << "benchmark" << right << setw(14) << "ns/op" << setw(14) << "bytes/op" << setw(12) << "allocs/op" << endl;
+    imageBenchmarks(image_path);
+    configBenchmarks();
+    handoffBenchmark();
+    logitsBenchmarks();
+    ortBenchmarks();
+    executorBenchmarks(workers);
+    traceBenchmarks();
+    metricsBenchmarks();
+
+    if (!json_path.empty()) {
+        ofstream file(json_path, ios::trunc);
+        JsonWriter json(file);
+        json.beginArray();
+        for (const BenchResult& r : results) {
+            json.beginObject().member("name", r.name).member("ns_per_op", r.ns_per_op).member("bytes_per_op", r.bytes_per_op)
+                .member("allocations_per_op", r.allocations_per_op).endObject();
+        }
+        json.endArray();
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+/* Offline packer for the flat weight store and the model bundle
+ * Usage: snnet-pack [--bundle [--inline-weights]] <model dir> <output dir>
+ * Moves the initializers of every .onnx model in <model dir> into "<output dir>/weights.snw"
+ * and writes the rewritten models, which reference it as external data, next to it.
+ *   --bundle          write the rewritten models into "<output dir>/models.snb" instead
+ *   --inline-weights  keep the weights inside the bundled models (no weight store)
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "model_bundle.h"
+#include "weight_store.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+int main(int argc, char* argv[]) {
+    bool bundle = false, inline_weights = false;
+    vector<const char*> args;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bundle") == 0) bundle = true;
+        else if (strcmp(argv[i], "--inline-weights") == 0) inline_weights = true;
+        else args.push_back(argv[i]);
+    }
+    if (args.size() != 2 || (inline_weights && !bundle)) {
+        cerr << "Usage: " << argv[0] << " [--bundle [--inline-weights]] <model dir> <output dir>" << endl;
+        exit(1);
+    }
+    const fs::path model_dir = args[0];
+    const fs::path output_dir = args[1];
+
+    vector<fs::path> model_paths;
+    for (const auto& entry : fs::directory_iterator(model_dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".onnx") {
+            model_paths.push_back(entry.path());
+        }
+    }
+    sort(model_paths.begin(), model_paths.end());
+    if (model_paths.empty()) {
+        cerr << "No .onnx models found in " << model_dir << endl;
+        return 1;
+    }
+
+    try {
+        fs::create_directories(output_dir);
+        unique_ptr<WeightStoreWriter> weights;
+        unique_ptr<ModelBundleWriter> models;
+        if (!inline_weights) weights = make_unique<WeightStoreWriter>((output_dir / weight_store_file).string());
+        if (bundle) models = make_unique<ModelBundleWriter>((output_dir / model_bundle_file).string());
+
+        for (const fs::path& path : model_paths) {
+            ifstream in(path, ios::binary);
+            stringstream buffer;
+            buffer << in.rdbuf();
+
+            string model_name = path.stem().string();
+            string model = weights ? weights->addModel(model_name, buffer.str()) : buffer.str();
+
+            if (models) {
+                models->addModel(model_name, model);
+            } else {
+                ofstream out(output_dir / path.filename(), ios::binary | ios::trunc);
+                out.write(model.data(), model.size());
+                if (!out) {
+                    cerr << "Cannot write " << (output_dir / path.filename()) << endl;
+                    return 1;
+                }
+            }
+            cout << "Packed " << model_name << " (" << buffer.str().size() << " -> " << model.size() << " bytes)" << endl;
+        }
+
+        if (weights) {
+            uint64_t blob_size = weights->finish();
+            cout << "Wrote " << (output_dir / weight_store_file) << " (" << blob_size << " bytes, "
+                 << model_paths.size() << " models)" << endl;
+        }
+        if (models) {
+            uint64_t bundle_size = models->finish();
+            cout << "Wrote " << (output_dir / model_bundle_file) << " (" << bundle_size << " bytes, "
+                 << model_paths.size() << " models)" << endl;
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,324 @@
+/* Operator-level profile of stitch plans, merged across their layer sessions
+ * Usage: snnet-profile [--stitches <list | all>] [--iterations N] [--warmup W] [--threads T] [--top K]
+ *                      [--model-dir <dir>] [--packed <dir>] [--profile-dir <dir>] [--output <json>]
+ * ORT profiles each session on its own, so one inference of a stitch leaves its ~15 sessions'
+ * events in ~15 files. For every stitch id, with a fresh engine, this turns on profiling for
+ * every session of the plan (through the factory's session tuner), runs W warmup and N timed
+ * inferences, ends profiling and merges the kernel events of the timed runs from all the files.
+ * Kernel time per inference is then aggregated and ranked:
+ *   ops        per op type as ORT ran it after graph optimization (MatMul, FusedMatMul, Softmax,
+ *              LayerNormalization, Gelu, ...)
+ *   op_widths  per op type, layer kind and token width, e.g. MatMul in the 384-wide layers
+ *   steps      per plan step; "other" is the step's run time outside kernels (executor overhead)
+ * and once more over all the stitch ids profiled, as the mean per inference of that mix, which
+ * points at the fusions or native kernels that would pay off across the stitch space.
+ * Top K (default 10) rows per table on stderr, everything in the JSON report.
+ *   --threads      intra-op threads (default 1, so kernel times add up to the run time)
+ *   --profile-dir  where ORT writes its files, kept (default: a temporary directory, removed)
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "constants.h"
+#include "inference_engine.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "numa_topology.h"
+#include "stitch_plan.h"
+
+using namespace std;
+
+struct ProfileConfig {
+    vector<int> stitch_ids = { 0, 1, 2, 20, 50 };
+    int iterations = 20, warmup = 3, threads = 1;
+    size_t top = 10;
+    string model_dir = "./pretrained/onnx/", packed_dir = "./pretrained/packed/";
+    string profile_dir;
+};
+
+struct OpTime {
+    double us = 0;
+    uint64_t calls = 0;
+
+    void add(double kernel_us, uint64_t n = 1) {
+        us += kernel_us;
+        calls += n;
+    }
+};
+
+using OpWidthKey = tuple<string, string, int64_t>;   // op type, layer kind, width
+
+struct StepTime {
+    string model_name;
+    const char* kind;
+    int64_t width;
+    double run_us = 0, kernel_us = 0;
+};
+
+struct StitchProfile {
+    int stitch_id;
+    map<string, OpTime> ops;
+    map<OpWidthKey, OpTime> op_widths;
+    vector<StepTime> steps;
+    double kernel_us = 0, run_us = 0;
+};
+
+/* Kernel events of the timed runs in one session's profile file, added to `profile`.
+ * Each inference is one "model_run" event of the session; kernel events ("<node>_kernel_time")
+ * belong to the run they fall in, and those of the first `warmup` runs are skipped. */
+static void mergeProfile(const string& path, int warmup, StepTime& step, StitchProfile& profile) {
+    JsonValue events = JsonValue::parseFile(path);
+    if (events.isObject()) events = events["traceEvents"];
+
+    vector<pair<double, double>> runs;  // [ts, ts + dur] in us since the session's profiling start
+    for (const JsonValue& e : events.getElements()) {
+        if (e["cat"].asString() == "Session" && e["name"].asString() == "model_run") {
+            runs.emplace_back(e["ts"].asNumber(), e["ts"].asNumber() + e["dur"].asNumber());
+        }
+    }
+    sort(runs.begin(), runs.end());
+    auto timedRun = [&](double ts) {
+        auto run = upper_bound(runs.begin(), runs.end(), make_pair(ts, 1e300));
+        return run != runs.begin() && ts <= prev(run)->second && prev(run) - runs.begin() >= warmup;
+    };
+    for (size_t r = warmup; r < runs.size(); r++) step.run_us += runs[r].second - runs[r].first;
+
+    static const string kernel_suffix = "_kernel_time";
+    for (const JsonValue& e : events.getElements()) {
+        const string& name = e["name"].asString();
+        if (e["cat"].asString() != "Node" || name.size() < kernel_suffix.size() ||
+            name.compare(name.size() - kernel_suffix.size(), kernel_suffix.size(), kernel_suffix) != 0 || !timedRun(e["ts"].asNumber())) {
+            continue;
+        }
+        string op = e["args"]["op_name"].asString();
+        if (op.empty()) op = "unknown";
+        const double dur = e["dur"].asNumber();
+        step.kernel_us += dur;
+        profile.ops[op].add(dur);
+        profile.op_widths[OpWidthKey(op, step.kind, step.width)].add(dur);
+    }
+    profile.kernel_us += step.kernel_us;
+    profile.run_us += step.run_us;
+}
+
+static StitchProfile profileStitch(const ProfileConfig& config, int stitch_id, const string& profile_dir, const vector<float>& image) {
+    StitchPlan plan(stitch_id);
+    const vector<PlanStep>& plan_steps = plan.getSteps();
+
+    EngineOptions options;
+    options.model_dir = config.model_dir;
+    options.packed_dir = config.packed_dir;
+    options.intra_op_threads = config.threads;
+    options.shared_thread_pools = false; // the env is a process singleton: its global pools would keep the first thread count
+    InferenceEngine engine(options);
+    // One file prefix per model: ORT names files by prefix and the second they were started in
+    const string prefix = profile_dir + "/s" + to_string(stitch_id) + "_";
+    engine.getSessionFactory().setSessionTuner([&](const string& model_name, Ort::SessionOptions& session_options) {
+        session_options.EnableProfiling((prefix + model_name).c_str());
+    });
+    engine.preload(plan);
+
+    InferenceContext context;
+    vector<float> logits(out_numClasses);
+    for (int i = 0; i < config.warmup + config.iterations; i++) {
+        engine.run(plan, image.data(), logits.data(), context);
+    }
+
+    StitchProfile profile;
+    profile.stitch_id = stitch_id;
+    Ort::AllocatorWithDefaultOptions allocator;
+    for (const PlanStep& plan_step : plan_steps) {
+        StepTime step{ plan_step.model_name, PlanStep::kindName(plan_step.kind), StitchPlan::modelWidth(plan_step.model_name) };
+        shared_ptr<Ort::Session> session = engine.getSessionCache().get(plan_step.model_name);
+        Ort::AllocatedStringPtr path = session->EndProfilingAllocated(allocator);
+        mergeProfile(path.get(), config.warmup, step, profile);
+        if (config.profile_dir.empty()) filesystem::remove(path.get());
+        profile.steps.push_back(step);
+    }
+    return profile;
+}
+
+template <typename Key>
+static vector<pair<Key, OpTime>> ranked(const map<Key, OpTime>& times) {
+    vector<pair<Key, OpTime>> rows(times.begin(), times.end());
+    sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.second.us > b.second.us; });
+    return rows;
+}
+
+static string opWidthName(const OpWidthKey& key) {
+    return get<0>(key) + " " + get<1>(key) + "/" + to_string(get<2>(key));
+}
+
+/* Per inference: `runs` inferences (or stitch ids times inferences for the mix) went into the times */
+static void writeTables(JsonWriter& json, const map<string, OpTime>& ops, const map<OpWidthKey, OpTime>& op_widths,
+                        double kernel_us, double runs) {
+    json.key("ops").beginArray();
+    for (const auto& [op, time] : ranked(ops)) {
+        json.beginObject().member("op", op).member("ms", time.us / runs / 1000).member("share", time.us / kernel_us)
+            .member("calls", time.calls / runs).member("us_per_call", time.us / time.calls).endObject();
+    }
+    json.endArray();
+    json.key("op_widths").beginArray();
+    for (const auto& [key, time] : ranked(op_widths)) {
+        json.beginObject().member("op", get<0>(key)).member("kind", get<1>(key)).member("width", get<2>(key))
+            .member("ms", time.us / runs / 1000).member("share", time.us / kernel_us)
+            .member("calls", time.calls / runs).member("us_per_call", time.us / time.calls).endObject();
+    }
+    json.endArray();
+}
+
+template <typename Key>
+static void printRanking(const char* title, const map<Key, OpTime>& times, double kernel_us, double runs, size_t top,
+                         string (*name)(const Key&)) {
+    cerr << "  " << title << endl;
+    size_t rank = 0;
+    for (const auto& [key, time] : ranked(times)) {
+        if (rank++ == top) break;
+        cerr << "    " << setw(2) << rank << "  " << left << setw(32) << name(key) << right << fixed << setprecision(3)
+             << setw(9) << time.us / runs / 1000 << " ms" << setprecision(1) << setw(7) << 100 * time.us / kernel_us << " %"
+             << setw(8) << time.calls / runs << " calls" << setw(9) << time.us / time.calls << " us/call" << endl;
+    }
+}
+
+static string opName(const string& op) {
+    return op;
+}
+
+// Parses a "0-2,5" list option; on a bad one prints why and returns false, so the caller prints the usage
+static bool parseList(const char* option, const char* list, vector<int>& values) {
+    try {
+        values = NumaTopology::parseCpuList(list); // same syntax as CPU lists
+        return true;
+    } catch (const invalid_argument& e) {
+        cerr << option << ": " << e.what() << endl;
+        return false;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    ProfileConfig config;
+    string output_path;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stitches") == 0 && i + 1 < argc && strcmp(argv[i + 1], "all") == 0) {
+            config.stitch_ids.clear();
+            for (int s = 0; s < num_stitch_ids; s++) config.stitch_ids.push_back(s);
+            i++;
+        } else if (strcmp(argv[i], "--stitches") == 0 && i + 1 < argc && parseList("--stitches", argv[i + 1], config.stitch_ids)) i++;
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) config.iterations = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) config.warmup = max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) config.threads = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) config.top = static_cast<size_t>(max(1, atoi(argv[++i])));
+        else if (strcmp(argv[i], "--model-dir") == 0 && i + 1 < argc) config.model_dir = string(argv[++i]) + "/";
+        else if (strcmp(argv[i], "--packed") == 0 && i + 1 < argc) config.packed_dir = string(argv[++i]) + "/";
+        else if (strcmp(argv[i], "--profile-dir") == 0 && i + 1 < argc) config.profile_dir = argv[++i];
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) output_path = argv[++i];
+        else {
+            cerr << "Usage: " << argv[0] << " [--stitches <list | all>] [--iterations N] [--warmup W] [--threads T] [--top K]"
+                 << " [--model-dir <dir>] [--packed <dir>] [--profile-dir <dir>] [--output <json>]" << endl;
+            exit(1);
+        }
+    }
+    for (int s : config.stitch_ids) {
+        if (s < 0 || s >= num_stitch_ids) {
+            cerr << "Stitch id out of range: " << s << endl;
+            exit(1);
+        }
+    }
+
+    string profile_dir = config.profile_dir;
+    if (profile_dir.empty()) {
+        string pattern = (filesystem::temp_directory_path() / "snnet-profile-XXXXXX").string();
+        if (mkdtemp(pattern.data()) == nullptr) {
+            cerr << "Cannot create a temporary directory" << endl;
+            exit(1);
+        }
+        profile_dir = pattern;
+    } else {
+        filesystem::create_directories(profile_dir);
+    }
+
+    ofstream output_file;
+    if (!output_path.empty()) {
+        output_file.open(output_path, ios::trunc);
+        if (!output_file) {
+            cerr << "Failed to open " << output_path << endl;
+            exit(1);
+        }
+    }
+    JsonWriter json(output_path.empty() ? cout : output_file);
+    json.beginObject();
+    json.key("config").beginObject().member("iterations", config.iterations).member("warmup", config.warmup)
+        .member("intra_op_threads", config.threads).member("ort_version", Ort::GetVersionString()).endObject();
+
+    // A fixed mid-gray image: every run does the same work, and no assets are needed
+    vector<float> image(in_numChannels * in_height * in_width, 0.5f);
+    map<string, OpTime> all_ops;
+    map<OpWidthKey, OpTime> all_op_widths;
+    double all_kernel_us = 0;
+    int profiled = 0;
+    json.key("stitches").beginArray();
+    for (int stitch_id : config.stitch_ids) {
+        StitchProfile profile;
+        try {
+            profile = profileStitch(config, stitch_id, profile_dir, image);
+        } catch (const exception& e) {
+            cerr << "Stitch " << stitch_id << " failed: " << e.what() << endl;
+            continue;
+        }
+        const double runs = config.iterations;
+        ++profiled;
+        for (const auto& [op, time] : profile.ops) all_ops[op].add(time.us, time.calls);
+        for (const auto& [key, time] : profile.op_widths) all_op_widths[key].add(time.us, time.calls);
+        all_kernel_us += profile.kernel_us;
+
+        json.beginObject().member("stitch_id", stitch_id).member("kernel_ms", profile.kernel_us / runs / 1000)
+            .member("run_ms", profile.run_us / runs / 1000);
+        writeTables(json, profile.ops, profile.op_widths, profile.kernel_us, runs);
+        json.key("steps").beginArray();
+        for (size_t s = 0; s < profile.steps.size(); s++) {
+            const StepTime& step = profile.steps[s];
+            json.beginObject().member("step", static_cast<uint64_t>(s)).member("model", step.model_name).member("kind", step.kind)
+                .member("width", step.width).member("kernel_ms", step.kernel_us / runs / 1000)
+                .member("other_ms", (step.run_us - step.kernel_us) / runs / 1000).endObject();
+        }
+        json.endArray().endObject();
+
+        cerr << "stitch " << stitch_id << ": " << fixed << setprecision(3) << profile.kernel_us / runs / 1000
+             << " ms in kernels, " << (profile.run_us - profile.kernel_us) / runs / 1000 << " ms other, per inference" << endl;
+        printRanking("ops", profile.ops, profile.kernel_us, runs, config.top, opName);
+        printRanking("op kind/width", profile.op_widths, profile.kernel_us, runs, config.top, opWidthName);
+    }
+    json.endArray();
+
+    if (profiled > 1) {
+        const double runs = static_cast<double>(profiled) * config.iterations;
+        json.key("mix").beginObject().member("stitches", profiled).member("kernel_ms", all_kernel_us / runs / 1000);
+        writeTables(json, all_ops, all_op_widths, all_kernel_us, runs);
+        json.endObject();
+        cerr << "all " << profiled << " stitches: " << fixed << setprecision(3) << all_kernel_us / runs / 1000
+             << " ms in kernels per inference" << endl;
+        printRanking("ops", all_ops, all_kernel_us, runs, config.top, opName);
+        printRanking("op kind/width", all_op_widths, all_kernel_us, runs, config.top, opWidthName);
+    }
+    json.endObject();
+
+    if (config.profile_dir.empty()) {
+        filesystem::remove_all(profile_dir);
+    } else {
+        cerr << "ORT profiles kept in " << profile_dir << endl;
+    }
+    return profiled == static_cast<int>(config.stitch_ids.size()) ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+/* Autotuner for per-session threading
+ * Usage: snnet-tune [--runs N] [--max-threads T] [--packed <dir>] [--report <csv>] <model dir> <tuning file>
+ * Times intra-op threads, spinning and execution mode on the first layer of each anchor,
+ * with one caller (latency) and one caller per core (throughput), and writes the best
+ * settings to <tuning file>. snnet-onnx applies them per session with --tuning <tuning file>.
+ *   --runs         timed runs per caller and setting (default 20)
+ *   --max-threads  largest intra-op thread count tried (default: cores)
+ *   --packed       snnet-pack output to load the models from, as snnet-onnx does
+ *   --report       also write every measurement as CSV
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "autotuner.h"
+
+using namespace std;
+
+static void printResult(ostream& out, const TuningResult& r) {
+    out << setw(6) << r.width << setw(8) << r.concurrency << setw(9) << r.config.intra_op_threads
+        << setw(6) << (r.config.allow_spinning ? "yes" : "no") << setw(12) << (r.config.parallel_execution ? "parallel" : "sequential")
+        << setw(12) << fixed << setprecision(3) << r.latency_ms << setw(12) << setprecision(1) << r.throughput << endl;
+}
+
+int main(int argc, char* argv[]) {
+    int runs = 20;
+    int max_threads = static_cast<int>(max(1u, thread::hardware_concurrency()));
+    string packed_dir, report_path;
+    vector<const char*> args;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) runs = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) max_threads = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--packed") == 0 && i + 1 < argc) packed_dir = string(argv[++i]) + "/";
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) report_path = argv[++i];
+        else args.push_back(argv[i]);
+    }
+    if (args.size() != 2) {
+        cerr << "Usage: " << argv[0] << " [--runs N] [--max-threads T] [--packed <dir>] [--report <csv>]"
+             << " <model dir> <tuning file>" << endl;
+        exit(1);
+    }
+    const string model_dir = string(args[0]) + "/";
+    const string tuning_path = args[1];
+
+    vector<int> concurrencies = { 1 };
+    int cores = static_cast<int>(thread::hardware_concurrency());
+    if (cores > 1) concurrencies.push_back(cores);
+
+    try {
+        Autotuner tuner(model_dir, packed_dir, runs);
+        cout << "Tuning " << Autotuner::candidates(max_threads).size() << " settings per width and caller count..." << endl;
+        TuningTable table = tuner.tune(concurrencies, max_threads);
+
+        const char* columns = " width callers  threads  spin        mode  latency ms  runs/s";
+        cout << "\nMeasured:\n" << columns << endl;
+        for (const TuningResult& r : tuner.getSamples()) printResult(cout, r);
+        cout << "\nBest:\n" << columns << endl;
+        for (const TuningResult& r : table.getResults()) printResult(cout, r);
+
+        table.save(tuning_path);
+        cout << "\nWrote " << tuning_path << " (" << TuningTable::hostTag() << ")" << endl;
+
+        if (!report_path.empty()) {
+            ofstream report(report_path);
+            report << "width,callers,intra_op_threads,allow_spinning,parallel_execution,latency_ms,runs_per_s\n";
+            for (const TuningResult& r : tuner.getSamples()) {
+                report << r.width << "," << r.concurrency << "," << r.config.intra_op_threads << "," << r.config.allow_spinning << ","
+                       << r.config.parallel_execution << "," << r.latency_ms << "," << r.throughput << "\n";
+            }
+        }
+    } catch (const Ort::Exception& e) {
+        cerr << "ONNX Runtime Error: " << e.what() << endl;
+        return 1;
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
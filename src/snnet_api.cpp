@@ -0,0 +1,267 @@
+#include "snnet.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "constants.h"
+#include "inference_engine.h"
+#include "metrics.h"
+#include "request_executor.h"
+#include "stitch_plan.h"
+
+struct snnet_engine {
+    std::unique_ptr<InferenceEngine> engine;
+    std::vector<std::unique_ptr<StitchPlan>> plans;     // by stitch id
+
+    std::mutex context_mutex;
+    std::vector<std::unique_ptr<InferenceContext>> spare_contexts;  // for async requests
+
+    std::once_flag executor_once;
+    std::unique_ptr<RequestExecutor> executor;          // for batches, created on first use
+};
+
+struct snnet_context {
+    InferenceContext context;
+
+    explicit snnet_context(int numa_node) : context(numa_node) {}
+};
+
+static_assert(SNNET_NUM_CLASSES == out_numClasses, "snnet.h and constants.h disagree");
+static_assert(SNNET_IMAGE_SIZE == in_width && SNNET_IMAGE_SIZE == in_height, "snnet.h and constants.h disagree");
+static_assert(SNNET_NUM_STITCH_IDS == num_stitch_ids, "snnet.h and constants.h disagree");
+
+namespace {
+
+thread_local std::string last_error;
+// For calls without a context, by NUMA node: contexts hold no engine state, only buffers placed on
+// a node, so engines on the same node share one and an engine on another node gets its own
+thread_local std::map<int, std::unique_ptr<InferenceContext>> thread_contexts;
+
+snnet_status fail(snnet_status status, const char* message) {
+    last_error = message;
+    return status;
+}
+
+// Runs `body` and turns exceptions into a status, since none may cross the C boundary
+template <typename F>
+snnet_status guarded(F&& body) {
+    try {
+        body();
+        return SNNET_OK;
+    } catch (const std::invalid_argument& e) {
+        return fail(SNNET_INVALID_ARGUMENT, e.what());
+    } catch (const std::exception& e) {
+        return fail(SNNET_ERROR, e.what());
+    } catch (...) {
+        return fail(SNNET_ERROR, "Unknown error");
+    }
+}
+
+void require(bool condition, const char* message) {
+    if (!condition) {
+        throw std::invalid_argument(message);
+    }
+}
+
+const StitchPlan& planOf(snnet_engine* engine, int stitch_id) {
+    require(stitch_id >= 0 && stitch_id < num_stitch_ids, "Stitch id out of range");
+    return *engine->plans[stitch_id];
+}
+
+InferenceContext& contextOf(snnet_engine* engine, snnet_context* context) {
+    if (context != nullptr) {
+        return context->context;
+    }
+    const int numa_node = engine->engine->getOptions().numa_node;
+    std::unique_ptr<InferenceContext>& thread_context = thread_contexts[numa_node];
+    if (!thread_context) {
+        thread_context = std::make_unique<InferenceContext>(numa_node);
+    }
+    return *thread_context;
+}
+
+} // namespace
+
+extern "C" {
+
+void snnet_options_init(snnet_options* options) {
+    options->model_dir = nullptr;
+    options->ort_cache_dir = nullptr;
+    options->intra_op_threads = 1;
+    options->numa_node = -1;
+    options->memory_budget = 0;
+    options->arena_reserve_bytes = 0;
+}
+
+snnet_status snnet_engine_create(const char* bundle, const snnet_options* options, snnet_engine** engine) {
+    if (engine == nullptr) {
+        return fail(SNNET_INVALID_ARGUMENT, "engine is NULL");
+    }
+    *engine = nullptr;
+    snnet_options defaults;
+    snnet_options_init(&defaults);
+    const snnet_options& o = options != nullptr ? *options : defaults;
+    return guarded([&] {
+        EngineOptions engine_options;
+        if (o.model_dir != nullptr) engine_options.model_dir = std::string(o.model_dir) + "/";
+        engine_options.packed_dir = bundle != nullptr && *bundle != '\0' ? std::string(bundle) + "/" : "";
+        if (o.ort_cache_dir != nullptr) engine_options.ort_cache_dir = std::string(o.ort_cache_dir) + "/";
+        engine_options.intra_op_threads = std::max(1, o.intra_op_threads);
+        engine_options.numa_node = o.numa_node;
+        engine_options.memory_budget = o.memory_budget;
+        engine_options.arena_reserve_bytes = o.arena_reserve_bytes;
+
+        auto created = std::make_unique<snnet_engine>();
+        created->engine = std::make_unique<InferenceEngine>(engine_options);
+        for (int s_id = 0; s_id < num_stitch_ids; ++s_id) {
+            created->plans.push_back(std::make_unique<StitchPlan>(s_id));
+        }
+        *engine = created.release();
+    });
+}
+
+void snnet_engine_destroy(snnet_engine* engine) {
+    delete engine;
+}
+
+snnet_status snnet_preload(snnet_engine* engine, int stitch_id) {
+    return guarded([&] {
+        require(engine != nullptr, "engine is NULL");
+        engine->engine->preload(planOf(engine, stitch_id));
+    });
+}
+
+snnet_status snnet_context_create(snnet_engine* engine, snnet_context** context) {
+    return guarded([&] {
+        require(engine != nullptr && context != nullptr, "engine or context is NULL");
+        *context = new snnet_context(engine->engine->getOptions().numa_node);
+    });
+}
+
+void snnet_context_destroy(snnet_context* context) {
+    delete context;
+}
+
+snnet_status snnet_infer(snnet_engine* engine, snnet_context* context, const float* chw, int stitch_id, float* out_logits) {
+    return guarded([&] {
+        require(engine != nullptr && chw != nullptr && out_logits != nullptr, "engine, image or logits is NULL");
+        engine->engine->run(planOf(engine, stitch_id), chw, out_logits, contextOf(engine, context));
+    });
+}
+
+snnet_status snnet_infer_rgb(snnet_engine* engine, snnet_context* context, const uint8_t* rgb, int width, int height,
+                             size_t stride, int stitch_id, float* out_logits) {
+    return guarded([&] {
+        require(engine != nullptr && rgb != nullptr && out_logits != nullptr, "engine, image or logits is NULL");
+        require(width > 0 && height > 0, "Image size must be positive");
+        const StitchPlan& plan = planOf(engine, stitch_id);
+        InferenceContext& c = contextOf(engine, context);
+
+        // Wraps the caller's pixels; only the resized copy is made, then planar floats in the context
+        cv::Mat image(height, width, CV_8UC3, const_cast<uint8_t*>(rgb), stride > 0 ? stride : static_cast<size_t>(cv::Mat::AUTO_STEP));
+        cv::Mat resized;
+        cv::resize(image, resized, cv::Size(in_width, in_height));
+        const size_t plane = in_width * in_height;
+        for (int y = 0; y < in_height; ++y) {
+            const uint8_t* row = resized.ptr<uint8_t>(y);
+            for (int x = 0; x < in_width; ++x, row += 3) {
+                const size_t i = y * in_width + x;
+                c.ping[i] = row[0] / 255.0f;
+                c.ping[plane + i] = row[1] / 255.0f;
+                c.ping[2 * plane + i] = row[2] / 255.0f;
+            }
+        }
+        engine->engine->runSteps(plan, 0, plan.getSteps().size(), c.ping, c.pong, out_logits);
+    });
+}
+
+snnet_status snnet_infer_batch(snnet_engine* engine, const float* const* chw, size_t count, int stitch_id, float* out_logits) {
+    return guarded([&] {
+        require(engine != nullptr && (count == 0 || (chw != nullptr && out_logits != nullptr)), "engine, images or logits is NULL");
+        const StitchPlan& plan = planOf(engine, stitch_id);
+        std::call_once(engine->executor_once, [&] {
+            engine->executor = std::make_unique<RequestExecutor>(
+                RequestExecutor::defaultWorkerCount(engine->engine->getOptions().intra_op_threads));
+        });
+
+        // Waits for this batch only; the executor may be running other callers' batches too
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t remaining = count;
+        std::string error;
+        for (size_t i = 0; i < count; ++i) {
+            engine->executor->submit([&, i] {
+                std::string failure;
+                try {
+                    require(chw[i] != nullptr, "Image is NULL");
+                    engine->engine->run(plan, chw[i], out_logits + i * out_numClasses, contextOf(engine, nullptr));
+                } catch (const std::exception& e) {
+                    failure = e.what();
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error.empty()) error = failure;
+                if (--remaining == 0) finished.notify_one();
+            });
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return remaining == 0; });
+        Metrics::global().countBatch(count);
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+    });
+}
+
+snnet_status snnet_infer_async(snnet_engine* engine, const float* chw, int stitch_id, float* out_logits,
+                               snnet_callback callback, void* user_data) {
+    return guarded([&] {
+        require(engine != nullptr && chw != nullptr && out_logits != nullptr && callback != nullptr,
+                "engine, image, logits or callback is NULL");
+        const StitchPlan& plan = planOf(engine, stitch_id);
+        std::unique_ptr<InferenceContext> context;
+        {
+            std::lock_guard<std::mutex> lock(engine->context_mutex);
+            if (!engine->spare_contexts.empty()) {
+                context = std::move(engine->spare_contexts.back());
+                engine->spare_contexts.pop_back();
+            }
+        }
+        if (!context) {
+            context = std::make_unique<InferenceContext>(engine->engine->getOptions().numa_node);
+        }
+        InferenceContext* c = context.release();
+        engine->engine->runAsync(plan, chw, out_logits, *c, [engine, c, out_logits, callback, user_data](std::exception_ptr error) {
+            {
+                std::lock_guard<std::mutex> lock(engine->context_mutex);
+                engine->spare_contexts.emplace_back(c);
+            }
+            snnet_status status = SNNET_OK;
+            if (error) {
+                status = guarded([&] { std::rethrow_exception(error); }); // sets this thread's last error
+            }
+            callback(user_data, status, out_logits);
+        });
+    });
+}
+
+snnet_status snnet_write_metrics(const char* path) {
+    return guarded([&] {
+        require(path != nullptr, "path is NULL");
+        Metrics::global().writeFile(path);
+    });
+}
+
+const char* snnet_last_error(void) {
+    return last_error.c_str();
+}
+
+} // extern "C"
@@ -0,0 +1,140 @@
+#include "stitch_plan.h"
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include "constants.h"
+#include "stitch_config.h"
+
+namespace {
+
+constexpr int64_t anchor_widths[] = { tr_width_t, tr_width_s, tr_width_b };
+
+} // namespace
+
+int64_t PlanStep::inputElements() const {
+    int64_t n = 1;
+    for (int64_t d : input_shape) n *= d;
+    return n;
+}
+
+int64_t PlanStep::outputElements() const {
+    int64_t n = 1;
+    for (int64_t d : output_shape) n *= d;
+    return n;
+}
+
+const char* PlanStep::kindName(StepKind kind) {
+    switch (kind) {
+        case StepKind::Embed: return "embed";
+        case StepKind::Layer: return "layer";
+        case StepKind::Stitch: return "stitch";
+        case StepKind::Head: return "head";
+    }
+    return "";
+}
+
+StitchPlan::StitchPlan(int s_id) : stitch_id(s_id) {
+    if (stitch_id < 0 || stitch_id >= num_stitch_ids) {
+        throw std::invalid_argument("Stitch id must be in [0, " + std::to_string(num_stitch_ids - 1) + "]");
+    }
+
+    // Anchor information setting
+    StitchConfig config(vit_depth, 2, 1);
+    int front_anchor, back_anchor;
+    std::pair<int, int> anchor_layer_num; // <front, back> anchors' layer to stitch
+    if (stitch_id < 3) { // single anchor: all layers of one model
+        stitch_code = stitch_id;
+        front_anchor = back_anchor = stitch_id;
+        anchor_layer_num = { vit_depth - 1, vit_depth };
+    } else if (stitch_id > 36) {
+        stitch_code = 4;
+        front_anchor = 1, back_anchor = 2;
+        anchor_layer_num = config.getStitchConfig(stitch_id - 37); // stitch_config_id: 0-33
+    } else {
+        stitch_code = 3;
+        front_anchor = 0, back_anchor = 1;
+        anchor_layer_num = config.getStitchConfig(stitch_id - 3);
+    }
+    const int64_t front_width = anchor_widths[front_anchor];
+    const int64_t back_width = anchor_widths[back_anchor];
+
+    steps.push_back({ StepKind::Embed, embedModelName(front_anchor),
+        input_node_name_vit_embed, output_node_name_vit_embed,
+        { 1, in_numChannels, in_height, in_width }, { 1, tr_height, front_width } });
+
+    for (int i = 0; i < anchor_layer_num.first + 1; i++) {
+        steps.push_back({ StepKind::Layer, layerModelName(front_anchor, i),
+            input_node_name_vit_layers, output_node_name_vit_layers,
+            { 1, tr_height, front_width }, { 1, tr_height, front_width } });
+    }
+
+    if (stitch_code >= 3) { // skipped when a single anchor is used
+        steps.push_back({ StepKind::Stitch, stitchModelName(stitch_id),
+            input_node_name_stitch_layers, output_node_name_stitch_layers,
+            { 1, tr_height, front_width }, { 1, tr_height, back_width } });
+    }
+
+    for (int i = anchor_layer_num.second; i < vit_depth; i++) {
+        steps.push_back({ StepKind::Layer, layerModelName(back_anchor, i),
+            input_node_name_vit_layers, output_node_name_vit_layers,
+            { 1, tr_height, back_width }, { 1, tr_height, back_width } });
+    }
+
+    steps.push_back({ StepKind::Head, headModelName(back_anchor),
+        input_node_name_vit_head, output_node_name_vit_head,
+        { 1, tr_height, back_width }, { 1, out_numClasses } });
+}
+
+std::vector<std::string> StitchPlan::getModelNames() const {
+    std::vector<std::string> names;
+    for (const PlanStep& step : steps) {
+        names.push_back(step.model_name);
+    }
+    return names;
+}
+
+std::string StitchPlan::embedModelName(int anchor) {
+    return std::string("deit_") + vit_types[anchor] + "_patch16_224_embed";
+}
+
+std::string StitchPlan::layerModelName(int anchor, int layer) {
+    return std::string("deit_") + vit_types[anchor] + "_patch16_224_layer_" + std::to_string(layer);
+}
+
+std::string StitchPlan::stitchModelName(int s_id) {
+    return "deit_sl_" + std::to_string(s_id);
+}
+
+std::string StitchPlan::headModelName(int anchor) {
+    return std::string("deit_") + vit_types[anchor] + "_patch16_224_head";
+}
+
+std::vector<std::string> StitchPlan::allModelNames() {
+    std::vector<std::string> names;
+    for (int anchor = 0; anchor < 3; anchor++) {
+        names.push_back(embedModelName(anchor));
+        for (int i = 0; i < vit_depth; i++) {
+            names.push_back(layerModelName(anchor, i));
+        }
+        names.push_back(headModelName(anchor));
+    }
+    for (int s_id = 3; s_id < num_stitch_ids; s_id++) {
+        names.push_back(stitchModelName(s_id));
+    }
+    return names;
+}
+
+int64_t StitchPlan::modelWidth(const std::string& model_name) {
+    const std::string stitch_prefix = "deit_sl_";
+    if (model_name.rfind(stitch_prefix, 0) == 0) {
+        int s_id = std::atoi(model_name.c_str() + stitch_prefix.size());
+        return s_id > 36 ? tr_width_s : tr_width_t;
+    }
+    for (int anchor = 0; anchor < 3; anchor++) {
+        if (model_name.rfind(std::string("deit_") + vit_types[anchor] + "_", 0) == 0) {
+            return anchor_widths[anchor];
+        }
+    }
+    return 0;
+}
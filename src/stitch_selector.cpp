@@ -0,0 +1,37 @@
+#include "stitch_selector.h"
+
+#include <algorithm>
+
+#include "constants.h"
+#include "cost_table.h"
+#include "stitch_plan.h"
+
+StitchSelector::StitchSelector() : plan_flops(num_stitch_ids), warm(num_stitch_ids) {
+    for (int s_id = 0; s_id < num_stitch_ids; ++s_id) {
+        plan_flops[s_id] = CostTable::planFlops(StitchPlan(s_id));
+        stitches_by_cost.push_back(s_id);
+    }
+    std::stable_sort(stitches_by_cost.begin(), stitches_by_cost.end(),
+                     [&](int a, int b) { return plan_flops[a] < plan_flops[b]; });
+}
+
+int StitchSelector::choose(double budget_ms) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    int chosen = stitches_by_cost.front();
+    if (ms_per_flop <= 0) {
+        return chosen; // nothing measured yet
+    }
+    for (int s_id : stitches_by_cost) {
+        if (plan_flops[s_id] * ms_per_flop <= budget_ms) chosen = s_id;
+    }
+    return chosen;
+}
+
+void StitchSelector::observe(int stitch_id, double latency_ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (warm[stitch_id]) {
+        double sample = latency_ms / plan_flops[stitch_id];
+        ms_per_flop = ms_per_flop > 0 ? 0.8 * ms_per_flop + 0.2 * sample : sample;
+    }
+    warm[stitch_id] = true;
+}
@@ -0,0 +1,32 @@
+#include "storage_throttle.h"
+
+#include <algorithm>
+#include <thread>
+
+StorageThrottle& StorageThrottle::instance() {
+    static StorageThrottle throttle;
+    return throttle;
+}
+
+void StorageThrottle::setRate(double bytes_per_second) {
+    std::lock_guard<std::mutex> lock(mutex);
+    bytes_per_s = std::max(0.0, bytes_per_second);
+    active.store(bytes_per_s > 0, std::memory_order_relaxed);
+    device_free = std::chrono::steady_clock::now();
+}
+
+void StorageThrottle::charge(size_t bytes) {
+    std::chrono::steady_clock::time_point done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (bytes_per_s <= 0 || bytes == 0) {
+            return;
+        }
+        // Starts after the reads queued before it
+        auto start = std::max(std::chrono::steady_clock::now(), device_free);
+        done = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double>(bytes / bytes_per_s));
+        device_free = done;
+    }
+    std::this_thread::sleep_until(done);
+}
@@ -0,0 +1,231 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "json_writer.h"
+
+namespace {
+
+struct ThreadRing {
+    std::unique_ptr<TraceEvent[]> events{ new TraceEvent[Tracer::ring_events] };
+    std::atomic<uint64_t> written{ 0 };     // events ever recorded; only the owner thread stores
+    long tid = 0;
+    std::string thread_name;                // guarded by registryMutex()
+};
+
+std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Rings of running threads. Never freed: the exit handler reads them after static destruction
+std::vector<ThreadRing*>& rings() {
+    static std::vector<ThreadRing*>* all = new std::vector<ThreadRing*>();
+    return *all;
+}
+
+// Rings of exited threads, for the next new thread
+std::vector<ThreadRing*>& freeRings() {
+    static std::vector<ThreadRing*>* all = new std::vector<ThreadRing*>();
+    return *all;
+}
+
+// Events of exited threads, oldest thread first
+struct RetiredThread {
+    long tid;
+    std::string name;
+    std::vector<TraceEvent> events;
+};
+
+struct Retired {
+    std::deque<RetiredThread> threads;
+    size_t events = 0;
+};
+
+Retired& retired() {
+    static Retired* all = new Retired();
+    return *all;
+}
+
+thread_local ThreadRing* local_ring = nullptr;
+
+// Copies the thread's events out and hands its ring to the next thread
+void retireRing(ThreadRing* ring) {
+    uint64_t n = ring->written.load(std::memory_order_relaxed);
+    uint64_t first = n > Tracer::ring_events ? n - Tracer::ring_events : 0;
+    RetiredThread thread{ ring->tid, {}, {} };
+    thread.events.reserve(n - first);
+    for (uint64_t i = first; i < n; ++i) {
+        thread.events.push_back(ring->events[i & (Tracer::ring_events - 1)]);
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex());
+    thread.name = std::move(ring->thread_name);
+    std::vector<ThreadRing*>& all = rings();
+    all.erase(std::remove(all.begin(), all.end(), ring), all.end());
+    ring->written.store(0, std::memory_order_relaxed);
+    ring->thread_name.clear();
+    freeRings().push_back(ring);
+
+    Retired& old = retired();
+    if (!thread.events.empty() || !thread.name.empty()) {
+        old.events += thread.events.size();
+        old.threads.push_back(std::move(thread));
+    }
+    while (old.events > Tracer::retired_events) {
+        old.events -= old.threads.front().events.size();
+        old.threads.pop_front();
+    }
+}
+
+struct RingRelease {
+    ~RingRelease() {
+        if (local_ring != nullptr) {
+            retireRing(local_ring);
+            local_ring = nullptr;
+        }
+    }
+};
+
+thread_local RingRelease ring_release;
+
+// Tracer::now() and the steady clock read together, to convert ticks to time
+struct ClockPair {
+    uint64_t ticks;
+    std::chrono::steady_clock::time_point time;
+
+    static ClockPair now() {
+        return { Tracer::now(), std::chrono::steady_clock::now() };
+    }
+};
+
+const ClockPair& firstClockPair() {
+    static const ClockPair first = ClockPair::now();
+    return first;
+}
+
+void writeAtExit() {
+    if (const char* path = std::getenv("SNNET_TRACE")) {
+        Tracer::writeChromeTrace(path);
+    }
+}
+
+ThreadRing& localRing() {
+    if (local_ring == nullptr) {
+        firstClockPair();
+        (void)ring_release;     // constructs it, so the ring is retired at thread exit
+        std::lock_guard<std::mutex> lock(registryMutex());
+        static bool exit_handler = false;
+        if (!exit_handler && std::getenv("SNNET_TRACE") != nullptr) {
+            std::atexit(writeAtExit);
+            exit_handler = true;
+        }
+        ThreadRing* ring;
+        if (freeRings().empty()) {
+            ring = new ThreadRing();
+        } else {
+            ring = freeRings().back();
+            freeRings().pop_back();
+        }
+        ring->tid = syscall(SYS_gettid);
+        rings().push_back(ring);
+        local_ring = ring;
+    }
+    return *local_ring;
+}
+
+} // namespace
+
+void Tracer::record(const char* category, const char* name, uint64_t begin, uint64_t end, int64_t arg) {
+    ThreadRing& ring = localRing();
+    uint64_t n = ring.written.load(std::memory_order_relaxed);
+    ring.events[n & (ring_events - 1)] = { begin, end, category, name, arg };
+    ring.written.store(n + 1, std::memory_order_release);
+}
+
+const char* Tracer::intern(const std::string& text) {
+    static std::mutex mutex;
+    static auto* strings = new std::unordered_set<std::string>();
+    std::lock_guard<std::mutex> lock(mutex);
+    return strings->insert(text).first->c_str();
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    ThreadRing& ring = localRing();
+    std::lock_guard<std::mutex> lock(registryMutex());
+    ring.thread_name = name;
+}
+
+void Tracer::writeChromeTrace(const std::string& path) {
+    struct ThreadEvents {
+        long tid;
+        std::string name;
+        std::vector<TraceEvent> events;
+    };
+    std::vector<ThreadEvents> threads;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (const RetiredThread& thread : retired().threads) {
+            threads.push_back({ thread.tid, thread.name, thread.events });
+        }
+        for (ThreadRing* ring : rings()) {
+            uint64_t n = ring->written.load(std::memory_order_acquire);
+            uint64_t first = n > ring_events ? n - ring_events : 0;
+            ThreadEvents thread{ ring->tid, ring->thread_name, {} };
+            for (uint64_t i = first; i < n; ++i) {
+                thread.events.push_back(ring->events[i & (ring_events - 1)]);
+            }
+            threads.push_back(std::move(thread));
+        }
+    }
+    uint64_t origin = UINT64_MAX;
+    for (const ThreadEvents& thread : threads) {
+        for (const TraceEvent& e : thread.events) origin = std::min(origin, e.begin);
+    }
+
+    // Ticks per microsecond, over the whole trace; short traces get a 20 ms window at least
+    const ClockPair first = firstClockPair();
+    ClockPair last = ClockPair::now();
+    if (last.time - first.time < std::chrono::milliseconds(20)) {
+        std::this_thread::sleep_until(first.time + std::chrono::milliseconds(20));
+        last = ClockPair::now();
+    }
+    const double ticks_per_us = (last.ticks - first.ticks) / std::chrono::duration<double, std::micro>(last.time - first.time).count();
+
+    std::ofstream file(path, std::ios::trunc);
+    JsonWriter json(file, true);
+    const int64_t pid = getpid();
+    json.beginObject().member("displayTimeUnit", "ms");
+    json.key("traceEvents").beginArray();
+    for (const ThreadEvents& thread : threads) {
+        if (!thread.name.empty()) {
+            json.beginObject().member("name", "thread_name").member("ph", "M").member("pid", pid)
+                .member("tid", static_cast<int64_t>(thread.tid));
+            json.key("args").beginObject().member("name", thread.name).endObject().endObject();
+        }
+        for (const TraceEvent& e : thread.events) {
+            json.beginObject().member("name", e.name).member("cat", e.category).member("ph", "X")
+                .key("ts").value((e.begin - origin) / ticks_per_us, 3).key("dur").value((e.end - e.begin) / ticks_per_us, 3)
+                .member("pid", pid).member("tid", static_cast<int64_t>(thread.tid));
+            if (e.arg >= 0) {
+                json.key("args").beginObject().member("arg", e.arg).endObject();
+            }
+            json.endObject();
+        }
+    }
+    json.endArray().endObject();
+    file << "\n";
+}
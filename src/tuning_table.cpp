@@ -0,0 +1,76 @@
+#include "tuning_table.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <onnxruntime_session_options_config_keys.h>
+
+void TuningConfig::apply(Ort::SessionOptions& options) const {
+    options.SetIntraOpNumThreads(intra_op_threads);
+    options.AddConfigEntry(kOrtSessionOptionsConfigAllowIntraOpSpinning, allow_spinning ? "1" : "0");
+    if (parallel_execution) {
+        options.SetExecutionMode(ExecutionMode::ORT_PARALLEL);
+        options.SetInterOpNumThreads(2);
+    } else {
+        options.SetExecutionMode(ExecutionMode::ORT_SEQUENTIAL);
+    }
+}
+
+std::string TuningTable::hostTag() {
+    return "cores=" + std::to_string(std::thread::hardware_concurrency()) + ",ort=" + Ort::GetVersionString();
+}
+
+TuningTable TuningTable::load(const std::string& path) {
+    TuningTable table;
+    std::ifstream file(path);
+    std::string line, key, host;
+    if (!getline(file, line) || !(std::istringstream(line) >> key >> host) || key != "host" || host != hostTag()) {
+        return table;
+    }
+    while (getline(file, line)) {
+        std::istringstream fields(line);
+        TuningResult r;
+        int spinning, parallel;
+        if (fields >> r.width >> r.concurrency >> r.config.intra_op_threads >> spinning >> parallel >> r.latency_ms >> r.throughput) {
+            r.config.allow_spinning = spinning != 0;
+            r.config.parallel_execution = parallel != 0;
+            table.set(r);
+        }
+    }
+    return table;
+}
+
+void TuningTable::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    file << "host " << hostTag() << "\n";
+    for (const TuningResult& r : results) {
+        file << r.width << " " << r.concurrency << " " << r.config.intra_op_threads << " " << r.config.allow_spinning << " "
+             << r.config.parallel_execution << " " << r.latency_ms << " " << r.throughput << "\n";
+    }
+    if (!file) {
+        throw std::runtime_error("Failed to write tuning table: " + path);
+    }
+}
+
+void TuningTable::set(const TuningResult& result) {
+    for (TuningResult& r : results) {
+        if (r.width == result.width && r.concurrency == result.concurrency) {
+            r = result;
+            return;
+        }
+    }
+    results.push_back(result);
+}
+
+const TuningResult* TuningTable::find(int64_t width, int concurrency) const {
+    const TuningResult* best = nullptr;
+    for (const TuningResult& r : results) {
+        if (r.width == width && (best == nullptr || std::abs(r.concurrency - concurrency) < std::abs(best->concurrency - concurrency))) {
+            best = &r;
+        }
+    }
+    return best;
+}
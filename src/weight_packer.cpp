@@ -0,0 +1,102 @@
+#include "weight_store.h"
+#include "onnx_proto.h"
+
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+template <typename T>
+void appendPod(std::string& out, const T& v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+void appendString(std::string& out, const std::string& s) {
+    appendPod(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+} // namespace
+
+WeightStoreWriter::WeightStoreWriter(const std::string& blob_path)
+    : blob(blob_path, std::ios::binary | std::ios::trunc),
+      location(std::filesystem::path(blob_path).filename().string()),
+      offset(0), model_count(0), tensor_count(0) {
+    if (!blob) {
+        throw std::runtime_error("Cannot create " + blob_path);
+    }
+    // header is written by finish(), data starts on the second page
+    std::string zeros(weight_store_page, '\0');
+    blob.write(zeros.data(), zeros.size());
+    offset = weight_store_page;
+}
+
+void WeightStoreWriter::pad(uint64_t alignment) {
+    uint64_t aligned = (offset + alignment - 1) / alignment * alignment;
+    if (aligned != offset) {
+        std::string zeros(aligned - offset, '\0');
+        blob.write(zeros.data(), zeros.size());
+        offset = aligned;
+    }
+}
+
+std::string WeightStoreWriter::addModel(const std::string& model_name, const std::string& model) {
+    pad(weight_store_page); // each model starts on its own page
+
+    std::string entries;
+    uint32_t count = 0;
+    std::string rewritten = OnnxProto::externalizeInitializers(model,
+        [&](const OnnxInitializer& tensor, OnnxExternalData& ext) {
+            if (tensor.data.empty()) return false;
+            pad(weight_store_tensor_align);
+            blob.write(tensor.data.data(), tensor.data.size());
+
+            ext.location = location;
+            ext.offset = offset;
+            ext.length = tensor.data.size();
+
+            appendString(entries, tensor.name);
+            appendPod(entries, tensor.data_type);
+            appendPod(entries, static_cast<uint32_t>(tensor.dims.size()));
+            for (int64_t d : tensor.dims) appendPod(entries, d);
+            appendPod(entries, ext.offset);
+            appendPod(entries, ext.length);
+
+            offset += tensor.data.size();
+            ++count;
+            return true;
+        });
+    if (!blob) {
+        throw std::runtime_error("Write error while packing " + model_name);
+    }
+
+    appendString(index, model_name);
+    appendPod(index, count);
+    index += entries;
+    ++model_count;
+    tensor_count += count;
+    return rewritten;
+}
+
+uint64_t WeightStoreWriter::finish() {
+    pad(8);
+    WeightStoreHeader header{};
+    std::memcpy(header.magic, "SNWS", 4);
+    header.version = 1;
+    header.model_count = model_count;
+    header.tensor_count = tensor_count;
+    header.data_offset = weight_store_page;
+    header.index_offset = offset;
+    header.index_size = index.size();
+
+    blob.write(index.data(), index.size());
+    offset += index.size();
+    blob.seekp(0);
+    blob.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    blob.close();
+    if (!blob) {
+        throw std::runtime_error("Write error while finishing " + location);
+    }
+    return offset;
+}
@@ -0,0 +1,158 @@
+#include "weight_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+class IndexReader {
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+
+public:
+    IndexReader(const uint8_t* data, size_t size) : p(data), end(data + size) {}
+
+    template <typename T>
+    T read() {
+        if (static_cast<size_t>(end - p) < sizeof(T)) throw std::runtime_error("Truncated weight store index");
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+
+    std::string readString() {
+        uint32_t len = read<uint32_t>();
+        if (static_cast<size_t>(end - p) < len) throw std::runtime_error("Truncated weight store index");
+        std::string s(reinterpret_cast<const char*>(p), len);
+        p += len;
+        return s;
+    }
+};
+
+} // namespace
+
+WeightStore::WeightStore(const std::string& blob_path) : blob(blob_path) {
+    WeightStoreHeader header;
+    if (blob.size() < sizeof(header)) {
+        throw std::runtime_error("Invalid weight store " + blob_path);
+    }
+    std::memcpy(&header, blob.data(), sizeof(header));
+    if (std::memcmp(header.magic, "SNWS", 4) != 0 || header.version != 1 ||
+        header.index_offset + header.index_size > blob.size()) {
+        throw std::runtime_error("Invalid weight store " + blob_path);
+    }
+
+    IndexReader r(blob.data() + header.index_offset, header.index_size);
+    for (uint32_t m = 0; m < header.model_count; ++m) {
+        std::string model_name = r.readString();
+        std::vector<Tensor>& tensors = models[model_name];
+        uint32_t count = r.read<uint32_t>();
+        tensors.reserve(count);
+        for (uint32_t t = 0; t < count; ++t) {
+            Tensor tensor;
+            tensor.name = r.readString();
+            tensor.type = static_cast<ONNXTensorElementDataType>(r.read<int32_t>());
+            uint32_t ndims = r.read<uint32_t>();
+            for (uint32_t d = 0; d < ndims; ++d) tensor.dims.push_back(r.read<int64_t>());
+            tensor.offset = r.read<uint64_t>();
+            tensor.length = r.read<uint64_t>();
+            if (tensor.offset + tensor.length > header.index_offset) {
+                throw std::runtime_error("Weight store tensor out of range: " + tensor.name);
+            }
+            tensors.push_back(std::move(tensor));
+        }
+    }
+}
+
+size_t WeightStore::getModelBytes(const std::string& model_name) const {
+    auto it = models.find(model_name);
+    if (it == models.end()) {
+        return 0;
+    }
+    size_t bytes = 0;
+    for (const Tensor& t : it->second) {
+        bytes += t.length;
+    }
+    return bytes;
+}
+
+std::pair<uint64_t, uint64_t> WeightStore::getModelRange(const std::string& model_name) const {
+    auto it = models.find(model_name);
+    if (it == models.end() || it->second.empty()) {
+        return { 0, 0 };
+    }
+    uint64_t begin = UINT64_MAX, end = 0;
+    for (const Tensor& t : it->second) {
+        begin = std::min(begin, t.offset);
+        end = std::max(end, t.offset + t.length);
+    }
+    return { begin, end - begin };
+}
+
+void WeightStore::addInitializers(const std::string& model_name, Ort::SessionOptions& options, bool shared) {
+    auto it = models.find(model_name);
+    if (it == models.end()) {
+        throw std::runtime_error("Model not in weight store: " + model_name);
+    }
+
+    std::lock_guard<std::mutex> lock(values_mutex);
+    auto found = values.find(model_name);
+    if (found == values.end()) {
+        Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeDefault);
+        // Offsets are blob offsets; a local copy starts at the model's first tensor
+        const uint8_t* base = blob.data();
+        auto local = local_copies.find(model_name);
+        if (local != local_copies.end()) {
+            base = local->second - getModelRange(model_name).first;
+        }
+        ModelValues model_values;
+        for (const Tensor& t : it->second) {
+            // ORT never writes to initializers, the const_cast only satisfies the C API signature
+            void* data = const_cast<uint8_t*>(base + t.offset);
+            model_values.names.push_back(t.name);
+            model_values.values.push_back(Ort::Value::CreateTensor(
+                memory_info, data, t.length, t.dims.data(), t.dims.size(), t.type));
+        }
+        found = values.emplace(model_name, std::move(model_values)).first;
+    }
+    if (shared) {
+        for (size_t i = 0; i < found->second.names.size(); ++i) {
+            options.AddInitializer(found->second.names[i].c_str(), found->second.values[i]);
+        }
+    } else {
+        options.AddExternalInitializers(found->second.names, found->second.values);
+    }
+}
+
+void WeightStore::localize(const std::vector<std::string>& model_names, int numa_node) {
+    std::lock_guard<std::mutex> lock(values_mutex);
+    // Packed back to back, each range at a tensor-aligned offset: ranges start page-aligned in the blob
+    std::vector<std::pair<std::string, std::pair<uint64_t, uint64_t>>> ranges;
+    uint64_t total = 0;
+    for (const std::string& model_name : model_names) {
+        std::pair<uint64_t, uint64_t> range = getModelRange(model_name);
+        if (range.second == 0 || values.count(model_name) != 0 || local_copies.count(model_name) != 0) {
+            continue;
+        }
+        if (std::any_of(ranges.begin(), ranges.end(), [&](const auto& r) { return r.first == model_name; })) {
+            continue;
+        }
+        ranges.emplace_back(model_name, range);
+        total += (range.second + weight_store_tensor_align - 1) / weight_store_tensor_align * weight_store_tensor_align;
+    }
+    if (ranges.empty()) {
+        return;
+    }
+    HugePageBuffer buffer(total, numa_node);
+    uint8_t* next = static_cast<uint8_t*>(buffer.data());
+    for (const auto& entry : ranges) {
+        const std::pair<uint64_t, uint64_t>& range = entry.second;
+        std::memcpy(next, blob.data() + range.first, range.second);
+        local_copies.emplace(entry.first, next);
+        next += (range.second + weight_store_tensor_align - 1) / weight_store_tensor_align * weight_store_tensor_align;
+    }
+    local_buffers.push_back(std::move(buffer));
+}